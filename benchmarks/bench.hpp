@@ -0,0 +1,49 @@
+#ifndef BENCH_HPP
+#define BENCH_HPP
+
+#include "lexer.hpp"
+#include "parser.hpp"
+#include "utils.hpp"
+
+#include <chrono>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Small helpers shared by the benchmark drivers in this directory.
+namespace bench {
+
+inline std::vector<Expression*> parse(const std::string& source) {
+    Lexer lex(source);
+    std::vector<Token> tokens = lex.generate_tokens();
+    Parser parser(tokens);
+    return parser.parse_top_level_expressions();
+}
+
+// Runs fn with std::cout swallowed and returns the wall time in nanoseconds.
+template <typename Fn>
+double time_ns(Fn&& fn) {
+    std::ostringstream sink;
+    std::streambuf* old = std::cout.rdbuf(sink.rdbuf());
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    auto end = std::chrono::steady_clock::now();
+    std::cout.rdbuf(old);
+    return std::chrono::duration<double, std::nano>(end - start).count();
+}
+
+// Best of reps runs, the minimum is the least noisy estimate on a busy box.
+template <typename Fn>
+double best_ns(int reps, Fn&& fn) {
+    double best = -1;
+    for (int i = 0; i < reps; i++) {
+        double t = time_ns(fn);
+        if (best < 0 || t < best) best = t;
+    }
+    return best;
+}
+
+} // namespace bench
+
+#endif // BENCH_HPP
@@ -0,0 +1,52 @@
+#include "value_ops.hpp"
+
+#include <chrono>
+#include <cstdio>
+
+// Binary operator dispatch: times value_ops::binary on every (op, lhs type,
+// rhs type) pair the matrix defines, ns per call including building the
+// result. Pairs that throw are skipped.
+
+static Value sample(int tag) {
+    switch (tag) {
+        case Value::INT_TAG: return Value(7);
+        case Value::BOOL_TAG: return Value(true);
+        case Value::STRING_TAG: return Value("abc");
+        default: return Value(std::vector<Value>{Value(1), Value(2), Value(3)});
+    }
+}
+
+static const char* tag_name(int tag) {
+    static const char* names[] = {"int", "bool", "string", "list"};
+    return names[tag];
+}
+
+static double ns_per_call(value_ops::BinOp op, const Value& lhs, const Value& rhs, int& sink) {
+    const int calls = 200000;
+    double best = -1;
+    for (int rep = 0; rep < 5; rep++) {
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < calls; i++) sink += value_ops::binary(op, lhs, rhs).tag();
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        if (best < 0 || ns < best) best = ns;
+    }
+    return best / calls;
+}
+
+int main() {
+    int sink = 0;
+    std::printf("%-4s %-8s %-8s %8s\n", "op", "lhs", "rhs", "ns/call");
+    for (int op = 0; op < value_ops::NUM_BINOPS; op++) {
+        for (int l = 0; l < Value::NUM_TAGS; l++) {
+            for (int r = 0; r < Value::NUM_TAGS; r++) {
+                value_ops::BinOp bin_op = static_cast<value_ops::BinOp>(op);
+                if (!value_ops::defined[value_ops::index(bin_op, l, r)]) continue;
+                // 3 so ^ and * stay small
+                Value lhs = sample(l), rhs = r == Value::INT_TAG ? Value(3) : sample(r);
+                double ns = ns_per_call(bin_op, lhs, rhs, sink);
+                std::printf("%-4s %-8s %-8s %8.2f\n", value_ops::symbol(bin_op), tag_name(l), tag_name(r), ns);
+            }
+        }
+    }
+    std::printf("(checksum %d)\n", sink % 2);
+}
@@ -0,0 +1,35 @@
+#include "bench.hpp"
+#include "interpreter.hpp"
+
+#include <cstdio>
+
+// Call frames: ns per call of a small function from a loop, in programs that
+// also hold a growing number of variables the function never reads. A call
+// copies only what it can read, so the cost should not grow with them. The
+// JIT is off, it would run the calls natively.
+
+static std::string program(int globals, int calls) {
+    std::string source = "let scale = 3;";
+    for (int g = 0; g < globals; g++) source += "let g" + std::to_string(g) + " = [" + std::to_string(g) + "];";
+    source += "function step(x) { return x * scale % 7; }";
+    source += "let i = 0; let sum = 0;";
+    source += "while (i < " + std::to_string(calls) + ") { sum = sum + step(i); i = i + 1; }";
+    return source + "print(sum);";
+}
+
+int main() {
+    const int calls = 100000;
+    std::printf("%-8s %12s\n", "globals", "ns/call");
+    for (int globals : {0, 10, 100, 1000}) {
+        std::vector<Expression*> exps = bench::parse(program(globals, calls));
+        IRGenerator gen;
+        gen.generate_ir_code(exps);
+        double ns = bench::best_ns(3, [&]() {
+            Interpreter interpreter(gen);
+            interpreter.set_jit(false);
+            interpreter.execute();
+        });
+        std::printf("%-8d %12.1f\n", globals, ns / calls);
+        utils::cleanup_expressions(exps);
+    }
+}
@@ -0,0 +1,54 @@
+#include "bench.hpp"
+#include "closure_evaluator.hpp"
+#include "tree_evaluator.hpp"
+
+#include <cstdio>
+
+// Closure compilation: runs programs in the tree evaluator and in the
+// closure evaluator (same semantics, the tree turned into closures over
+// frame slots once up front), parse excluded, and reports the wall time of
+// each.
+
+struct Program {
+    const char* name;
+    std::string source;
+};
+
+static const std::vector<Program> programs = {
+    {"counter",
+        "let i = 0; let sum = 0;"
+        "while (i < 300000) { sum = sum + i % 7; i = i + 1; }"
+        "print(sum);"},
+    {"fib",
+        "function fib(n) { if (n < 2) { return n; } return fib(n - 1) + fib(n - 2); }"
+        "print(fib(20));"},
+    {"list_build",
+        "let xs = []; let i = 0;"
+        "while (i < 20000) { xs = append(xs, i * 2); i = i + 1; }"
+        "i = 0; while (i < 20000) { xs[i] = xs[i] + 1; i = i + 1; }"
+        "print(size(xs));"},
+    {"strings",
+        "let s = \"\"; let i = 0;"
+        "while (i < 20000) { s = s + \"ab\"; i = i + 1; }"
+        "print(size(s));"},
+};
+
+template <typename Evaluator>
+static double run_ms(const std::string& source) {
+    std::vector<Expression*> exps = bench::parse(source);
+    double ns = bench::best_ns(3, [&]() {
+        Evaluator evaluator;
+        evaluator.evaluate_commands(exps);
+    });
+    utils::cleanup_expressions(exps);
+    return ns / 1e6;
+}
+
+int main() {
+    std::printf("%-11s %12s %12s %9s\n", "program", "tree ms", "closure ms", "speedup");
+    for (const Program& program : programs) {
+        double tree = run_ms<TreeEvaluator>(program.source);
+        double closure = run_ms<ClosureEvaluator>(program.source);
+        std::printf("%-11s %12.2f %12.2f %8.1fx\n", program.name, tree, closure, tree / closure);
+    }
+}
@@ -0,0 +1,74 @@
+#include "bench.hpp"
+#include "interpreter.hpp"
+
+#include <cstdio>
+
+// Dispatch microbenchmark: runs small dispatch-bound programs under both
+// interpreter loops and reports ns per dispatched instruction.
+
+struct Program {
+    const char* name;
+    std::string source;
+};
+
+static const std::vector<Program> programs = {
+    {"arith_loop",
+        "let i = 0; let sum = 0;"
+        "while (i < 200000) { sum = sum + i * 2 - (i % 7); i = i + 1; }"
+        "print(sum);"},
+    {"branchy_loop",
+        "let i = 0; let evens = 0; let odds = 0;"
+        "while (i < 200000) { if (i % 2 == 0) { evens = evens + 1; } else { odds = odds + 1; } i = i + 1; }"
+        "print(evens); print(odds);"},
+    {"recursion",
+        "function fib(n) { if (n < 2) { return n; } return fib(n - 1) + fib(n - 2); }"
+        "print(fib(18));"},
+    {"list_access",
+        "let xs = [1, 2, 3, 4, 5, 6, 7, 8]; let i = 0; let sum = 0;"
+        "while (i < 100000) { sum = sum + xs[i % 8]; i = i + 1; }"
+        "print(sum);"},
+};
+
+static void measure(IRGenerator& gen, DispatchMode mode, double& ns, uint64_t& count) {
+    ns = bench::best_ns(5, [&]() {
+        Interpreter interpreter(gen);
+        interpreter.set_jit(false);
+        interpreter.set_tracing(false);
+        interpreter.set_dispatch_mode(mode);
+        interpreter.execute();
+    });
+    // only a profiled run counts its dispatches
+    Interpreter counted(gen);
+    counted.set_jit(false);
+    counted.set_tracing(false);
+    counted.set_dispatch_mode(mode);
+    counted.set_profiling(true);
+    bench::time_ns([&]() { counted.execute(); });
+    count = counted.dispatch_count();
+}
+
+int main() {
+    if (!Interpreter::threaded_dispatch_supported()) {
+        std::printf("threaded dispatch is not available with this compiler, only the switch loop is measured\n");
+    }
+
+    std::printf("%-14s %12s %14s %14s %9s\n", "program", "instrs", "switch ns/op", "threaded ns/op", "speedup");
+    for (const Program& program : programs) {
+        std::vector<Expression*> exps = bench::parse(program.source);
+        IRGenerator gen;
+        gen.generate_ir_code(exps);
+
+        double switch_ns, threaded_ns;
+        uint64_t switch_count, threaded_count;
+        measure(gen, DispatchMode::Switch, switch_ns, switch_count);
+        measure(gen, DispatchMode::Threaded, threaded_ns, threaded_count);
+
+        double switch_per_op = switch_ns / switch_count;
+        double threaded_per_op = threaded_ns / threaded_count;
+        std::printf("%-14s %12llu %14.2f %14.2f %8.2fx\n", program.name,
+            static_cast<unsigned long long>(switch_count), switch_per_op, threaded_per_op,
+            switch_per_op / threaded_per_op);
+
+        utils::cleanup_expressions(exps);
+    }
+}
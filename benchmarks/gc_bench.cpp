@@ -0,0 +1,74 @@
+#include "heap.hpp"
+#include "value.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+// Collector pause times: builds a live heap of nested lists (groups of 1024
+// lists of 1024 ints, 8 KB each) up to the given size in MB, default 1024,
+// and reports the pause of a full collection over it, then the cost of
+// reclaiming unreachable cycles.
+
+static double ms_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static Value build_heap(size_t mb) {
+    const int width = 1024;
+    size_t groups = mb * 1024 * 1024 / (static_cast<size_t>(width) * width * sizeof(Value));
+    if (groups == 0) groups = 1;
+
+    std::vector<Value> root;
+    for (size_t g = 0; g < groups; g++) {
+        std::vector<Value> group;
+        group.reserve(width);
+        for (int i = 0; i < width; i++) {
+            std::vector<Value> leaf(width);
+            for (int j = 0; j < width; j++) leaf[j] = Value(j);
+            group.push_back(Value(std::move(leaf)));
+        }
+        root.push_back(Value(std::move(group)));
+    }
+    return Value(std::move(root));
+}
+
+static void make_cycles(int n) {
+    for (int i = 0; i < n; i++) {
+        // a -> b -> a, a is unshared before b takes its reference
+        Value a = Value(std::vector<Value>());
+        a.list_ref().push_back(Value(std::vector<Value>{a}));
+    }
+}
+
+int main(int argc, char* argv[]) {
+    size_t mb = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1024;
+
+    auto start = std::chrono::steady_clock::now();
+    Value root = build_heap(mb);
+    double build_ms = ms_since(start);
+    const heap::Stats& stats = heap::stats();
+    std::printf("built %zu MB heap: %zu lists in %.0f ms, %llu collections while building (max pause %.2f ms)\n",
+        heap::heap_bytes() >> 20, stats.live_lists, build_ms,
+        static_cast<unsigned long long>(stats.collections), stats.max_pause_ns / 1e6);
+
+    for (int i = 0; i < 3; i++) {
+        heap::collect();
+        std::printf("full collection, live heap:        %8.2f ms\n", stats.last_pause_ns / 1e6);
+    }
+
+    const int cycles = 100000;
+    heap::Config config = heap::config();
+    config.enabled = false;
+    heap::configure(config);
+    make_cycles(cycles);
+    size_t lists_before = stats.live_lists;
+    size_t freed = heap::collect();
+    std::printf("full collection, %d garbage lists: %8.2f ms (%zu freed, %zu lists left)\n",
+        2 * cycles, stats.last_pause_ns / 1e6, freed, lists_before - freed);
+
+    config.enabled = true;
+    heap::configure(config);
+    root = Value();
+    std::printf("after dropping the root: %zu lists, %zu bytes\n", stats.live_lists, heap::heap_bytes());
+}
@@ -0,0 +1,64 @@
+#include "bench.hpp"
+#include "interpreter.hpp"
+#include "ssa_generator.hpp"
+
+#include <cstdio>
+
+// Baseline JIT: runs call heavy int programs in the VM with hot functions
+// compiled to native code and without, reports the wall time of each and
+// how many functions compiled.
+
+struct Program {
+    const char* name;
+    std::string source;
+};
+
+static const std::vector<Program> programs = {
+    {"factorial",
+        "function f(n) { if (n == 1) { return 1; } return n * f(n - 1); }"
+        "let i = 0; let sum = 0;"
+        "while (i < 20000) { sum = sum + f(12); i = i + 1; }"
+        "print(sum);"},
+    {"fib",
+        "function fib(n) { if (n < 2) { return n; } return fib(n - 1) + fib(n - 2); }"
+        "print(fib(22));"},
+    {"loop_in_call",
+        "function collatz(n) { let steps = 0; while (n != 1) { if (n % 2 == 0) { n = n / 2; } else { n = 3 * n + 1; } steps = steps + 1; } return steps; }"
+        "let i = 1; let total = 0;"
+        "while (i < 3000) { total = total + collatz(i); i = i + 1; }"
+        "print(total);"},
+    {"mutual",
+        "function even(n) { if (n == 0) { return true; } return odd(n - 1); }"
+        "function odd(n) { if (n == 0) { return false; } return even(n - 1); }"
+        "let i = 0; let hits = 0;"
+        "while (i < 500) { if (even(i)) { hits = hits + 1; } i = i + 1; }"
+        "print(hits);"},
+};
+
+static double run_ms(const std::string& source, bool optimize, bool jit, int& compiled) {
+    std::vector<Expression*> exps = bench::parse(source);
+    IRGenerator plain_gen;
+    SSAGenerator ssa_gen;
+    IRGenerator& gen = optimize ? ssa_gen : plain_gen;
+    gen.generate_ir_code(exps);
+    double ns = bench::best_ns(3, [&]() {
+        Interpreter interpreter(gen);
+        interpreter.set_jit(jit);
+        interpreter.execute();
+        compiled = interpreter.jit_compiled_count();
+    });
+    utils::cleanup_expressions(exps);
+    return ns / 1e6;
+}
+
+int main() {
+    std::printf("%-14s %-9s %12s %12s %9s %9s\n", "program", "codegen", "vm ms", "jit ms", "speedup", "compiled");
+    for (const Program& program : programs) {
+        for (bool optimize : {false, true}) {
+            int unused, compiled;
+            double vm = run_ms(program.source, optimize, false, unused);
+            double jit = run_ms(program.source, optimize, true, compiled);
+            std::printf("%-14s %-9s %12.2f %12.2f %8.1fx %9d\n", program.name, optimize ? "ssa" : "plain", vm, jit, vm / jit, compiled);
+        }
+    }
+}
@@ -0,0 +1,71 @@
+#include "bench.hpp"
+#include "interpreter.hpp"
+
+#include <chrono>
+#include <cstdio>
+
+// Lazy compilation: a library style script declaring thousands of functions
+// of which the program calls a handful, run with every function compiled up
+// front and with functions compiled on their first call. Reports codegen
+// time, total time (codegen and run, parse excluded) and the size of the
+// code the VM ends up with.
+
+using Clock = std::chrono::steady_clock;
+
+static std::string library(int functions, int used) {
+    std::string source;
+    for (int f = 0; f < functions; f++) {
+        std::string name = "lib" + std::to_string(f);
+        source += "function " + name + "(a, b) {"
+            " let acc = 0; let i = 0;"
+            " while (i < a) { if (i % 2 == 0) { acc = acc + i * b; } else { acc = acc - b; } i = i + 1; }"
+            " let xs = [acc, a, b]; xs = append(xs, size(xs));"
+            " return xs[0] + xs[3]; }";
+    }
+    source += "let total = 0;";
+    for (int f = 0; f < used; f++) {
+        source += "total = total + lib" + std::to_string(f * (functions / used)) + "(10, " + std::to_string(f) + ");";
+    }
+    return source + "print(total);";
+}
+
+struct Run {
+    double codegen_ms;
+    double total_ms;
+    size_t words;
+};
+
+static Run run(const std::vector<Expression*>& exps, bool lazy) {
+    Run best = {-1, -1, 0};
+    for (int rep = 0; rep < 5; rep++) {
+        std::ostringstream sink;
+        std::streambuf* old = std::cout.rdbuf(sink.rdbuf());
+        Clock::time_point start = Clock::now();
+
+        IRGenerator gen;
+        gen.set_lazy(lazy);
+        gen.generate_ir_code(exps);
+        Clock::time_point generated = Clock::now();
+        Interpreter interpreter(gen);
+        interpreter.execute();
+        Clock::time_point end = Clock::now();
+
+        std::cout.rdbuf(old);
+        double codegen = std::chrono::duration<double, std::milli>(generated - start).count();
+        double total = std::chrono::duration<double, std::milli>(end - start).count();
+        if (best.total_ms < 0 || total < best.total_ms) best = {codegen, total, gen._code.size()};
+    }
+    return best;
+}
+
+int main() {
+    std::printf("%-10s %6s %-6s %12s %10s %10s\n", "functions", "used", "mode", "codegen ms", "total ms", "words");
+    for (int functions : {1000, 5000, 20000}) {
+        std::vector<Expression*> exps = bench::parse(library(functions, 10));
+        for (bool lazy : {false, true}) {
+            Run r = run(exps, lazy);
+            std::printf("%-10d %6d %-6s %12.2f %10.2f %10zu\n", functions, 10, lazy ? "lazy" : "eager", r.codegen_ms, r.total_ms, r.words);
+        }
+        utils::cleanup_expressions(exps);
+    }
+}
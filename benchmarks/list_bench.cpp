@@ -0,0 +1,54 @@
+#include "bench.hpp"
+#include "interpreter.hpp"
+#include "ssa_generator.hpp"
+
+#include <cstdio>
+
+// List update scaling: the time per element of filling an n element list, or
+// building it with xs = append(xs, i), should stay flat as n grows, for both
+// the plain and the SSA code paths.
+
+static double run_program(const std::string& source, bool optimize) {
+    std::vector<Expression*> exps = bench::parse(source);
+    IRGenerator plain_gen;
+    SSAGenerator ssa_gen;
+    IRGenerator& gen = optimize ? ssa_gen : plain_gen;
+    gen.generate_ir_code(exps);
+
+    double ns = bench::best_ns(3, [&]() {
+        Interpreter interpreter(gen);
+        interpreter.execute();
+    });
+    utils::cleanup_expressions(exps);
+    return ns;
+}
+
+static void fill_scaling(int n) {
+    std::string source =
+        "let xs = [0] * " + std::to_string(n) + "; let i = 0;"
+        "while (i < " + std::to_string(n) + ") { xs[i] = xs[i] + i; i = i + 1; }"
+        "print(xs[" + std::to_string(n - 1) + "]);";
+
+    double plain = run_program(source, false) / n;
+    double optimized = run_program(source, true) / n;
+    std::printf("%-10d %14.1f %14.1f\n", n, plain, optimized);
+}
+
+static void append_scaling(int n) {
+    std::string source =
+        "let xs = []; let i = 0;"
+        "while (i < " + std::to_string(n) + ") { xs = append(xs, i); i = i + 1; }"
+        "print(xs[" + std::to_string(n - 1) + "]);";
+
+    double plain = run_program(source, false) / n;
+    double optimized = run_program(source, true) / n;
+    std::printf("%-10d %14.1f %14.1f\n", n, plain, optimized);
+}
+
+int main() {
+    std::printf("%-10s %14s %14s\n", "fill n", "ns/elem", "ns/elem (-O)");
+    for (int n : {100000, 200000, 500000, 1000000}) fill_scaling(n);
+
+    std::printf("\n%-10s %14s %14s\n", "append n", "ns/elem", "ns/elem (-O)");
+    for (int n : {100000, 200000, 500000, 1000000}) append_scaling(n);
+}
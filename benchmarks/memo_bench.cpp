@@ -0,0 +1,52 @@
+#include "bench.hpp"
+#include "interpreter.hpp"
+
+#include <cstdio>
+
+// Memoisation: recursive pure functions over ints, and a loop of calls that
+// rarely repeat their args, run by the VM with and without --memoize. The
+// JIT is off, it would run the calls natively. Reports the wall time of each
+// (codegen included, parse excluded) and the memo hits of the memoized run.
+
+struct Program {
+    const char* name;
+    std::string source;
+};
+
+static const std::vector<Program> programs = {
+    {"fib",
+        "function fib(n) { if (n < 2) { return n; } return fib(n - 1) + fib(n - 2); }"
+        "print(fib(24));"},
+    {"grid_paths",
+        "function paths(r, c) { if (r == 0) { return 1; } if (c == 0) { return 1; } return paths(r - 1, c) + paths(r, c - 1); }"
+        "print(paths(11, 11));"},
+    {"no_repeats",
+        "function mix(a, b) { return (a * 31 + b) % 1000; }"
+        "let i = 0; let sum = 0;"
+        "while (i < 100000) { sum = sum + mix(i, sum); i = i + 1; }"
+        "print(sum);"},
+};
+
+static double run_ms(const std::vector<Expression*>& exps, bool memoize, uint64_t& hits) {
+    return bench::best_ns(3, [&]() {
+        IRGenerator gen;
+        gen.generate_ir_code(exps);
+        Interpreter interpreter(gen);
+        interpreter.set_jit(false);
+        interpreter.set_memoize(memoize);
+        interpreter.execute();
+        hits = interpreter.memo_stats().hits;
+    }) / 1e6;
+}
+
+int main() {
+    std::printf("%-11s %12s %12s %9s %10s\n", "program", "plain ms", "memo ms", "speedup", "hits");
+    for (const Program& program : programs) {
+        std::vector<Expression*> exps = bench::parse(program.source);
+        uint64_t hits = 0;
+        double plain = run_ms(exps, false, hits);
+        double memo = run_ms(exps, true, hits);
+        std::printf("%-11s %12.2f %12.2f %8.1fx %10llu\n", program.name, plain, memo, plain / memo, static_cast<unsigned long long>(hits));
+        utils::cleanup_expressions(exps);
+    }
+}
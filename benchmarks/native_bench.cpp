@@ -0,0 +1,49 @@
+#include "bench.hpp"
+#include "interpreter.hpp"
+#include "builtins.hpp"
+
+#include <cstdio>
+
+// Native call cost: a loop calling a function registered through the
+// embedding API against the same function written in RV, reported as ns per
+// call over an empty loop.
+
+static Value clamp(Value* args) {
+    if (!args[0].is_int() || !args[1].is_int() || !args[2].is_int()) throw std::runtime_error("clamp() expects ints");
+    int v = args[0].as_int(), lo = args[1].as_int(), hi = args[2].as_int();
+    return Value(v < lo ? lo : (v > hi ? hi : v));
+}
+
+static const int N = 200000;
+
+static double run_program(const std::string& body) {
+    std::string source =
+        "function clamp_rv(v, lo, hi) { if (v < lo) { return lo; } if (v > hi) { return hi; } return v; }"
+        "let i = 0; let sum = 0;"
+        "while (i < " + std::to_string(N) + ") { " + body + " i = i + 1; }"
+        "print(sum);";
+
+    std::vector<Expression*> exps = bench::parse(source);
+    IRGenerator gen;
+    gen.generate_ir_code(exps);
+    double ns = bench::best_ns(3, [&]() {
+        Interpreter interpreter(gen);
+        interpreter.execute();
+    });
+    utils::cleanup_expressions(exps);
+    return ns;
+}
+
+int main() {
+    builtin::register_native("clamp", {"v", "lo", "hi"}, clamp);
+
+    double empty = run_program("sum = sum + i % 30;");
+    double native = run_program("sum = sum + clamp(i % 30, 10, 20);");
+    double rv = run_program("sum = sum + clamp_rv(i % 30, 10, 20);");
+    double builtin_call = run_program("sum = sum + size(string(i % 30));");
+
+    std::printf("%-22s %12s\n", "call", "ns/call");
+    std::printf("%-22s %12.1f\n", "native clamp()", (native - empty) / N);
+    std::printf("%-22s %12.1f\n", "RV clamp_rv()", (rv - empty) / N);
+    std::printf("%-22s %12.1f\n", "builtin string()", (builtin_call - empty) / N);
+}
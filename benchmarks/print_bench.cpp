@@ -0,0 +1,54 @@
+#include "bench.hpp"
+#include "interpreter.hpp"
+
+#include <chrono>
+#include <cstdio>
+
+// Print throughput: a program printing 10^6 lines with stdout on /dev/null,
+// so every flush is a real write syscall, under each flush policy. Results
+// go to stderr.
+
+static double run(IRGenerator& gen, FlushPolicy policy) {
+    double best = -1;
+    for (int i = 0; i < 3; i++) {
+        Interpreter interpreter(gen);
+        interpreter.set_output_policy(policy);
+        auto start = std::chrono::steady_clock::now();
+        interpreter.execute();
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        if (best < 0 || ns < best) best = ns;
+    }
+    return best;
+}
+
+int main() {
+    const int lines = 1000000;
+    std::vector<Expression*> exps = bench::parse(
+        "let i = 0; while (i < " + std::to_string(lines) + ") { print(i); i = i + 1; }");
+    IRGenerator gen;
+    gen.generate_ir_code(exps);
+
+    if (!std::freopen("/dev/null", "w", stdout)) {
+        std::fprintf(stderr, "cannot redirect stdout\n");
+        return 1;
+    }
+
+    double empty = 0;
+    {
+        std::vector<Expression*> loop = bench::parse(
+            "let i = 0; while (i < " + std::to_string(lines) + ") { i = i + 1; }");
+        IRGenerator loop_gen;
+        loop_gen.generate_ir_code(loop);
+        empty = run(loop_gen, FlushPolicy::Full);
+        utils::cleanup_expressions(loop);
+    }
+
+    std::fprintf(stderr, "%-8s %12s %14s\n", "policy", "ns/line", "print ns/line");
+    const std::pair<const char*, FlushPolicy> policies[] = {
+        {"line", FlushPolicy::Line}, {"full", FlushPolicy::Full}, {"exit", FlushPolicy::Exit}};
+    for (const auto& [name, policy] : policies) {
+        double ns = run(gen, policy);
+        std::fprintf(stderr, "%-8s %12.1f %14.1f\n", name, ns / lines, (ns - empty) / lines);
+    }
+    utils::cleanup_expressions(exps);
+}
@@ -0,0 +1,50 @@
+#include "bench.hpp"
+#include "interpreter.hpp"
+
+#include <cstdio>
+
+// Profiler overhead: the same programs on the VM with and without
+// --profile, JIT off so every instruction is dispatched. The plain run uses
+// a loop with no profiling code in it, this shows what turning it on costs.
+
+struct Program {
+    const char* name;
+    std::string source;
+};
+
+static const std::vector<Program> programs = {
+    {"counter",
+        "let i = 0; let sum = 0;"
+        "while (i < 300000) { sum = sum + i % 7; i = i + 1; }"
+        "print(sum);"},
+    {"fib",
+        "function fib(n) { if (n < 2) { return n; } return fib(n - 1) + fib(n - 2); }"
+        "print(fib(20));"},
+    {"list_build",
+        "let xs = []; let i = 0;"
+        "while (i < 20000) { xs = append(xs, i * 2); i = i + 1; }"
+        "print(size(xs));"},
+};
+
+static double run_ms(const std::vector<Expression*>& exps, bool profiled) {
+    return bench::best_ns(3, [&]() {
+        IRGenerator gen;
+        gen.generate_ir_code(exps);
+        Interpreter interpreter(gen);
+        interpreter.set_jit(false);
+        interpreter.set_tracing(false);
+        interpreter.set_profiling(profiled);
+        interpreter.execute();
+    }) / 1e6;
+}
+
+int main() {
+    std::printf("%-11s %12s %12s %9s\n", "program", "plain ms", "profiled ms", "overhead");
+    for (const Program& program : programs) {
+        std::vector<Expression*> exps = bench::parse(program.source);
+        double plain = run_ms(exps, false);
+        double profiled = run_ms(exps, true);
+        std::printf("%-11s %12.2f %12.2f %8.2fx\n", program.name, plain, profiled, profiled / plain);
+        utils::cleanup_expressions(exps);
+    }
+}
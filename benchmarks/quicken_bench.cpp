@@ -0,0 +1,78 @@
+#include "bench.hpp"
+#include "interpreter.hpp"
+#include "bytecode.hpp"
+
+#include <cstdio>
+
+// Quickening: runs numeric, string and type-changing programs with the VM
+// rewriting binary ops to their specialised forms and without, reports ns
+// per dispatched instruction and how many words ended up quickened.
+
+struct Program {
+    const char* name;
+    std::string source;
+};
+
+static const std::vector<Program> programs = {
+    {"arith_loop",
+        "let i = 0; let sum = 0;"
+        "while (i < 200000) { sum = sum + i * 2 - (i % 7) / 3; i = i + 1; }"
+        "print(sum);"},
+    {"compare_loop",
+        "let i = 0; let hits = 0;"
+        "while (i < 200000) { if (i % 3 == 0) { hits = hits + 1; } if (i > hits) { hits = hits + 0; } i = i + 1; }"
+        "print(hits);"},
+    {"string_loop",
+        "let i = 0; let s = \"\";"
+        "while (i < 20000) { s = s + \"ab\"; i = i + 1; }"
+        "print(size(s));"},
+    {"polymorphic",
+        "function add(a, b) { return a + b; }"
+        "let i = 0; let n = 0; let s = \"\";"
+        "while (i < 20000) { n = add(n, 1); s = add(\"\", \"x\"); i = i + 1; }"
+        "print(n); print(s);"},
+};
+
+static int quickened_words(const IRGenerator& gen) {
+    int count = 0;
+    for (Bytecode w : gen._code) {
+        OPCode op = bytecode::op(w);
+        if (op >= ADD_INT_INT && op < WIDE) count++;
+    }
+    return count;
+}
+
+// a fresh generator per configuration, quickened words outlive the run
+static double ns_per_op(const std::string& source, bool quickening, int& quickened) {
+    std::vector<Expression*> exps = bench::parse(source);
+    IRGenerator gen;
+    gen.generate_ir_code(exps);
+    double ns = bench::best_ns(9, [&]() {
+        Interpreter interpreter(gen);
+        interpreter.set_jit(false);
+        interpreter.set_tracing(false);
+        interpreter.set_quickening(quickening);
+        interpreter.execute();
+    });
+    // only a profiled run counts its dispatches
+    Interpreter counted(gen);
+    counted.set_jit(false);
+    counted.set_tracing(false);
+    counted.set_quickening(quickening);
+    counted.set_profiling(true);
+    bench::time_ns([&]() { counted.execute(); });
+    uint64_t count = counted.dispatch_count();
+    quickened = quickened_words(gen);
+    utils::cleanup_expressions(exps);
+    return ns / count;
+}
+
+int main() {
+    std::printf("%-14s %14s %14s %9s %10s\n", "program", "generic ns/op", "quickened", "speedup", "rewritten");
+    for (const Program& program : programs) {
+        int unused, quickened;
+        double generic = ns_per_op(program.source, false, unused);
+        double quick = ns_per_op(program.source, true, quickened);
+        std::printf("%-14s %14.2f %14.2f %8.2fx %10d\n", program.name, generic, quick, generic / quick, quickened);
+    }
+}
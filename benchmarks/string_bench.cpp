@@ -0,0 +1,51 @@
+#include "bench.hpp"
+#include "interpreter.hpp"
+#include "ssa_generator.hpp"
+
+#include <cstdio>
+
+// String building: the time per character of s = s + c up to n characters,
+// alone and with a size() read every step, and of a single s * n, should
+// stay flat as n grows to 10^6.
+
+static double run_program(const std::string& source, bool optimize) {
+    std::vector<Expression*> exps = bench::parse(source);
+    IRGenerator plain_gen;
+    SSAGenerator ssa_gen;
+    IRGenerator& gen = optimize ? ssa_gen : plain_gen;
+    gen.generate_ir_code(exps);
+
+    double ns = bench::best_ns(3, [&]() {
+        Interpreter interpreter(gen);
+        interpreter.execute();
+    });
+    utils::cleanup_expressions(exps);
+    return ns;
+}
+
+static void concat_scaling(int n, const std::string& step) {
+    std::string source =
+        "let s = \"\"; let i = 0; let total = 0;"
+        "while (i < " + std::to_string(n) + ") { " + step + " i = i + 1; }"
+        "print(size(s)); print(total);";
+
+    double plain = run_program(source, false) / n;
+    double optimized = run_program(source, true) / n;
+    std::printf("%-10d %14.1f %14.1f\n", n, plain, optimized);
+}
+
+static void multiply_scaling(int n) {
+    std::string source = "let s = \"ab\" * " + std::to_string(n / 2) + "; print(size(s));";
+    std::printf("%-10d %14.2f\n", n, run_program(source, false) / n);
+}
+
+int main() {
+    std::printf("%-10s %14s %14s\n", "s + c n", "ns/char", "ns/char (-O)");
+    for (int n : {100000, 200000, 500000, 1000000}) concat_scaling(n, "s = s + \"x\";");
+
+    std::printf("\n%-10s %14s %14s\n", "+ size n", "ns/char", "ns/char (-O)");
+    for (int n : {100000, 200000, 500000, 1000000}) concat_scaling(n, "s = s + \"x\"; total = total + size(s);");
+
+    std::printf("\n%-10s %14s\n", "s * n", "ns/char");
+    for (int n : {100000, 200000, 500000, 1000000}) multiply_scaling(n);
+}
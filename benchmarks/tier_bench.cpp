@@ -0,0 +1,111 @@
+#include "bench.hpp"
+#include "interpreter.hpp"
+#include "tree_evaluator.hpp"
+
+#include <chrono>
+#include <cstdio>
+
+// Tiered execution: time to the first printed line and total wall time, parse
+// included, of the VM (the whole program compiled before it runs), the tree
+// evaluator, and the tree evaluator moving hot functions to the VM.
+
+using Clock = std::chrono::steady_clock;
+
+// swallows the output, noting when it started
+struct FirstOutput : std::streambuf {
+    Clock::time_point at;
+    bool seen = false;
+    void note() {
+        if (!seen) at = Clock::now();
+        seen = true;
+    }
+    int overflow(int c) override { note(); return c; }
+    std::streamsize xsputn(const char*, std::streamsize n) override { note(); return n; }
+};
+
+enum class Engine { VM, Tree, Tiered };
+
+struct Timing {
+    double first_ms;
+    double total_ms;
+};
+
+static std::string long_script() {
+    std::string source = "print(0); let sum = 0;";
+    for (int i = 0; i < 3000; i++) {
+        std::string v = "v" + std::to_string(i);
+        source += "let " + v + " = " + std::to_string(i) + " * 3 % 7; if (" + v + " > 3) { sum = sum + " + v + "; }";
+    }
+    return source + "print(sum);";
+}
+
+struct Program {
+    const char* name;
+    std::string source;
+};
+
+static const std::vector<Program> programs = {
+    {"long_script", long_script()},
+    {"hot_calls",
+        "function step(x) { return x * x % 7 + x / 3; }"
+        "print(0); let i = 0; let sum = 0;"
+        "while (i < 200000) { sum = sum + step(i); i = i + 1; }"
+        "print(sum);"},
+    {"fib",
+        "function fib(n) { if (n < 2) { return n; } return fib(n - 1) + fib(n - 2); }"
+        "print(0); print(fib(25));"},
+    {"list_walk",
+        "function total(xs) { let i = 0; let s = 0; while (i < size(xs)) { s = s + xs[i]; i = i + 1; } return s; }"
+        "print(0); let xs = []; let i = 0;"
+        "while (i < 500) { xs = append(xs, i); i = i + 1; }"
+        "let rounds = 0; let sum = 0;"
+        "while (rounds < 2000) { sum = sum + total(xs); rounds = rounds + 1; }"
+        "print(sum);"},
+};
+
+static Timing run(const std::string& source, Engine engine) {
+    FirstOutput probe;
+    std::streambuf* old = std::cout.rdbuf(&probe);
+    Clock::time_point start = Clock::now();
+
+    std::vector<Expression*> exps = bench::parse(source);
+    if (engine == Engine::VM) {
+        IRGenerator gen;
+        gen.generate_ir_code(exps);
+        Interpreter interpreter(gen);
+        interpreter.set_output_policy(FlushPolicy::Line);
+        interpreter.execute();
+    } else {
+        TreeEvaluator evaluator;
+        evaluator.set_output_policy(FlushPolicy::Line);
+        if (engine == Engine::Tiered) evaluator.set_tier_threshold(TreeEvaluator::DEFAULT_TIER_THRESHOLD);
+        evaluator.evaluate_commands(exps);
+    }
+
+    Clock::time_point end = Clock::now();
+    std::cout.rdbuf(old);
+    utils::cleanup_expressions(exps);
+    auto ms = [&](Clock::time_point t) { return std::chrono::duration<double, std::milli>(t - start).count(); };
+    return {ms(probe.at), ms(end)};
+}
+
+static Timing best(const std::string& source, Engine engine) {
+    Timing res = run(source, engine);
+    for (int i = 0; i < 2; i++) {
+        Timing t = run(source, engine);
+        res.first_ms = std::min(res.first_ms, t.first_ms);
+        res.total_ms = std::min(res.total_ms, t.total_ms);
+    }
+    return res;
+}
+
+int main() {
+    std::printf("%-12s %-7s %14s %12s\n", "program", "engine", "first out ms", "total ms");
+    for (const Program& program : programs) {
+        for (Engine engine : {Engine::VM, Engine::Tree, Engine::Tiered}) {
+            Timing t = best(program.source, engine);
+            const char* name = engine == Engine::VM ? "vm" : engine == Engine::Tree ? "tree" : "tiered";
+            std::printf("%-12s %-7s %14.3f %12.2f\n", program.name, name, t.first_ms, t.total_ms);
+        }
+    }
+}
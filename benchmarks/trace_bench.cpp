@@ -0,0 +1,63 @@
+#include "bench.hpp"
+#include "interpreter.hpp"
+#include "ssa_generator.hpp"
+
+#include <cstdio>
+
+// Tracing JIT: runs loop heavy programs in the VM with hot while loops
+// compiled to native traces and without, reports the wall time of each and
+// how many loops traced.
+
+struct Program {
+    const char* name;
+    std::string source;
+};
+
+static const std::vector<Program> programs = {
+    {"counter",
+        "let i = 0; let sum = 0;"
+        "while (i < 3000000) { sum = sum + i % 7; i = i + 1; }"
+        "print(sum);"},
+    {"list_sum",
+        "let xs = []; let i = 0;"
+        "while (i < 1000) { xs = append(xs, i); i = i + 1; }"
+        "let rounds = 0; let sum = 0;"
+        "while (rounds < 1000) { i = 0; while (i < size(xs)) { sum = sum + xs[i]; i = i + 1; } rounds = rounds + 1; }"
+        "print(sum);"},
+    {"branchy",
+        "let i = 0; let evens = 0; let odds = 0;"
+        "while (i < 2000000) { if (i % 2 == 0) { evens = evens + i; } else { odds = odds + 1; } i = i + 1; }"
+        "print(evens); print(odds);"},
+    {"nested",
+        "let row = 0; let grid = 0;"
+        "while (row < 1000) { let col = 0; while (col < 1000) { grid = grid + row * col % 3; col = col + 1; } row = row + 1; }"
+        "print(grid);"},
+};
+
+static double run_ms(const std::string& source, bool optimize, bool tracing, int& traced) {
+    std::vector<Expression*> exps = bench::parse(source);
+    IRGenerator plain_gen;
+    SSAGenerator ssa_gen;
+    IRGenerator& gen = optimize ? ssa_gen : plain_gen;
+    gen.generate_ir_code(exps);
+    double ns = bench::best_ns(3, [&]() {
+        Interpreter interpreter(gen);
+        interpreter.set_tracing(tracing);
+        interpreter.execute();
+        traced = interpreter.trace_count();
+    });
+    utils::cleanup_expressions(exps);
+    return ns / 1e6;
+}
+
+int main() {
+    std::printf("%-10s %-9s %12s %12s %9s %7s\n", "program", "codegen", "vm ms", "trace ms", "speedup", "traced");
+    for (const Program& program : programs) {
+        for (bool optimize : {false, true}) {
+            int unused, traced;
+            double vm = run_ms(program.source, optimize, false, unused);
+            double trace = run_ms(program.source, optimize, true, traced);
+            std::printf("%-10s %-9s %12.2f %12.2f %8.1fx %7d\n", program.name, optimize ? "ssa" : "plain", vm, trace, vm / trace, traced);
+        }
+    }
+}
@@ -0,0 +1,60 @@
+#include "bench.hpp"
+#include "interpreter.hpp"
+#include "ssa_generator.hpp"
+
+#include <cstdio>
+
+// Unboxed int registers: numeric programs compiled by the plain generator,
+// by the SSA tier with every value boxed, and by the SSA tier keeping the
+// values it proves int or bool in the int register bank. Reports wall time
+// per run.
+
+struct Program {
+    const char* name;
+    std::string source;
+};
+
+static const std::vector<Program> programs = {
+    {"arith_loop",
+        "let i = 0; let sum = 0;"
+        "while (i < 200000) { sum = sum + i * 2 - (i % 7) / 3; i = i + 1; }"
+        "print(sum);"},
+    {"nested_loops",
+        "let i = 0; let count = 0;"
+        "while (i < 400) { let j = 0; while (j < 400) { if (i % 3 == j % 5) { count = count + 1; } j = j + 1; } i = i + 1; }"
+        "print(count);"},
+    {"bool_logic",
+        "let i = 0; let flag = false; let hits = 0;"
+        "while (i < 200000) { flag = (i > 10 && i < 150000) || !flag; if (flag) { hits = hits + 1; } i = i + 1; }"
+        "print(hits);"},
+    {"mixed_list",
+        "let xs = [3, 1, 4, 1, 5, 9, 2, 6]; let i = 0; let sum = 0;"
+        "while (i < 100000) { sum = sum + xs[i % 8] * 2; i = i + 1; }"
+        "print(sum);"},
+};
+
+static double run_ms(IRGenerator& gen, const std::string& source) {
+    std::vector<Expression*> exps = bench::parse(source);
+    gen.generate_ir_code(exps);
+    double ns = bench::best_ns(5, [&]() {
+        Interpreter interpreter(gen);
+        interpreter.set_jit(false);
+        interpreter.set_tracing(false);
+        interpreter.execute();
+    });
+    utils::cleanup_expressions(exps);
+    return ns / 1e6;
+}
+
+int main() {
+    std::printf("%-14s %10s %10s %10s %9s\n", "program", "plain ms", "boxed ms", "unboxed ms", "speedup");
+    for (const Program& program : programs) {
+        IRGenerator plain;
+        SSAGenerator boxed, unboxed;
+        boxed.set_unboxing(false);
+        double plain_ms = run_ms(plain, program.source);
+        double boxed_ms = run_ms(boxed, program.source);
+        double unboxed_ms = run_ms(unboxed, program.source);
+        std::printf("%-14s %10.2f %10.2f %10.2f %8.2fx\n", program.name, plain_ms, boxed_ms, unboxed_ms, boxed_ms / unboxed_ms);
+    }
+}
@@ -0,0 +1,218 @@
+#include "bench.hpp"
+#include "interpreter.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <variant>
+
+// Value representation benchmark: register file bandwidth of the tagged
+// Value against the std::variant layout it replaced, heap allocations per
+// dispatched VM instruction and per loop iteration, the cost of indexing
+// long lists and of serialising a nested list for print.
+
+static uint64_t allocations = 0;
+
+void* operator new(std::size_t n) {
+    allocations++;
+    if (void* p = std::malloc(n ? n : 1)) return p;
+    throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+// the previous representation, kept here only as a baseline
+struct VariantValue {
+    std::variant<int, bool, std::string, std::vector<VariantValue>> data;
+};
+
+const int NUM_REGS = 256;
+const int FRAME_COPIES = 20000;
+
+// PUSH copies the caller's registers, so copying a full frame of ints is the
+// bandwidth the VM sees on every call
+template <typename V>
+static void frame_copy(const char* name, const std::vector<V>& regs) {
+    size_t count = regs.size() * FRAME_COPIES;
+    double ns = bench::best_ns(5, [&]() {
+        for (int i = 0; i < FRAME_COPIES; i++) {
+            std::vector<V> copy(regs);
+            asm volatile("" : : "r"(copy.data()) : "memory");
+        }
+    });
+    std::printf("%-14s %12.2f %12.2f\n", name, count / ns * 1000, count * sizeof(V) / ns);
+}
+
+static void alloc_per_instr(const char* name, const std::string& source) {
+    std::vector<Expression*> exps = bench::parse(source);
+    IRGenerator gen;
+    gen.generate_ir_code(exps);
+
+    Interpreter interpreter(gen);
+    uint64_t before = allocations;
+    bench::time_ns([&]() { interpreter.execute(); });
+    uint64_t allocs = allocations - before;
+    // only a profiled run counts its dispatches
+    Interpreter counted(gen);
+    counted.set_profiling(true);
+    bench::time_ns([&]() { counted.execute(); });
+    uint64_t instrs = counted.dispatch_count();
+    std::printf("%-14s %12llu %12llu %10.3f\n", name, static_cast<unsigned long long>(instrs),
+        static_cast<unsigned long long>(allocs), static_cast<double>(allocs) / instrs);
+
+    utils::cleanup_expressions(exps);
+}
+
+// the frame's registers and variables are allocated on the first
+// iteration, so the difference of two trip counts is what the loop body
+// itself allocates, zero for int and bool arithmetic
+static void alloc_per_iteration(const char* name, const std::string& body) {
+    auto allocs = [&](int iters) {
+        std::vector<Expression*> exps = bench::parse(
+            "let i = 0; let sum = 0; let flag = false;"
+            "while (i < " + std::to_string(iters) + ") { " + body + " i = i + 1; }"
+            "print(sum % 2); print(flag);"); // same output length for both trip counts
+        IRGenerator gen;
+        gen.generate_ir_code(exps);
+        Interpreter interpreter(gen);
+        uint64_t before = allocations;
+        bench::time_ns([&]() { interpreter.execute(); });
+        uint64_t count = allocations - before;
+        utils::cleanup_expressions(exps);
+        return count;
+    };
+    const int iters = 100000;
+    uint64_t extra = allocs(iters + 1000) - allocs(1000);
+    std::printf("%-14s %12llu %10.3f\n", name, static_cast<unsigned long long>(extra), static_cast<double>(extra) / iters);
+}
+
+// every int and bool operator, assigned to a destination the way the VM
+// writes registers
+static void operator_allocs() {
+    const int n = 100000;
+    const int ops_per_round = 16;
+    Value dst, a(7), b(3), t(true), f(false);
+    uint64_t before = allocations;
+    double ns = bench::best_ns(3, [&]() {
+        for (int i = 0; i < n; i++) {
+            dst = a + b; dst = a - b; dst = a * b; dst = a / b;
+            dst = a % b; dst = a.pow(b); dst = -a; dst = a == b;
+            dst = a != b; dst = a < b; dst = a <= b; dst = a > b;
+            dst = a >= b; dst = t && f; dst = t || f; dst = !t;
+            asm volatile("" : : "r"(&dst) : "memory");
+        }
+    });
+    std::printf("%-14s %12llu %10.2f\n", "int/bool ops", static_cast<unsigned long long>(allocations - before),
+        ns / (n * ops_per_round));
+}
+
+static double time_program(const std::string& source) {
+    std::vector<Expression*> exps = bench::parse(source);
+    IRGenerator gen;
+    gen.generate_ir_code(exps);
+
+    double ns = bench::best_ns(3, [&]() {
+        Interpreter interpreter(gen);
+        interpreter.execute();
+    });
+    utils::cleanup_expressions(exps);
+    return ns;
+}
+
+// reads should not depend on the list length now that registers and
+// variables share the list instead of copying it, building the list is
+// timed separately and subtracted
+static void list_index_scaling(int n) {
+    const int reads = 50000;
+    auto program = [&](int iters) {
+        return "let xs = [1] * " + std::to_string(n) + "; let i = 0; let sum = 0;"
+            "while (i < " + std::to_string(iters) + ") { sum = sum + xs[i % 1000]; i = i + 1; }"
+            "print(sum);";
+    };
+    double ns = time_program(program(reads)) - time_program(program(0));
+    std::printf("%-14d %12.1f\n", n, ns / reads);
+}
+
+// the previous serialiser, which copied every list it printed and built a
+// stream per nesting level, kept here only as a baseline
+static std::string string_of_list(std::vector<Value> arr);
+static std::string copying_to_string(const Value& v) {
+    if (v.is_list()) return string_of_list(v.as_list());
+    return v.to_string(false);
+}
+static std::string string_of_list(std::vector<Value> arr) {
+    std::ostringstream oss;
+    oss << "[";
+    for (size_t i = 0; i < arr.size(); i++) oss << (i ? ", " : "") << copying_to_string(arr[i]);
+    oss << "]";
+    return oss.str();
+}
+
+template <typename Fn>
+static void serialise(const char* name, Fn&& fn) {
+    const int reps = 20;
+    size_t bytes = 0;
+    uint64_t before = allocations;
+    double ns = bench::best_ns(reps, [&]() { bytes = fn(); });
+    uint64_t allocs = (allocations - before) / reps;
+    std::printf("%-14s %12.1f %12llu %10zu\n", name, ns / 1000, static_cast<unsigned long long>(allocs), bytes);
+}
+
+int main() {
+    std::printf("sizeof(Value) = %zu, sizeof(variant value) = %zu\n\n", sizeof(Value), sizeof(VariantValue));
+
+    std::vector<Value> tagged;
+    std::vector<VariantValue> variant;
+    for (int i = 0; i < NUM_REGS; i++) {
+        tagged.push_back(Value(i));
+        variant.push_back(VariantValue{i});
+    }
+    std::printf("%-14s %12s %12s\n", "frame copy", "Mregs/s", "GB/s");
+    frame_copy("tagged", tagged);
+    frame_copy("variant", variant);
+    std::printf("\n");
+
+    std::printf("%-14s %12s %12s %10s\n", "program", "instrs", "allocs", "per instr");
+    alloc_per_instr("int_loop",
+        "let i = 0; let sum = 0;"
+        "while (i < 100000) { sum = sum + i * 2 - (i % 7); i = i + 1; }"
+        "print(sum);");
+    alloc_per_instr("string_loop",
+        "let i = 0; let s = \"\";"
+        "while (i < 2000) { s = s + \"x\"; i = i + 1; }"
+        "print(size(s));");
+    alloc_per_instr("list_access",
+        "let xs = [1, 2, 3, 4, 5, 6, 7, 8]; let i = 0; let sum = 0;"
+        "while (i < 20000) { sum = sum + xs[i % 8]; i = i + 1; }"
+        "print(sum);");
+
+    std::printf("\n%-14s %12s %10s\n", "loop body", "allocs", "per iter");
+    alloc_per_iteration("int_arith", "sum = sum + i * 2 - (i % 7) / 3;");
+    alloc_per_iteration("int_compare", "if (i % 3 == 0) { sum = sum + 1; }");
+    alloc_per_iteration("bool_logic", "flag = (i > 10 && i < 50) || !flag;");
+    alloc_per_iteration("string_concat", "let s = \"ab\" + \"cd\";");
+
+    std::printf("\n%-14s %12s %10s\n", "operators", "allocs", "ns per op");
+    operator_allocs();
+
+    std::printf("\n%-14s %12s\n", "list length", "ns per read");
+    for (int n : {1000, 10000, 100000, 1000000}) list_index_scaling(n);
+
+    // 200 rows of 50 ints, strings and bools, printed as one line
+    std::vector<Value> rows;
+    for (int i = 0; i < 200; i++) {
+        std::vector<Value> row;
+        for (int j = 0; j < 50; j++) row.push_back(j % 3 == 0 ? Value(i * j) : j % 3 == 1 ? Value("cell") : Value(j % 2 == 0));
+        rows.push_back(Value(std::move(row)));
+    }
+    Value table(std::move(rows));
+    std::string buffer;
+    std::printf("\n%-14s %12s %12s %10s\n", "serialise", "us", "allocs", "bytes");
+    serialise("copying", [&]() { return copying_to_string(table).size(); });
+    serialise("to_string", [&]() { return table.to_string(false).size(); });
+    serialise("write_to", [&]() {
+        buffer.clear();
+        table.write_to(buffer, false);
+        return buffer.size();
+    });
+}
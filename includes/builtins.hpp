@@ -2,50 +2,54 @@
 #define BUILTINS_HPP
 
 #include "value.hpp"
-#include "expression.hpp"
 
-#include <set>
+#include <string>
 #include <vector>
-#include <map>
 
 namespace builtin {
 
-static const std::set<std::string> _builtin_functions = {"append", "remove", "type", "string"};
-static const std::map<std::string, int> builtin_to_fid = {
-    {"append", -1},
-    {"remove", -2},
-    {"type", -3},
-    {"string", -4},
-};
-
-static const std::map<int, std::string> fid_to_builtin = {
-    {-1, "append"},
-    {-2, "remove"},
-    {-3, "type"},
-    {-4, "string"},
-};
-
-Value append(Value v, Value x);
-static auto append_func_exp = FunctionAssignmentExpression("append", {"arr_val", "ele_val"}, {});
+// A native function gets exactly `arity` evaluated arguments, which it may
+// modify or move from, and returns the call's value. Errors are reported by
+// throwing std::runtime_error, like the rest of the VM.
+using NativeFn = Value (*)(Value* args);
 
-Value remove(Value v, Value x);
-static auto remove_func_exp = FunctionAssignmentExpression("remove", {"arr_val", "idx_val"}, {});
-
-Value type(Value v);
-static auto type_func_exp = FunctionAssignmentExpression("type", {"val"}, {});
+const int MAX_NATIVE_ARGS = 8;
 
-Value string(Value v);
-static auto string_func_exp = FunctionAssignmentExpression("string", {"val"}, {});
+struct NativeFunction {
+    std::string name;
+    std::vector<std::string> params; // only used for the signature
+    NativeFn fn;
+    // the result depends only on the args, and the call has no other effect
+    // (no I/O, no state kept between calls), so --memoize may cache callers
+    bool pure = false;
 
-static std::map<std::string, FunctionAssignmentExpression*> builtin_func_exps = {
-    {"append", &append_func_exp},
-    {"remove", &remove_func_exp},
-    {"type", &type_func_exp},
-    {"string", &string_func_exp},
+    int arity() const { return params.size(); }
+    std::string signature() const; // name(p1, p2)
 };
 
+// Registry of the functions RV code can call without defining them. The
+// standard builtins come first; an embedding application adds its own with
+// register_native before generating code. Calls compile to CALL_NATIVE with
+// the function's index, which the VM dispatches through this table.
+int register_native(const std::string& name, std::vector<std::string> params, NativeFn fn, bool pure = false);
+int find_native(const std::string& name); // index, or -1
+const std::vector<NativeFunction>& natives();
 bool is_builtin_func(const std::string& func_name);
 
+Value append(Value v, Value x);
+Value remove(Value v, Value x);
+Value type(const Value& v);
+Value string(const Value& v);
+Value pop(Value v);
+Value insert(Value v, Value i, Value x);
+
+// In place forms, used when the result is assigned back to the list's own
+// variable (x = append(x, e)), amortised O(1) at the end of the list
+void append_ref(Value& v, Value x);
+void remove_ref(Value& v, const Value& i);
+void pop_ref(Value& v);
+void insert_ref(Value& v, const Value& i, Value x);
+
 }
 
 
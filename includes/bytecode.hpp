@@ -0,0 +1,50 @@
+#ifndef BYTECODE_HPP
+#define BYTECODE_HPP
+
+#include "ir_generator.hpp"
+
+#include <cstdint>
+#include <vector>
+
+// Packed 8 byte VM instruction
+//   bits 0-7   opcode
+//   bits 8-23  A (int16)
+//   bits 24-47 B (int24)
+//   bits 48-63 C (int16)
+// Instruction args map to A, B, C in order, except JUMP which keeps its target
+// in B. An instruction whose operands do not fit is preceded by a WIDE word
+// carrying the high bits of A, B and C in the same positions.
+
+namespace bytecode {
+
+inline OPCode op(Bytecode w) { return static_cast<OPCode>(w & 0xff); }
+inline int a(Bytecode w) { return static_cast<int16_t>(w >> 8); }
+inline int b(Bytecode w) { return static_cast<int32_t>(static_cast<uint32_t>(w >> 16) & 0xffffff00u) >> 8; }
+inline int c(Bytecode w) { return static_cast<int16_t>(w >> 48); }
+inline Bytecode with_op(Bytecode w, OPCode op) { return (w & ~Bytecode(0xff)) | op; }
+
+inline int wide_a(Bytecode prefix, Bytecode w) {
+    return static_cast<int32_t>(((prefix >> 8) & 0xffff) << 16 | ((w >> 8) & 0xffff));
+}
+inline int wide_b(Bytecode prefix, Bytecode w) {
+    return static_cast<int32_t>(((prefix >> 24) & 0xff) << 24 | ((w >> 24) & 0xffffff));
+}
+inline int wide_c(Bytecode prefix, Bytecode w) {
+    return static_cast<int32_t>(((prefix >> 48) & 0xffff) << 16 | ((w >> 48) & 0xffff));
+}
+
+// Packs instrs[first...] to be placed at word address base, jump targets are
+// rewritten to word addresses. addr_of[i] is the word address of
+// instrs[first + i] (addr_of[instrs.size() - first] is the end).
+std::vector<Bytecode> assemble(const std::vector<Instruction>& instrs, std::vector<int>& addr_of, size_t first = 0, int base = 0);
+
+// the generic op a quickened word (ADD_INT_INT, ...) runs the same as
+OPCode generic(OPCode op);
+
+// Unpacks the instruction starting at addr (skipping over a WIDE prefix),
+// len is set to the number of words it occupies.
+Instruction decode(const std::vector<Bytecode>& code, size_t addr, size_t& len);
+
+} // namespace bytecode
+
+#endif // BYTECODE_HPP
@@ -0,0 +1,44 @@
+#ifndef CAPTURE_RESOLVER_HPP
+#define CAPTURE_RESOLVER_HPP
+
+#include "expression.hpp"
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+// Finds the variables a call's frame has to carry. A function runs on a
+// copy of its caller's variables, but only reads a few of them: its
+// upvalues, the names it (or anything it calls) may read before assigning
+// them itself. The frame pushed for a call needs those plus what the call's
+// args read, since they are evaluated in it. Calls resolve by name to every
+// function declared under it, so the sets hold whichever declaration a call
+// ends up running.
+//
+// The same walk finds the pure functions, whose value depends on nothing but
+// their args: no upvalues, no print, no functions declared in the body and
+// only pure or native callees. A callee's writes never reach the caller, so
+// with no upvalues there is nothing else a call can see or change.
+class CaptureResolver {
+private:
+    std::map<std::string, std::vector<FunctionAssignmentExpression*>> declared; // by name, nested ones included
+    std::map<std::string, std::set<std::string>> upvalues_of;                   // by function name
+    std::set<std::string> pure;
+
+    void declare(Expression* exp);
+    void collect(Expression* exp, std::set<std::string>& reads) const;
+    std::set<std::string> local_names(FunctionAssignmentExpression* func_exp) const;
+    bool effect_free(Expression* exp, std::set<std::string>& callees) const;
+    void resolve_pure();
+
+public:
+    void resolve(const std::vector<Expression*>& program);
+
+    // sorted names the frame of call_exp carries, false when no function of
+    // its name is declared and the frame has to copy everything
+    bool frame_of(const FunctionCallExpression* call_exp, std::vector<std::string>& names) const;
+    bool is_pure(const std::string& name) const { return pure.count(name) > 0; }
+};
+
+#endif // CAPTURE_RESOLVER_HPP
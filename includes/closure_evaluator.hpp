@@ -0,0 +1,64 @@
+#ifndef CLOSURE_EVALUATOR_HPP
+#define CLOSURE_EVALUATOR_HPP
+
+#include "expression.hpp"
+#include "output_writer.hpp"
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Tree evaluation without walking the tree: every node is turned once into
+// a C++ closure over the closures of its operands, with variables resolved
+// to slots of a flat frame and functions to entries of a binding table. It
+// runs programs the way TreeEvaluator does (a call gets a copy of the
+// caller's variables, functions are bound when their declaration runs), but
+// a return sets a flag in the frame instead of every node handing back a
+// (value, returned) pair.
+class ClosureEvaluator {
+private:
+    struct Slot {
+        Value value;
+        bool defined = false;
+    };
+
+    struct Frame {
+        std::vector<Slot> vars;
+        bool returning = false;
+    };
+
+    using Code = std::function<Value(Frame&)>;
+
+    struct Function {
+        std::vector<int> params;
+        std::vector<Code> body;
+    };
+
+    std::unordered_map<std::string, int> var_slots;
+    std::vector<std::string> var_names;
+    std::unordered_map<std::string, int> func_slots;
+    std::vector<Function*> bound;                       // by function slot, nullptr until declared
+    std::vector<std::unique_ptr<Function>> functions;   // every declaration, compiled once
+    OutputWriter output;
+
+    int var_slot(const std::string& name);
+    int func_slot(const std::string& name);
+
+    Code compile(Expression* exp);
+    Code compile_node(Expression* exp);
+    Code compile_let(AssignmentExpression* let_exp);
+    Code compile_call(FunctionCallExpression* call_exp);
+    std::vector<Code> compile_block(const std::vector<Expression*>& exps);
+
+    static Value run_block(const std::vector<Code>& block, Frame& frame);
+    [[noreturn]] void undefined(int slot) const;
+
+public:
+    void evaluate_commands(const std::vector<Expression*>& commands);
+
+    void set_output_policy(FlushPolicy policy, size_t capacity = OutputWriter::DEFAULT_CAPACITY) { output.configure(policy, capacity); }
+};
+
+#endif // CLOSURE_EVALUATOR_HPP
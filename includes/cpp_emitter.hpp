@@ -0,0 +1,73 @@
+#ifndef CPP_EMITTER_HPP
+#define CPP_EMITTER_HPP
+
+#include "expression.hpp"
+
+#include <map>
+#include <queue>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Ahead of time backend, translates a program's AST into one C++ translation
+// unit over cpp_runtime.hpp, built with
+//     g++ -std=c++20 -O2 -Iincludes prog.cpp bin/librv_runtime.a
+// Every RV function becomes a C++ function. In the VM a call runs on a copy
+// of the caller's variables, so a function takes its params and the caller
+// variables it (or anything it calls) may read as value parameters, and
+// keeps everything else it assigns in locals. Calls and variables resolve
+// the way the IRGenerator resolves them, so the binary prints what the VM
+// prints.
+class CppEmitter {
+private:
+    struct Function {
+        FunctionAssignmentExpression* exp = nullptr; // nullptr for the top level
+        std::string name;                            // of the C++ function
+        std::set<std::string> names;                 // its variables, params included
+        std::set<std::string> inherited;             // read from the caller's frame
+    };
+
+    std::vector<Function> functions;                         // [0] is the top level, then fid + 1
+    std::map<const Expression*, std::string> var_of;         // the variable a VarExp or assignment resolves to
+    std::map<const FunctionCallExpression*, int> callee_of;  // function index, or -1 - native id
+    std::map<std::string, int> string_ids;
+    std::set<int> natives_used;
+
+    // resolution, as IRGenerator does it
+    std::map<std::string, int> fid_of;
+    std::set<std::string> idents; // declared variable names
+    std::queue<int> func_queue;
+
+    // emission
+    std::ostringstream out;
+    std::map<std::string, std::string> bound; // params bound so far by the calls whose args are emitted
+    int temps = 0;
+    int depth = 0;
+
+    void resolve(Expression* exp, int f);
+    void declare(const std::string& name);
+    const std::string& declared(const std::string& name, int f);
+
+    void collect(Expression* exp, std::set<std::string>& mentions) const;
+    std::set<std::string> local_names(int f) const;
+    void find_frames(const std::vector<Expression*>& top_level);
+
+    bool has_effect(Expression* exp) const;
+    std::string lookup(const std::string& name) const;
+    std::string temp(const std::string& exp);
+    void line(const std::string& code);
+    std::vector<std::string> operands(const std::vector<Expression*>& exps);
+    std::string expression(Expression* exp);
+    std::string call(FunctionCallExpression* call_exp);
+    void statement(Expression* exp);
+    void block(const std::vector<Expression*>& exps);
+    void function(int f, const std::vector<Expression*>& body);
+    std::string signature(int f) const;
+
+public:
+    // throws where the IRGenerator would reject the program
+    std::string emit(const std::vector<Expression*>& exps);
+};
+
+#endif // CPP_EMITTER_HPP
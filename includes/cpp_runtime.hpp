@@ -0,0 +1,97 @@
+#ifndef CPP_RUNTIME_HPP
+#define CPP_RUNTIME_HPP
+
+#include "builtins.hpp"
+#include "output_writer.hpp"
+#include "value.hpp"
+#include "value_ops.hpp"
+
+#include <climits>
+#include <cstdint>
+#include <initializer_list>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Support code for the programs --emit-cpp generates (cpp_emitter.hpp). They
+// include this header and link against the runtime library, which is Value,
+// the operator matrix, the heap and the builtins. Int operands take the
+// inline paths below, every other type goes through the VM's own handlers,
+// so results and errors match the VM's.
+namespace rv {
+
+using value_ops::BinOp;
+
+// JNT's test, anything but a bool is compared with true and throws
+inline bool truthy(const Value& v) {
+    return v.is_bool() ? v.as_bool() : v.equals(Value(true));
+}
+
+// ints wrap like the VM's
+inline int wrap(int64_t i) { return static_cast<int>(static_cast<uint32_t>(i)); }
+
+#define RV_INT_BINARY(name, op, result)                                 \
+    inline Value name(const Value& a, const Value& b) {                 \
+        if (a.is_int() && b.is_int()) {                                 \
+            int x = a.as_int(), y = b.as_int();                         \
+            return Value(result);                                       \
+        }                                                               \
+        return value_ops::binary(BinOp::op, a, b);                      \
+    }
+
+RV_INT_BINARY(add, Add, wrap(static_cast<int64_t>(x) + y))
+RV_INT_BINARY(sub, Sub, wrap(static_cast<int64_t>(x) - y))
+RV_INT_BINARY(mul, Mul, wrap(static_cast<int64_t>(x) * y))
+RV_INT_BINARY(div, Div, value_ops::int_div(x, y))
+RV_INT_BINARY(mod, Mod, value_ops::int_mod(x, y))
+RV_INT_BINARY(gt, Gt, x > y)
+RV_INT_BINARY(gte, Gte, x >= y)
+RV_INT_BINARY(lt, Lt, x < y)
+RV_INT_BINARY(lte, Lte, x <= y)
+RV_INT_BINARY(eq, Eq, x == y)
+RV_INT_BINARY(neq, Neq, x != y)
+
+#undef RV_INT_BINARY
+
+inline Value pow(const Value& a, const Value& b) { return value_ops::binary(BinOp::Pow, a, b); }
+inline Value logical_and(const Value& a, const Value& b) { return value_ops::binary(BinOp::And, a, b); }
+inline Value logical_or(const Value& a, const Value& b) { return value_ops::binary(BinOp::Or, a, b); }
+
+inline Value list(std::initializer_list<Value> items) {
+    return Value(std::vector<Value>(items));
+}
+
+inline Value modify(Value list, const Value& idx, Value x) {
+    return list.modify_arr(idx, std::move(x));
+}
+
+// the native registered under name, looked up once when the program starts
+inline builtin::NativeFn native(const char* name) {
+    int nid = builtin::find_native(name);
+    if (nid < 0) throw std::runtime_error(std::string("native function ") + name + " is not in the runtime");
+    return builtin::natives()[nid].fn;
+}
+
+template <typename... Args>
+inline Value call(builtin::NativeFn fn, const Args&... args) {
+    static_assert(sizeof...(Args) <= builtin::MAX_NATIVE_ARGS, "too many native args");
+    Value argv[builtin::MAX_NATIVE_ARGS] = {args...};
+    return fn(argv);
+}
+
+// runs the program's top level, what it printed is written out even when
+// it throws
+template <typename Program>
+inline void run(Program program, OutputWriter& out) {
+    try {
+        program();
+    } catch (...) {
+        out.flush();
+        throw;
+    }
+    out.flush();
+}
+
+} // namespace rv
+
+#endif // CPP_RUNTIME_HPP
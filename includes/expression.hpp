@@ -74,13 +74,13 @@ class ConstExp : public Expression {
         Value value;
 
         ConstExp(const int& c): Expression(ExpressionType::CONST_EXP), const_type(ConstType::IntConst) {
-            value.data = c;
+            value = Value(c);
         }
         ConstExp(const bool& c): Expression(ExpressionType::CONST_EXP), const_type(ConstType::BoolConst) {
-            value.data = c;
+            value = Value(c);
         }
         ConstExp(const std::string& c): Expression(ExpressionType::CONST_EXP), const_type(ConstType::StringConst) {
-            value.data = c;
+            value = Value(c);
         }
 
         ConstType get_type() const { return const_type; }
@@ -89,9 +89,9 @@ class ConstExp : public Expression {
         Value evaluate(Environment& env) const override { return Value(); }
         Expression* clone() const override {
             switch (const_type) {
-                case ConstType::IntConst: return new ConstExp(std::get<int>(value.data));
-                case ConstType::StringConst: return new ConstExp(std::get<std::string>(value.data));
-                case ConstType::BoolConst: return new ConstExp(std::get<bool>(value.data));
+                case ConstType::IntConst: return new ConstExp(value.as_int());
+                case ConstType::StringConst: return new ConstExp(value.as_string());
+                case ConstType::BoolConst: return new ConstExp(value.as_bool());
                 default: throw std::runtime_error("Unknown ConstType in clone");
             }
         }
@@ -201,6 +201,8 @@ class AssignmentExpression : public Expression {
         const std::string& get_id() const { return ident; }
         Expression* get_right() const { return exp; }
         bool is_reassign() const { return reassignment; }
+        // arr[i]... = x, the parser roots the ListModifyExpression at ident
+        bool is_index_store() const { return reassignment && exp->get_signature() == ExpressionType::LIST_MODIFY_EXP; }
 
         Value evaluate(Environment& env) const override { return Value(); }
         Expression* clone() const override {
@@ -341,6 +343,14 @@ class ListModifyExpression : public Expression {
         Expression* get_idx_exp() const { return idx_exp; }
         Expression* get_exp() const { return exp; }
 
+        // arr[i][j] = x parses as modify(arr, i, modify(arr[i], j, x)), this
+        // collects the index path [i, j] and returns x
+        Expression* flatten(std::vector<Expression*>& idx_exps) const {
+            idx_exps.push_back(idx_exp);
+            if (exp->get_signature() != ExpressionType::LIST_MODIFY_EXP) return exp;
+            return dynamic_cast<ListModifyExpression*>(exp)->flatten(idx_exps);
+        }
+
         Value evaluate(Environment& env) const override { return Value(); }
         Expression* clone() const override {
             return new ListModifyExpression(
@@ -392,6 +402,7 @@ class FunctionCallExpression : public Expression {
     private:
         std::string func_name;
         std::vector<Expression*> arg_expressions;
+        bool user_function = false; // the program declares func_name, which shadows a native of that name
 
     public: 
         FunctionCallExpression(const std::string& name, const std::vector<Expression*>& args): 
@@ -406,13 +417,17 @@ class FunctionCallExpression : public Expression {
         const std::string& get_name() const { return func_name; }
         const std::vector<Expression*>& get_arg_exps() const {return arg_expressions; }
         size_t get_args_length() const { return arg_expressions.size(); }
+        bool calls_user_function() const { return user_function; }
+        void set_calls_user_function(bool b) { user_function = b; }
 
         Value evaluate(Environment& env) const override { return Value(); }
         Expression* clone() const override {
-            return new FunctionCallExpression(
+            FunctionCallExpression* call_exp = new FunctionCallExpression(
                 func_name, 
                 clone_vector<Expression*>(arg_expressions)
             );
+            call_exp->set_calls_user_function(user_function);
+            return call_exp;
         }
         
 };
@@ -0,0 +1,54 @@
+#ifndef HEAP_HPP
+#define HEAP_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+// Header of every string and list. Values own them through the reference
+// count, which also drives copy on write. Every object is linked into the
+// heap so it can be accounted for, and lists are traced by the cycle
+// collector, which reclaims lists that only keep each other alive.
+struct HeapObject {
+    uint32_t refs = 1;
+    uint32_t gc_refs = 0; // scratch count of the collector
+    HeapObject* gc_prev = nullptr;
+    HeapObject* gc_next = nullptr;
+};
+
+namespace heap {
+
+struct Config {
+    bool enabled = true;
+    size_t min_threshold = 10000; // list allocations between two collections
+    double growth = 1.0;          // or this many times the surviving lists, if larger
+};
+
+struct Stats {
+    size_t live_strings = 0;
+    size_t live_lists = 0;
+    uint64_t collections = 0;
+    uint64_t freed_lists = 0;     // reclaimed by the collector
+    double last_pause_ns = 0;
+    double max_pause_ns = 0;
+    double total_pause_ns = 0;
+};
+
+void configure(const Config& config);
+const Config& config();
+const Stats& stats();
+
+// Runs a full collection now, returns the number of lists freed
+size_t collect();
+// Walks the heap, strings and lists with their current capacity. Costs a
+// pass over every live object, so it is only run when asked for
+size_t heap_bytes();
+
+// called by Value when it creates and frees objects
+void track_string(HeapObject* obj);
+void track_list(HeapObject* obj);
+void untrack_string(HeapObject* obj);
+void untrack_list(HeapObject* obj);
+
+} // namespace heap
+
+#endif // HEAP_HPP
@@ -3,26 +3,39 @@
 
 #include "ir_generator.hpp"
 #include "expression.hpp"
+#include "output_writer.hpp"
+#include "jit.hpp"
+#include "trace_jit.hpp"
+#include "memo_cache.hpp"
+#include "profiler.hpp"
 
 #include <string>
 #include <vector>
 #include <stack>
 #include <map>
+#include <cstdint>
 
 
+// Threaded dispatch jumps straight from one handler to the next through a
+// table of label addresses (GCC/Clang computed goto), Switch is the portable
+// loop and is the only mode on other compilers.
+enum class DispatchMode { Switch, Threaded };
+
 struct RvStackFrame {
     std::map<int, Value> register_file;
     Environment env;
     int return_addr;
+    std::vector<int> int_regs; // unboxed ints and bools, see INT_ADD and friends
 };
 
 class Interpreter {
 private:
-    // IRGenerator& _gen;
-    std::vector<Instruction>& _instr;
+    IRGenerator& _gen; // compiles the stubs of lazily compiled functions
+    std::vector<Bytecode>& _code;
     std::vector<std::string>& _ident_table;
     std::vector<Value>& _const_table;
     std::vector<FunctionInfo>& _func_table;
+    std::vector<std::vector<std::string>>& _capture_table;
     // std::map<int, Value> register_file;
 
     int pc = 0;
@@ -31,14 +44,67 @@ private:
 
     RvStackFrame* current_frame;
     std::stack<RvStackFrame> program_stack;
-    void push_stack_frame();
+    void push_stack_frame(int captures, bool registers);
     void pop_stack_frame();
 
-    void handle_builtin_func(int a1, int a2, int a3);
+    DispatchMode dispatch_mode;
+    bool quickening = true;
+    Jit jit;
+    bool jit_enabled;
+    TraceJit traces;
+    bool tracing;
+    uint64_t dispatched = 0;
+    bool memoizing = false;
+    MemoCache memo;
+    struct PendingMemo {
+        size_t depth; // of the callee's frame
+        MemoCache::Key key;
+    };
+    std::vector<PendingMemo> memo_pending; // calls that missed, stored when they return
+    bool memo_call(int fid);
+    void memo_return();
+    OutputWriter own_output;
+    OutputWriter* output = &own_output; // or a writer shared with the caller, see share_output
+
+    bool profiling = false;
+    Profiler profile;
+
+    template <bool Threaded, bool Profiled> void run();
+    void run_loop();
 
 public:
     Interpreter(IRGenerator& gen);
     void execute();
+    // Runs function fid on a frame holding env, its params already bound, as
+    // if the top level had called it, and returns its value. Only for a
+    // program without top level code, the call returns to the END at 0.
+    Value call(int fid, Environment env);
+
+    static bool threaded_dispatch_supported();
+    void set_dispatch_mode(DispatchMode mode);
+    DispatchMode get_dispatch_mode() const { return dispatch_mode; }
+    // rewrite binary ops to type specialised forms as they run, see run()
+    void set_quickening(bool enabled) { quickening = enabled; }
+    // run hot int functions as native code, see jit.hpp
+    void set_jit(bool enabled) { jit_enabled = enabled && Jit::supported(); }
+    void set_jit_threshold(int calls) { jit.set_threshold(calls); }
+    int jit_compiled_count() const { return jit.compiled_count(); }
+    // run hot while loops as native traces, see trace_jit.hpp
+    void set_tracing(bool enabled) { tracing = enabled && TraceJit::supported(); }
+    void set_trace_threshold(int hits) { traces.set_threshold(hits); }
+    int trace_count() const { return traces.compiled_count(); }
+    // calls to pure functions return a cached value for args seen before,
+    // see memo_cache.hpp
+    void set_memoize(bool enabled) { memoizing = enabled; }
+    const MemoCache::Stats& memo_stats() const { return memo.stats(); }
+    // count and time every instruction the VM dispatches, see profiler.hpp
+    void set_profiling(bool enabled) { profiling = enabled; }
+    void print_profile() const;
+    uint64_t dispatch_count() const { return dispatched; } // instructions executed by the last profiled execute()
+    void set_output_policy(FlushPolicy policy, size_t capacity = OutputWriter::DEFAULT_CAPACITY) { output->configure(policy, capacity); }
+    // prints go to writer instead, and the owner of writer flushes it
+    void share_output(OutputWriter& writer) { output = &writer; }
+
     void print_reg_file() const;
     void print_env() const;
 
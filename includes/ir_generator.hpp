@@ -2,10 +2,12 @@
 #define IR_GENERATOR_HPP
 
 #include "expression.hpp"
+#include "capture_resolver.hpp"
 
 #include <string>
 #include <vector>
 #include <queue>
+#include <cstdint>
 
 enum InstructionType {
     ITYPE, // immediate
@@ -52,17 +54,69 @@ enum OPCode {
     APPEND,
     ACCESS,
     MODIFY,
+    STORE_INDEX,      // env[A][R[B]] = R[C], in place
+    STORE_INDEX_PATH, // env[A][R[B]]...[R[B + C - 1]] = R[B + C], in place
+    APPEND_VAR,       // env[A] = append(env[A], R[B]), in place
+    INSERT_VAR,       // env[A] = insert(env[A], R[B], R[C]), in place
+    REMOVE_VAR,       // env[A] = remove(env[A], R[B]), in place
+    POP_VAR,          // env[A] = pop(env[A]), in place
+    CALL_NATIVE,      // R[A] = natives[B](R[C], ..., R[C + arity - 1])
     MOVE_OP,
     // Control Flow Ops
     JNT, // Jump if not true
     JUMP,
     JUMPF, // Function jump (decode the register)
+    COMPILE_FUNC, // the entry of function A until its first call compiles it, see IRGenerator::compile_function
 
-    PUSH, 
+    PUSH, // push a frame for a call with the variables of capture set A (all of them when A is -1), and the registers when B is 1
     POP,
     RET,
+
+    // Unboxed ops on the frame's int register bank I, only emitted by the SSA
+    // tier for values it proves are ints or bools (kept as 0 / 1)
+    INT_LOAD_CONST, // I[A] = K[B]
+    INT_MOVE,       // I[A] = I[B]
+    BOX_INT,        // R[A] = I[B] as an int
+    BOX_BOOL,       // R[A] = I[B] as a bool
+    UNBOX,          // I[A] = R[B], which holds an int or a bool
+    INT_ADD,        // I[A] = I[B] op I[C]
+    INT_SUB,
+    INT_MUL,
+    INT_DIV,
+    INT_MOD,
+    INT_LT,
+    INT_LTE,
+    INT_GT,
+    INT_GTE,
+    INT_EQ,
+    INT_NEQ,
+    INT_AND,
+    INT_OR,
+    INT_NOT,        // I[A] = op I[B]
+    INT_NEG,
+    INT_JNT,        // jump to B if I[A] is 0
+
+    // Quickened forms of the binary ops, never generated: the VM rewrites a
+    // generic op to one of these after seeing its operand types, and back
+    // when the guard on those types fails
+    ADD_INT_INT,
+    ADD_STR_STR,
+    SUB_INT_INT,
+    MUL_INT_INT,
+    DIV_INT_INT,
+    MOD_INT_INT,
+    LT_INT_INT,
+    LTE_INT_INT,
+    GT_INT_INT,
+    GTE_INT_INT,
+    EQ_INT_INT,
+    NEQ_INT_INT,
+
+    WIDE, // operand prefix of the packed encoding, keep it last
 };
 
+const int NUM_OPCODES = WIDE + 1;
+
 struct Instruction {
     InstructionType type;
     OPCode op;
@@ -71,14 +125,21 @@ struct Instruction {
     int arg3;
 };
 
+// packed form executed by the VM, see bytecode.hpp
+using Bytecode = uint64_t;
+
 struct FunctionInfo {
     std::string name; // name of function 
     int start_addr; // address (idx) of function's instructions
     FunctionAssignmentExpression* func_exp;
+    bool stub = false; // start_addr is a COMPILE_FUNC word, the body is not generated yet
+    bool pure = false; // its value depends only on its args, see CaptureResolver
 };
 
+std::string to_string(OPCode op);
+
 class IRGenerator {
-private:
+protected:
     std::queue<int> func_assign_queue;
 
     std::map<std::string, int> ident_to_idx;
@@ -86,6 +147,11 @@ private:
     std::map<int, std::string> addr_to_ident;
 
     int curr_reg = 0;
+    bool lazy = true;
+    bool in_function = false; // generating a function body
+
+    CaptureResolver captures;
+    std::map<std::vector<std::string>, int> capture_ids;
 
     int gen_empty_exp_ir(EmptyExpression* empty_exp);
     int gen_const_exp_ir(ConstExp* const_exp);
@@ -100,22 +166,64 @@ private:
     int gen_list_exp_ir(ListExpression* list_exp);
     int gen_list_access_exp_ir(ListAccessExpression* access_exp);
     int gen_list_modify_exp_ir(ListModifyExpression* modify_exp);
+    int gen_store_index_ir(AssignmentExpression* let_exp);
+    int gen_in_place_call_ir(AssignmentExpression* let_exp, OPCode op);
+    int gen_native_call_ir(FunctionCallExpression* call_exp, int nid);
     
+    int declared_ident(const std::string& name); // intern_ident, checking top level assignments
     int store_func_assign_exp(FunctionAssignmentExpression* func_exp);
     int generate_ir_block(Expression* exp);
+    std::vector<int> define_functions();
 
-    OPCode map_binexp_to_opcode(BinaryOperator op) const;
+    void assemble();
+    void assemble_tail(size_t first, const std::vector<int>& fids);
 
 public:
     IRGenerator() {}
-    std::vector<Instruction>& generate_ir_code(const std::vector<Expression*>& _exps);
+    virtual ~IRGenerator() {}
+    virtual std::vector<Instruction>& generate_ir_code(const std::vector<Expression*>& _exps);
 
     std::vector<Instruction> _instr;
+    std::vector<Bytecode> _code;
     std::vector<std::string> _ident_table;
     std::vector<Value> _const_table;
     std::vector<FunctionInfo> _func_table;
+    std::vector<std::vector<std::string>> _capture_table; // sorted variable names, see PUSH
+    int _int_reg_count = 0; // size of the VM's int register bank
+
+    // Lazy compilation (the default): generate_ir_code leaves every function
+    // as a COMPILE_FUNC stub, and the VM generates a body the first time the
+    // function is called, so functions that never run cost one word. Names
+    // resolve the same whichever order bodies compile in (see intern_ident),
+    // the only difference is that an error in a body is raised on its first
+    // call instead of before the program starts.
+    void set_lazy(bool enabled) { lazy = enabled; }
+    // generates and assembles fid's body onto the end of the code and points
+    // its table entry at it, false when it is not a stub
+    bool compile_function(int fid);
+
+    // the capture set PUSH gets for call_exp, -1 to copy the whole frame
+    int capture_id(const FunctionCallExpression* call_exp);
+
+    // lets code refer to name without a let of it, for functions compiled
+    // apart from the program that declares their variables
+    void declare_variable(const std::string& name);
+    // Variables resolve by name, an index only picks the name out of the
+    // ident table, so any index of a name reads the same variable. A name
+    // the code has not seen yet gets one of its own, which keeps what a body
+    // reads independent of the order bodies are generated in
+    int intern_ident(const std::string& name);
 
     // helpers
+    OPCode map_binexp_to_opcode(BinaryOperator op) const;
+    // x = append(x, e) and friends, the in place opcode or NOP
+    static OPCode in_place_list_op(const AssignmentExpression* let_exp);
+    // the operands of exp in the order its code evaluates them, a function's
+    // body is not part of the declaration
+    static std::vector<Expression*> sub_expressions(Expression* exp);
+    // index of the native function a call resolves to, or -1 for a call to a
+    // function the program declares, checks the arity
+    static int resolve_native(const FunctionCallExpression* call_exp);
     void print_ident_table() const;
     void print_instructions() const;
     void print_instruction(Instruction instr) const;
@@ -0,0 +1,78 @@
+#ifndef JIT_HPP
+#define JIT_HPP
+
+#include "ir_generator.hpp"
+#include "types.hpp"
+#include "x86.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+enum class JitType { None, Int, Bool, Conflict };
+
+struct JitFunction {
+    enum Status { Cold, Compiled, Failed };
+    Status status = Cold;
+    int calls = 0;
+    std::vector<std::string> params;
+    std::vector<JitType> param_types; // what the native code was compiled for
+    JitType ret = JitType::None;
+    const uint8_t* entry = nullptr;
+};
+
+// Baseline template JIT for x86-64. Once a function has been called
+// threshold times it is translated to native code together with every
+// function it calls, one machine code template per bytecode instruction
+// over stack slots. Only functions whose registers and variables provably
+// hold ints or bools compile (no prints, lists, strings, natives or reads of
+// the caller's variables), so the native code has no effect besides its
+// return value: the VM runs it with the arguments from the callee's
+// environment instead of interpreting the call. Everything else, and every
+// call whose arguments have other types, stays in the VM. A call that would
+// divide by zero leaves native code, and the VM runs it again to report it.
+class Jit {
+private:
+    IRGenerator& _gen; // generates the callees of a hot function that have not run yet
+    const std::vector<Bytecode>& _code;
+    const std::vector<std::string>& _ident_table;
+    const std::vector<Value>& _const_table;
+    const std::vector<FunctionInfo>& _func_table;
+
+    std::vector<JitFunction> functions;
+    int threshold = DEFAULT_THRESHOLD;
+
+    x86::CodeArena arena;
+    uint8_t* stack = nullptr;  // native frames run on their own stack
+    const uint8_t* trampoline = nullptr;
+    const uint8_t* overflow = nullptr;
+    size_t bailed_depth = 0; // VM call depth of the last call that ran out of native stack, 0 if none
+
+    bool init();
+    void add_functions();
+    bool generate(int fid);
+    bool compile(int fid, const std::vector<JitType>& param_types);
+
+public:
+    static const int DEFAULT_THRESHOLD = 2;
+    static const int MAX_PARAMS = 6; // passed in registers
+
+    Jit(IRGenerator& gen);
+    ~Jit();
+    Jit(const Jit&) = delete;
+    Jit& operator=(const Jit&) = delete;
+
+    static bool supported();
+    void set_threshold(int calls) { threshold = calls; }
+
+    // Counts a call of fid (after its PUSH and argument stores) and compiles
+    // fid once it is hot. When native code for the argument types in env
+    // exists, runs it and sets v0, false means the VM runs the call. depth
+    // is the VM's call depth, the callee's frame included: once a call ran
+    // out of native stack, the calls the VM makes under it stay in the VM,
+    // they would recurse almost as deep and bail again.
+    bool call(int fid, const Environment& env, Value& v0, size_t depth);
+    int compiled_count() const;
+};
+
+#endif // JIT_HPP
@@ -0,0 +1,59 @@
+#ifndef MEMO_CACHE_HPP
+#define MEMO_CACHE_HPP
+
+#include "value.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Values returned by pure functions (see CaptureResolver), keyed by the
+// function and its args. The table is direct mapped: a key has one slot, and
+// storing it there replaces whatever the slot held, so the cache never grows
+// past its capacity. Only int and bool args make a key, at most MAX_ARGS of
+// them.
+class MemoCache {
+public:
+    static const int MAX_ARGS = 4;
+    static const size_t DEFAULT_CAPACITY = 4096;
+
+    struct Key {
+        int fid = -1;
+        int arity = 0;
+        uint64_t words[MAX_ARGS] = {};
+        bool operator==(const Key& other) const;
+        // false when arg can not be part of a key, or the key is full
+        bool add(const Value& arg);
+    };
+
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t evictions = 0;
+        uint64_t uncached = 0; // calls whose args make no key
+    };
+
+private:
+    struct Entry {
+        Key key;
+        Value result;
+    };
+    std::vector<Entry> slots;
+    Stats counts;
+
+    size_t slot_of(const Key& key) const;
+
+public:
+    // capacity is rounded up to a power of two
+    explicit MemoCache(size_t capacity = DEFAULT_CAPACITY);
+
+    bool lookup(const Key& key, Value& result);
+    void store(const Key& key, const Value& result);
+    void uncached() { counts.uncached++; }
+    void clear();
+
+    const Stats& stats() const { return counts; }
+    size_t capacity() const { return slots.size(); }
+};
+
+#endif // MEMO_CACHE_HPP
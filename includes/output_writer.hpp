@@ -0,0 +1,41 @@
+#ifndef OUTPUT_WRITER_HPP
+#define OUTPUT_WRITER_HPP
+
+#include "value.hpp"
+
+#include <cstddef>
+#include <iostream>
+#include <string>
+
+// When printed lines reach the stream: Line after each one, Full whenever
+// the buffer fills up, Exit only when the program ends.
+enum class FlushPolicy { Line, Full, Exit };
+
+// Output of RV print statements. Lines collect in a buffer that goes to the
+// stream in one write, instead of a flush (and a write syscall) per line.
+class OutputWriter {
+private:
+    std::ostream& out;
+    std::string buffer;
+    FlushPolicy policy;
+    size_t capacity;
+
+public:
+    static const size_t DEFAULT_CAPACITY = 64 * 1024;
+
+    OutputWriter(std::ostream& out = std::cout, FlushPolicy policy = FlushPolicy::Full, size_t capacity = DEFAULT_CAPACITY);
+    ~OutputWriter() { flush(); }
+
+    void configure(FlushPolicy policy, size_t capacity = DEFAULT_CAPACITY);
+    FlushPolicy get_policy() const { return policy; }
+
+    // the value is serialised into the buffer, no string per line
+    void write_line(const Value& val) {
+        val.write_to(buffer, false);
+        buffer += '\n';
+        if (policy == FlushPolicy::Line || (policy == FlushPolicy::Full && buffer.size() >= capacity)) flush();
+    }
+    void flush();
+};
+
+#endif // OUTPUT_WRITER_HPP
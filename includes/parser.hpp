@@ -36,6 +36,10 @@ class Parser {
         FunctionAssignmentExpression* parse_function_expression(int &idx);
 
         const std::vector<Token>& _tokens;
+        // a call to a function the program declares runs it rather than a
+        // native of the same name
+        std::set<std::string> declared_functions;
+        void mark_user_calls(Expression* exp) const;
 
     public:
         Parser(const std::vector<Token>& tokens): _tokens(tokens) {}
@@ -0,0 +1,79 @@
+#ifndef PROFILER_HPP
+#define PROFILER_HPP
+
+#include "ir_generator.hpp"
+#include "memo_cache.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define RV_RDTSC 1
+#endif
+
+// Where the VM spends its time, for --profile. The interpreter calls step as
+// it dispatches each word, and the ticks since the previous step go to the
+// previous word, by address and by the opcode it ran as (after quickening).
+// Consecutive opcodes are counted as pairs. A JUMPF whose callee runs in the
+// JIT is charged the native call, a loop entering a trace the whole trace.
+// Ticks are cycles from rdtsc on x86, nanoseconds elsewhere.
+class Profiler {
+private:
+    std::vector<uint64_t> op_counts;
+    std::vector<uint64_t> op_ticks;
+    std::vector<uint64_t> pair_counts; // [prev * NUM_OPCODES + next]
+    std::vector<uint64_t> addr_counts;
+    std::vector<uint64_t> addr_ticks;
+    int last_pc = -1;
+    OPCode last_op = NOP;
+    uint64_t last_tick = 0;
+
+    void charge(uint64_t tick) {
+        op_ticks[last_op] += tick - last_tick;
+        addr_ticks[last_pc] += tick - last_tick;
+    }
+
+public:
+    static const size_t DEFAULT_ROWS = 20;
+
+    Profiler();
+
+    static uint64_t now() {
+#ifdef RV_RDTSC
+        return __rdtsc();
+#else
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+    }
+    static const char* tick_unit();
+
+    void step(int pc, OPCode op) {
+        uint64_t tick = now();
+        if (last_pc >= 0) {
+            charge(tick);
+            pair_counts[last_op * NUM_OPCODES + op]++;
+        }
+        if (static_cast<size_t>(pc) >= addr_counts.size()) {
+            // functions compiled while running go on the end of the code
+            addr_counts.resize(pc + 1024);
+            addr_ticks.resize(pc + 1024);
+        }
+        op_counts[op]++;
+        addr_counts[pc]++;
+        last_pc = pc;
+        last_op = op;
+        last_tick = now(); // the bookkeeping above is not charged to anyone
+    }
+    // charges the last word, at the end of a run
+    void stop();
+    void clear();
+
+    // Prints the opcodes, the instructions (disassembled against gen) and the
+    // opcode pairs that took the most ticks or ran most often, rows of each.
+    // memo is reported when the run memoized calls
+    void report(const IRGenerator& gen, const MemoCache::Stats* memo, size_t rows = DEFAULT_ROWS) const;
+};
+
+#endif // PROFILER_HPP
@@ -0,0 +1,139 @@
+#ifndef SSA_HPP
+#define SSA_HPP
+
+#include "ir_generator.hpp"
+#include "expression.hpp"
+
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+
+class SSAGenerator;
+
+// SSA form of a single RV function (or the top level program). Values are
+// numbered; every value is defined exactly once and env variables are renamed
+// into values, so LOAD_VAR only survives for reads of the incoming frame.
+// Variables that are updated in place (arr[i] = x) are the exception, they
+// stay in the env and every read is an SSA_LOAD_MEM.
+
+enum SSAKind {
+    SSA_OP,          // lowers 1:1 to `op`
+    SSA_PHI,
+    SSA_LIST,        // INIT_LIST + one APPEND per arg
+    SSA_MODIFY,      // MODIFY + MOVE from T0
+    SSA_CALL_RESULT, // MOVE from V0 after a JUMPF
+    SSA_UNDEF,       // value of an expression that never writes a register (print, ...)
+    SSA_LOAD_MEM,    // LOAD_VAR of an env resident variable, never merged
+};
+
+enum SSATerminator {
+    TERM_NONE,
+    TERM_JUMP,
+    TERM_BRANCH, // JNT cond, succs = {true_block, false_block}
+    TERM_RET,    // ret_val == -1 for a bare return
+    TERM_END,
+};
+
+// Lattice of the type inference (trap analysis and unboxing), TYPE_TOP
+// means "no information yet"
+enum SSAType {
+    TYPE_TOP,
+    TYPE_INT,
+    TYPE_BOOL,
+    TYPE_STRING,
+    TYPE_LIST,
+    TYPE_ANY,
+};
+
+struct SSAInstr {
+    SSAKind kind;
+    OPCode op;
+    std::vector<int> args; // operand value ids (phi args are ordered like block preds)
+    int imm = -1;          // const idx, ident idx or fid
+    int block = -1;
+    int call_depth = 0;    // > 0 when executed in a frame pushed for a call's arguments
+    bool dead = false;
+};
+
+struct SSABlock {
+    std::vector<int> preds;
+    std::vector<int> succs;
+    std::vector<int> instrs;
+    SSATerminator term = TERM_NONE;
+    int cond = -1;
+    int ret_val = -1;
+    bool sealed = false;
+    bool reachable = true;
+};
+
+struct SSAFunction {
+    std::string name;
+    int fid = -1; // -1 for the top level program
+    std::vector<SSAInstr> values;
+    std::vector<SSABlock> blocks;
+    std::vector<int> layout; // emission order of the blocks
+    std::vector<SSAType> types; // inferred by the SSAOptimizer, by value id
+
+    // follows copy replacements made by the optimizer
+    int resolve(int v) const;
+    std::vector<int> replaced_by;
+
+    bool has_side_effects(const SSAInstr& instr) const;
+    // STORE_INDEX and the in place list builtins, they update an env variable's list
+    static bool updates_env_list(OPCode op);
+    void print(const SSAGenerator& gen) const;
+};
+
+class SSABuilder {
+private:
+    SSAGenerator& _gen;
+    SSAFunction& _func;
+
+    int curr_block = -1;
+    int call_depth = 0;
+
+    // Braun et al. on the fly construction
+    std::map<std::string, std::map<int, int>> current_def;
+    std::map<int, std::map<std::string, int>> incomplete_phis;
+    std::vector<int> entry_loads;
+    std::set<std::string> memory_vars;
+    bool in_function = false; // a function body may assign its callers' variables
+
+    int new_block();
+    void set_block(int b);
+    void add_edge(int from, int to);
+    void seal_block(int b);
+    bool terminated() const { return curr_block == -1; }
+
+    int emit(SSAKind kind, OPCode op, std::vector<int> args, int imm = -1);
+    int new_phi(int b);
+
+    void write_variable(const std::string& var, int b, int val);
+    int read_variable(const std::string& var, int b);
+    int read_variable_recursive(const std::string& var, int b);
+    int add_phi_operands(const std::string& var, int phi);
+
+    void build_block(const std::vector<Expression*>& exps);
+    void declare_nested_functions(Expression* exp);
+    void collect_memory_vars(const std::vector<Expression*>& exps);
+    int build_exp(Expression* exp);
+    int build_let(AssignmentExpression* let_exp);
+    int build_mon(MonadicExpression* mon_exp);
+    int build_bin(BinaryExpression* bin_exp);
+    void build_if(IfExpression* if_exp);
+    void build_while(WhileExpression* while_exp);
+    int build_call(FunctionCallExpression* call_exp);
+    int build_list(ListExpression* list_exp);
+    int build_access(ListAccessExpression* access_exp);
+    int build_modify(ListModifyExpression* modify_exp);
+    int build_store_index(AssignmentExpression* let_exp);
+    int build_in_place_call(AssignmentExpression* let_exp, OPCode op);
+    int finish_exp(Expression* exp, int val);
+
+public:
+    SSABuilder(SSAGenerator& gen, SSAFunction& func): _gen(gen), _func(func) {}
+    void build(const std::vector<Expression*>& body, bool top_level);
+};
+
+#endif // SSA_HPP
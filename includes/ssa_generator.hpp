@@ -0,0 +1,55 @@
+#ifndef SSA_GENERATOR_HPP
+#define SSA_GENERATOR_HPP
+
+#include "ir_generator.hpp"
+#include "ssa.hpp"
+
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+
+// Optimising front end: builds SSA per function straight from the AST,
+// runs the SSAOptimizer passes and lowers the result back into the same
+// tables (_instr, _ident_table, ...) that IRGenerator fills for the VM.
+class SSAGenerator : public IRGenerator {
+private:
+    std::map<std::string, int> const_to_idx;
+    std::set<std::string> declared_idents;
+    std::vector<SSAFunction> functions;
+    bool unboxing = true;
+
+    // ints and bools of one function that live in the int register bank
+    struct Unboxing {
+        std::vector<OPCode> int_op;   // unboxed op computing the value (INT_MOVE for a phi), NOP if boxed
+        std::vector<int> ireg_of;     // -1 unless computed unboxed or read by an unboxed op
+        std::vector<bool> needs_box;  // unboxed, and read by a boxed op
+        std::vector<bool> needs_unbox; // boxed, and read by an unboxed op
+    };
+
+    void lower_function(SSAFunction& func);
+    Unboxing plan_unboxing(const SSAFunction& func);
+    OPCode unboxed_form(const SSAFunction& func, const SSAInstr& instr) const;
+    static bool int_branch(const SSAFunction& func, const Unboxing& unboxing, int cond);
+    void lower_store_index(const SSAFunction& func, const SSAInstr& instr, const std::vector<int>& reg_of);
+    int consecutive_regs(const SSAFunction& func, const std::vector<int>& vals, const std::vector<int>& reg_of);
+    void emit_phi_copies(const SSAFunction& func, int from, int to, const std::vector<int>& reg_of, const Unboxing& unboxing);
+    void emit_parallel_copies(const std::vector<std::pair<int, int>>& copies, OPCode move, int& next_reg);
+
+public:
+    SSAGenerator() {}
+    std::vector<Instruction>& generate_ir_code(const std::vector<Expression*>& _exps) override;
+    // keep every value boxed in the generic registers, for comparison
+    void set_unboxing(bool enabled) { unboxing = enabled; }
+
+    // hooks used by SSABuilder, they mirror the bookkeeping IRGenerator does
+    int intern_const(const Value& val);
+    void declare_ident(const std::string& name);
+    bool is_declared(const std::string& name) const;
+    int declare_function(FunctionAssignmentExpression* func_exp);
+    int resolve_function(const std::string& name);
+
+    void print_ssa() const;
+};
+
+#endif // SSA_GENERATOR_HPP
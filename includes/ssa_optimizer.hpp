@@ -0,0 +1,48 @@
+#ifndef SSA_OPTIMIZER_HPP
+#define SSA_OPTIMIZER_HPP
+
+#include "ssa.hpp"
+
+#include <vector>
+#include <map>
+#include <tuple>
+
+// Passes over one SSAFunction. Every pass only marks values dead or records a
+// replacement in replaced_by, the SSAGenerator lowers whatever survives.
+class SSAOptimizer {
+private:
+    SSAFunction& _func;
+    const std::vector<Value>& _const_table;
+
+    std::vector<int> rpo;
+    std::vector<int> idom;
+    std::vector<std::vector<int>> dom_children;
+    std::vector<SSAType> types;
+
+    using ValueKey = std::tuple<int, int, int, std::vector<int>>;
+    std::map<ValueKey, int> available;
+
+    void compute_rpo();
+    void compute_dominators();
+
+    bool simplify_phis();
+    void infer_types();
+    void value_number(int b);
+    void eliminate_dead_stores();
+    void eliminate_dead_code();
+
+    bool is_pure(const SSAInstr& instr) const;
+    bool may_trap(const SSAInstr& instr) const;
+    SSAType result_type(const SSAInstr& instr) const;
+    bool const_int_is(int v, int c) const;
+
+public:
+    SSAOptimizer(SSAFunction& func, const std::vector<Value>& const_table):
+        _func(func),
+        _const_table(const_table) {}
+
+    void run();
+    SSAType type_of(int v) const { return types[_func.resolve(v)]; }
+};
+
+#endif // SSA_OPTIMIZER_HPP
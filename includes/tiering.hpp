@@ -0,0 +1,36 @@
+#ifndef TIERING_HPP
+#define TIERING_HPP
+
+#include "expression.hpp"
+#include "interpreter.hpp"
+#include "ir_generator.hpp"
+#include "output_writer.hpp"
+#include "types.hpp"
+
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+// A function the tree evaluator found hot, compiled to bytecode together
+// with every function it calls into a program of its own with no top level
+// code. A call runs in that program's VM on the frame the tree evaluator
+// would have pushed, a copy of the caller's variables with the params bound,
+// and prints into the tree evaluator's writer.
+class CompiledFunction {
+private:
+    IRGenerator gen;
+    Interpreter vm;
+
+    CompiledFunction(const std::vector<Expression*>& functions, const std::set<std::string>& names, OutputWriter& output);
+
+public:
+    // nullptr when the function has to stay in the tree evaluator: it calls
+    // a function that is not defined yet or with the wrong number of args,
+    // or the IRGenerator rejects it
+    static std::unique_ptr<CompiledFunction> compile(FunctionAssignmentExpression* func_exp, const FunctionEnvironment& func_env, OutputWriter& output);
+
+    Value call(Environment env) { return vm.call(0, std::move(env)); }
+};
+
+#endif // TIERING_HPP
@@ -0,0 +1,103 @@
+#ifndef TRACE_JIT_HPP
+#define TRACE_JIT_HPP
+
+#include "ir_generator.hpp"
+#include "types.hpp"
+#include "x86.hpp"
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// IntReg slots hold an int register, List slots point at the VM's Value
+enum class TraceType { Int, Bool, List, IntReg };
+
+// a register ('r'), int register ('i') or variable ('v', by ident index)
+struct TraceSlot {
+    char kind;
+    int index;
+    bool operator<(const TraceSlot& other) const {
+        return kind != other.kind ? kind < other.kind : index < other.index;
+    }
+};
+
+// One recorded instruction over slot numbers, guards name the exit taken
+// when the run goes the other way than the recording did
+struct TraceStep {
+    OPCode op;
+    int d = -1, x = -1, y = -1;
+    int imm = 0;       // LOAD_CONST's value, ACCESS's element tag
+    int exit = -1;
+    bool exit_if_zero = false; // JNT
+};
+
+struct TraceExit {
+    int pc;                          // where the VM resumes
+    std::map<int, TraceType> types;  // of the slots there, the others have their entry type
+    int hits = 0;
+    int branch = -1;                 // the path recorded from here once it got hot
+    bool final = false;              // leaves the loop, or failed to record a branch
+};
+
+// A loop's trace tree: the path recorded from the header, and the paths
+// recorded from its hot side exits, each ending at the back-edge
+struct TraceLoop {
+    int back_edge = -1;
+    int hits = 0;
+    int failures = 0;
+    std::vector<TraceSlot> slots;
+    std::map<TraceSlot, int> slot_of;
+    std::vector<TraceType> entry_types;
+    std::vector<std::vector<TraceStep>> paths;
+    std::vector<TraceExit> exits;
+    const uint8_t* entry = nullptr;
+};
+
+// Tracing JIT for while loops. The VM counts the back-edges (a JUMP to an
+// earlier address) of every loop. Once a loop is hot, one iteration is
+// recorded by a shadow interpreter working on copies of the registers and
+// variables it touches, following the branches that iteration takes, and
+// compiled to a linear run of x86-64 where every branch becomes a guard.
+// Later side exits that get hot are recorded the same way and compiled in
+// as branches of the loop's trace tree. Traces work on ints and bools, and
+// read lists through ACCESS and SIZE; anything else (calls, prints, strings,
+// writes to lists) ends the recording and the loop stays in the VM.
+class TraceJit {
+private:
+    const std::vector<Bytecode>& _code;
+    const std::vector<std::string>& _ident_table;
+    const std::vector<Value>& _const_table;
+
+    std::unordered_map<int, TraceLoop> loops; // by header
+    int threshold = DEFAULT_THRESHOLD;
+    x86::CodeArena arena;
+
+    bool record(TraceLoop& loop, int header, int pc, int from_exit, const std::map<int, Value>& regs,
+                const std::vector<int>& iregs, const Environment& env);
+    bool compile(TraceLoop& loop);
+    int run(TraceLoop& loop, int header, std::map<int, Value>& regs, std::vector<int>& iregs, Environment& env);
+
+public:
+    static const int DEFAULT_THRESHOLD = 8; // back-edges, and hits of a side exit
+    static const int MAX_FAILURES = 3;      // recordings before a loop is left to the VM
+    static const int MAX_STEPS = 2000;      // per path
+    static const int MAX_PATHS = 16;
+
+    TraceJit(IRGenerator& gen);
+    TraceJit(const TraceJit&) = delete;
+    TraceJit& operator=(const TraceJit&) = delete;
+
+    static bool supported();
+    void set_threshold(int hits) { threshold = hits; }
+
+    // Called on the back-edge at pc to header in the given frame. Runs the
+    // loop's trace when it has one (recording it once the loop is hot), and
+    // returns where the VM continues: the exit the trace left through, or
+    // header when nothing ran.
+    int loop(int pc, int header, std::map<int, Value>& regs, std::vector<int>& iregs, Environment& env);
+    int compiled_count() const;
+};
+
+#endif // TRACE_JIT_HPP
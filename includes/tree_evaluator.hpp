@@ -3,9 +3,14 @@
 
 #include "expression.hpp"
 #include "types.hpp"
+#include "output_writer.hpp"
+#include "tiering.hpp"
+#include "value_ops.hpp"
 
 #include <vector>
 #include <stack>
+#include <memory>
+#include <unordered_map>
 
 class TreeEvaluator {
 private:
@@ -14,6 +19,15 @@ private:
 
     std::stack<Environment> env_stack;
     Environment* curr_env;
+    OutputWriter output;
+
+    // tiering: calls per function, and the hot ones compiled for the VM
+    // (nullptr for those that have to stay here)
+    int tier_threshold = 0;
+    std::unordered_map<FunctionAssignmentExpression*, int> call_counts;
+    std::unordered_map<FunctionAssignmentExpression*, std::unique_ptr<CompiledFunction>> compiled;
+    CompiledFunction* tier_up(FunctionAssignmentExpression* func_exp);
+
     void push_env();
     void pop_env();
 
@@ -28,10 +42,27 @@ public:
     }
 
     void evaluate_commands(const std::vector<Expression*>& commands) {
-        for (Expression * exp : commands) {
-            auto result = evaluate_expression(exp);
+        try {
+            for (Expression * exp : commands) {
+                auto result = evaluate_expression(exp);
+            }
+        } catch (...) {
+            output.flush();
+            throw;
         }
+        output.flush();
     }
+
+    static const int DEFAULT_TIER_THRESHOLD = 16;
+    // Functions called this many times run on the VM from then on, see
+    // tiering.hpp, 0 keeps everything in the tree evaluator
+    void set_tier_threshold(int calls) { tier_threshold = calls; }
+    int tiered_count() const;
+
+    // the value_ops operator a BinaryExpression evaluates with
+    static value_ops::BinOp binop_of(BinaryOperator op);
+
+    void set_output_policy(FlushPolicy policy, size_t capacity = OutputWriter::DEFAULT_CAPACITY) { output.configure(policy, capacity); }
 };
 
 #endif // TREE_EVALUATOR_CPP
\ No newline at end of file
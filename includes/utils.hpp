@@ -20,8 +20,6 @@ std::string string_of_expression(Expression* exp);
 
 void print_evaluated_list(std::vector<Value> arr);
 
-std::string multiply(std::string str, int m);
-std::vector<Value> multiply(std::vector<Value> arr, int m);
 
 void cleanup_expressions(std::vector<Expression*> expressions);
 
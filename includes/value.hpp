@@ -1,7 +1,9 @@
 #ifndef VALUE_HPP
 #define VALUE_HPP
 
-#include <variant>
+#include "heap.hpp"
+
+#include <cstdint>
 #include <vector>
 #include <string>
 #include <sstream>
@@ -9,30 +11,141 @@
 
 class Value;
 
-using ValueData = std::variant<int, bool, std::string, std::vector<Value>>;
+// Strings and lists are shared between Values and reference counted, an
+// in place mutation (list_ref, store_index) first unshares the object, so
+// RV keeps value semantics while copies and reads stay O(1). The count is
+// not atomic, the interpreter is single threaded. Cycles between lists are
+// left to the collector in heap.hpp.
+
+// Characters shared by a string and the strings concatenated onto its end,
+// see Value::operator+
+struct StringBuffer {
+    uint32_t refs = 1;
+    std::string data;
+};
+
+struct StringObject : HeapObject {
+    std::string str;             // the characters, unless buf is set
+    StringBuffer* buf = nullptr; // else the first len characters of buf
+    size_t len = 0;
+
+    StringObject(std::string s): str(std::move(s)) {}
+    StringObject(StringBuffer* b, size_t l): buf(b), len(l) { b->refs++; }
+    ~StringObject() { if (buf && --buf->refs == 0) delete buf; }
 
+    size_t size() const { return buf ? len : str.size(); }
+    // a prefix that is no longer the whole buffer is copied out on first read
+    const std::string& chars() {
+        if (!buf) return str;
+        if (buf->data.size() == len) return buf->data;
+        return flatten();
+    }
+    const std::string& flatten();
+    std::string& own(); // for in place writes
+    StringBuffer* buffer(); // moves str into a buffer if it has none
+};
+
+struct ListObject : HeapObject {
+    std::vector<Value> items;
+    ListObject(std::vector<Value> arr): items(std::move(arr)) {}
+};
+
+// 8 byte tagged value. The low 2 bits hold the type, ints and bools are
+// stored inline in the high 32 bits, strings and lists point to a heap
+// object (heap allocations are at least 8 byte aligned, so the tag bits of
+// the pointer are free). A zeroed Value is the int 0, like the default of
+// the variant it replaces.
 class Value {
+public:
+    enum Tag : uint64_t { INT_TAG = 0, BOOL_TAG = 1, STRING_TAG = 2, LIST_TAG = 3 };
+    static constexpr int NUM_TAGS = 4;
+
 private:
-    
+    static constexpr uint64_t TAG_MASK = 3;
+    static constexpr uint64_t HEAP_BIT = 2; // set for both heap tags
+
+    uint64_t bits = 0;
+
+    static uint64_t box(int i) { return static_cast<uint64_t>(static_cast<uint32_t>(i)) << 32 | INT_TAG; }
+    static uint64_t box(bool b) { return static_cast<uint64_t>(b) << 32 | BOOL_TAG; }
+    HeapObject* heap() const { return reinterpret_cast<HeapObject*>(bits & ~TAG_MASK); }
+
+    void retain() const { if (bits & HEAP_BIT) heap()->refs++; }
+    void release() { if ((bits & HEAP_BIT) && --heap()->refs == 0) destroy(); }
+    void destroy();
+    void unshare();
+
+    explicit Value(StringObject* obj);
+
 public:
-    ValueData data;
     Value() = default;
-    Value(ValueData vd): data(vd) {}
+    Value(int i): bits(box(i)) {}
+    Value(bool b): bits(box(b)) {}
+    Value(const char* s);
+    Value(std::string s);
+    Value(std::vector<Value> arr);
+
+    Value(const Value& other): bits(other.bits) { retain(); }
+    Value(Value&& other) noexcept: bits(other.bits) { other.bits = 0; }
+    Value& operator=(const Value& other) {
+        other.retain(); // before release, other may live inside this object
+        release();
+        bits = other.bits;
+        return *this;
+    }
+    Value& operator=(Value&& other) noexcept {
+        if (this != &other) {
+            release();
+            bits = other.bits;
+            other.bits = 0;
+        }
+        return *this;
+    }
+    // int and bool results are written over the old word, without a
+    // temporary Value
+    Value& operator=(int i) {
+        release();
+        bits = box(i);
+        return *this;
+    }
+    Value& operator=(bool b) {
+        release();
+        bits = box(b);
+        return *this;
+    }
+    ~Value() { release(); }
+
+    bool is_int() const { return (bits & TAG_MASK) == INT_TAG; }
+    bool is_bool() const { return (bits & TAG_MASK) == BOOL_TAG; }
+    bool is_string() const { return (bits & TAG_MASK) == STRING_TAG; }
+    bool is_list() const { return (bits & TAG_MASK) == LIST_TAG; }
+    int tag() const { return bits & TAG_MASK; }
 
-    bool is_int() const { return std::holds_alternative<int>(data); }
-    bool is_bool() const { return std::holds_alternative<bool>(data); }
-    bool is_string() const { return std::holds_alternative<std::string>(data); }
-    bool is_list() const { return std::holds_alternative<std::vector<Value>>(data); }
-    
+    // unchecked accessors, test the type first
+    int as_int() const { return static_cast<int32_t>(bits >> 32); }
+    bool as_bool() const { return (bits >> 32) != 0; }
+    const std::string& as_string() const { return static_cast<StringObject*>(heap())->chars(); }
+    const std::vector<Value>& as_list() const { return static_cast<const ListObject*>(heap())->items; }
+    HeapObject* object() const { return heap(); } // strings and lists only
+    std::vector<Value>& list_ref() {
+        if (heap()->refs > 1) unshare();
+        return static_cast<ListObject*>(heap())->items;
+    }
+
+    // Serialises straight into out, nested lists included, without building
+    // intermediate strings
+    void write_to(std::string& out, bool string_quotes) const;
+    void write_to(std::ostream& out, bool string_quotes) const;
     std::string to_string(bool string_quotes) const;
-    std::string string_of_list(std::vector<Value> arr, bool string_quotes) const;
     std::string get_type() const;
     bool equals(const Value& rhs) const; // wrapper functions
     bool not_equals(const Value& rhs) const;
     void append_ref(Value e);
 
-    // overloaded ops
-    Value operator+(const Value& rhs) const;
+    // overloaded ops, the binary ones dispatch through the matrix in value_ops.hpp
+    Value operator+(const Value& rhs) const&;
+    Value operator+(const Value& rhs) &&; // reuses an unshared list
+    Value concat(const Value& rhs) const; // string + string, unchecked
     Value operator-(const Value& rhs) const;
     Value operator*(const Value& rhs) const;
     Value operator/(const Value& rhs) const;
@@ -52,8 +165,13 @@ public:
 
     Value operator[](const Value& idx_val) const;
     Value modify_arr(const Value& idx_val, Value replace_val);
+    // in place versions of modify_arr, index_ref returns the element slot of a list
+    Value& index_ref(const Value& idx_val);
+    void store_index(const Value& idx_val, Value replace_val);
 
     Value size() const;
 };
 
-#endif // VALUE_HPP
\ No newline at end of file
+static_assert(sizeof(Value) == 8, "Value must stay a single tagged word");
+
+#endif // VALUE_HPP
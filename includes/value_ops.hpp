@@ -0,0 +1,52 @@
+#ifndef VALUE_OPS_HPP
+#define VALUE_OPS_HPP
+
+#include "value.hpp"
+
+#include <array>
+#include <cstdint>
+#include <stdexcept>
+
+// Binary operators over the value type tags. Each operator is defined once
+// per (lhs type, rhs type) pair in value_ops.cpp, and the handler matrix
+// indexed by (op, lhs tag, rhs tag) is generated from those definitions at
+// compile time. Pairs without a definition get a handler that throws the
+// operator's type error, so a new type only needs its own rules.
+namespace value_ops {
+
+enum class BinOp { Add, Sub, Mul, Div, Pow, Mod, Gt, Gte, Lt, Lte, Eq, Neq, And, Or };
+
+const int NUM_BINOPS = static_cast<int>(BinOp::Or) + 1;
+const int MATRIX_SIZE = NUM_BINOPS * Value::NUM_TAGS * Value::NUM_TAGS;
+
+using BinaryFn = Value (*)(const Value& lhs, const Value& rhs);
+
+constexpr int index(BinOp op, int lhs_tag, int rhs_tag) {
+    return (static_cast<int>(op) * Value::NUM_TAGS + lhs_tag) * Value::NUM_TAGS + rhs_tag;
+}
+
+extern const std::array<BinaryFn, MATRIX_SIZE> matrix;
+extern const std::array<bool, MATRIX_SIZE> defined; // false where the handler throws
+
+// one indirect call
+inline Value binary(BinOp op, const Value& lhs, const Value& rhs) {
+    return matrix[index(op, lhs.tag(), rhs.tag())](lhs, rhs);
+}
+
+const char* symbol(BinOp op);
+
+// / and % on ints for every engine. A zero divisor is an error, and
+// INT_MIN / -1 wraps to INT_MIN (with remainder 0) like the other int ops
+// instead of overflowing
+inline int int_div(int x, int y) {
+    if (y == 0) throw std::runtime_error("division by zero");
+    return y == -1 ? static_cast<int>(0u - static_cast<uint32_t>(x)) : x / y;
+}
+inline int int_mod(int x, int y) {
+    if (y == 0) throw std::runtime_error("division by zero");
+    return y == -1 ? 0 : x % y;
+}
+
+} // namespace value_ops
+
+#endif // VALUE_OPS_HPP
@@ -0,0 +1,106 @@
+#ifndef X86_HPP
+#define X86_HPP
+
+#include "ir_generator.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <vector>
+
+#if defined(__x86_64__) && defined(__unix__)
+#define RV_JIT 1
+#endif
+
+// Machine code emission shared by the method JIT (jit.hpp) and the trace
+// JIT (trace_jit.hpp). Both keep every value in an 8 byte slot of a frame
+// that a base register points at.
+namespace x86 {
+
+enum Reg { EAX = 0, ECX = 1, EDX = 2, EBX = 3, ESP = 4, EBP = 5, ESI = 6, EDI = 7, R8D = 8, R9D = 9 };
+
+struct Assembler {
+    std::vector<uint8_t> buf;
+    const uint8_t* base = nullptr; // where buf[0] ends up
+    // slot s is [rbp - 8 * (s + 1)] in a stack frame, [frame + 8 * s]
+    // for any other base register
+    Reg frame = EBP;
+
+    void emit(std::initializer_list<int> bytes) {
+        for (int b : bytes) buf.push_back(static_cast<uint8_t>(b));
+    }
+    void u32(uint32_t v) {
+        for (int i = 0; i < 4; i++) buf.push_back(static_cast<uint8_t>(v >> (8 * i)));
+    }
+    void u64(uint64_t v) {
+        for (int i = 0; i < 8; i++) buf.push_back(static_cast<uint8_t>(v >> (8 * i)));
+    }
+    const uint8_t* here() const { return base + buf.size(); }
+    // displacement to target, trailing is the length of what follows it in
+    // the instruction
+    void rel32(const void* target, int trailing = 0) {
+        u32(static_cast<uint32_t>(static_cast<const uint8_t*>(target) - (here() + 4 + trailing)));
+    }
+    void patch(size_t at, const uint8_t* target) {
+        uint32_t disp = static_cast<uint32_t>(target - (base + at + 4));
+        std::memcpy(&buf[at], &disp, 4);
+    }
+    // opcode with a slot operand, reg goes in ModRM.reg, wide for 64 bit
+    void mem(std::initializer_list<int> opcode, int reg, int slot, bool wide = false) {
+        if (reg >= 8 || wide) emit({0x40 | (wide ? 0x08 : 0) | (reg >= 8 ? 0x04 : 0)});
+        emit(opcode);
+        emit({0x80 | (reg & 7) << 3 | frame});
+        u32(static_cast<uint32_t>(frame == EBP ? -8 * (slot + 1) : 8 * slot));
+    }
+    void load(int reg, int slot, bool wide = false) { mem({0x8B}, reg, slot, wide); }
+    void store(int slot, int reg, bool wide = false) { mem({0x89}, reg, slot, wide); }
+    void copy(int dst, int src, bool wide = false) { load(EAX, src, wide); store(dst, EAX, wide); }
+    void is_zero(int slot) { mem({0x83}, 7, slot); emit({0x00}); } // cmp dword [slot], 0
+    void setcc(int cc, int reg = EAX) { emit({0x0F, cc, 0xC0 | reg}); }
+    void zero_extend_al() { emit({0x0F, 0xB6, 0xC0}); }
+    void call(const void* fn) {
+        emit({0x48, 0xB8}); // mov rax, fn
+        u64(reinterpret_cast<uint64_t>(fn));
+        emit({0xFF, 0xD0}); // call rax
+    }
+};
+
+// Emits op on the ints and bools in slots x and y into slot d, for the
+// arithmetic, comparison and logic ops, NOT, NEG and BOX_BOOL in their
+// generic and INT_ forms. false for any other op.
+bool int_op(Assembler& as, OPCode op, int d, int x, int y);
+// / and % in either form, the code must leave before running one of them
+// with a zero divisor
+inline bool divides(OPCode op) {
+    return op == DIV_OP || op == INT_DIV || op == MOD_OP || op == INT_MOD;
+}
+
+// A page of data the code can reach rip relative, then room for code, which
+// is only writable while add copies into it
+class CodeArena {
+private:
+    uint8_t* mem = nullptr;
+    size_t page = 0;
+    size_t capacity = 0;
+    size_t used = 0;
+
+    bool writable(bool on);
+
+public:
+    CodeArena() = default;
+    ~CodeArena();
+    CodeArena(const CodeArena&) = delete;
+    CodeArena& operator=(const CodeArena&) = delete;
+
+    bool map(size_t code_bytes);
+    bool mapped() const { return mem != nullptr; }
+    uint8_t* data() { return mem; }
+    const uint8_t* next() const { return mem + page + used; } // where add puts the next code
+    // copies code in, nullptr when it does not fit
+    const uint8_t* add(const std::vector<uint8_t>& code);
+};
+
+} // namespace x86
+
+#endif // X86_HPP
@@ -1,36 +1,122 @@
 #include "builtins.hpp"
 
-Value builtin::append(Value v, Value x) {
-    // std::cout << v.to_string() << " " << x.to_string() << "\n";
+void builtin::append_ref(Value& v, Value x) {
     if (v.is_list()) {
-        std::vector<Value> arr = std::get<std::vector<Value>>(v.data);
-        arr.push_back(x);
-        return Value(arr);
+        v.list_ref().push_back(std::move(x));
+        return;
     }
     throw std::runtime_error("incorrect use of append function"); 
 }
 
-Value builtin::remove(Value v, Value x) {
-    // std::cout << "Remove " << v.to_string() << " " << x.to_string() << "\n";
-    if (v.is_list()) {
-        std::vector<Value> vec = std::get<std::vector<Value>>(v.data);
-        int idx = std::get<int>(x.data);
-        if (idx < 0 || static_cast<size_t>(idx) >= vec.size()) { throw std::runtime_error("idx out of range for remove()"); }
+void builtin::remove_ref(Value& v, const Value& i) {
+    if (v.is_list() && i.is_int()) {
+        int idx = i.as_int();
+        if (idx < 0 || static_cast<size_t>(idx) >= v.as_list().size()) { throw std::runtime_error("idx out of range for remove()"); }
+        std::vector<Value>& vec = v.list_ref();
         vec.erase(vec.begin() + idx);
-        return Value(vec);
+        return;
     }
     throw std::runtime_error("incorrect use of remove function"); 
 }
 
-Value builtin::type(Value v) {
-    return Value(v.get_type());
+void builtin::pop_ref(Value& v) {
+    if (v.is_list()) {
+        if (v.as_list().empty()) throw std::runtime_error("pop() from an empty list");
+        v.list_ref().pop_back();
+        return;
+    }
+    throw std::runtime_error("incorrect use of pop function");
+}
+
+void builtin::insert_ref(Value& v, const Value& i, Value x) {
+    if (v.is_list() && i.is_int()) {
+        int idx = i.as_int();
+        if (idx < 0 || static_cast<size_t>(idx) > v.as_list().size()) { throw std::runtime_error("idx out of range for insert()"); }
+        std::vector<Value>& vec = v.list_ref();
+        vec.insert(vec.begin() + idx, std::move(x));
+        return;
+    }
+    throw std::runtime_error("incorrect use of insert function");
+}
+
+// the value returning forms work on their own copy, which copy on write
+// separates from the caller's list on the first mutation
+
+Value builtin::append(Value v, Value x) {
+    append_ref(v, std::move(x));
+    return v;
 }
 
-Value builtin::string(Value v) {
+Value builtin::remove(Value v, Value x) {
+    remove_ref(v, x);
+    return v;
+}
+
+Value builtin::pop(Value v) {
+    pop_ref(v);
+    return v;
+}
+
+Value builtin::insert(Value v, Value i, Value x) {
+    insert_ref(v, i, std::move(x));
+    return v;
+}
+
+// the four names are shared constants, so type() never allocates
+Value builtin::type(const Value& v) {
+    static const Value names[] = {Value("int"), Value("bool"), Value("string"), Value("list")};
+    if (v.is_int()) return names[0];
+    if (v.is_bool()) return names[1];
+    return v.is_string() ? names[2] : names[3];
+}
+
+Value builtin::string(const Value& v) {
     if (v.is_list()) return Value("list");
     return Value(v.to_string(false));
 }
 
+// Registry
+
+// the builtins work on copies of their args, so all of them are pure
+static std::vector<builtin::NativeFunction>& registry() {
+    static std::vector<builtin::NativeFunction> table = {
+        {"append", {"arr_val", "ele_val"}, [](Value* args) { return builtin::append(std::move(args[0]), std::move(args[1])); }, true},
+        {"remove", {"arr_val", "idx_val"}, [](Value* args) { return builtin::remove(std::move(args[0]), std::move(args[1])); }, true},
+        {"type", {"val"}, [](Value* args) { return builtin::type(args[0]); }, true},
+        {"string", {"val"}, [](Value* args) { return builtin::string(args[0]); }, true},
+        {"pop", {"arr_val"}, [](Value* args) { return builtin::pop(std::move(args[0])); }, true},
+        {"insert", {"arr_val", "idx_val", "ele_val"}, [](Value* args) { return builtin::insert(std::move(args[0]), std::move(args[1]), std::move(args[2])); }, true},
+    };
+    return table;
+}
+
+std::string builtin::NativeFunction::signature() const {
+    std::string res = name + "(";
+    for (size_t i = 0; i < params.size(); i++) res += (i > 0 ? ", " : "") + params[i];
+    return res + ")";
+}
+
+int builtin::register_native(const std::string& name, std::vector<std::string> params, NativeFn fn, bool pure) {
+    if (find_native(name) >= 0) throw std::runtime_error("native function " + name + " is already registered");
+    if (params.size() > static_cast<size_t>(MAX_NATIVE_ARGS)) throw std::runtime_error("native function " + name + " takes too many arguments");
+    if (fn == nullptr) throw std::runtime_error("native function " + name + " has no implementation");
+
+    registry().push_back({name, std::move(params), fn, pure});
+    return registry().size() - 1;
+}
+
+int builtin::find_native(const std::string& name) {
+    const std::vector<NativeFunction>& table = registry();
+    for (size_t i = 0; i < table.size(); i++) {
+        if (table[i].name == name) return i;
+    }
+    return -1;
+}
+
+const std::vector<builtin::NativeFunction>& builtin::natives() {
+    return registry();
+}
+
 bool builtin::is_builtin_func(const std::string& func_name) {
-    return _builtin_functions.find(func_name) != _builtin_functions.end();
-}
\ No newline at end of file
+    return find_native(func_name) >= 0;
+}
@@ -0,0 +1,114 @@
+#include "bytecode.hpp"
+
+static bool fits(int v, int bits) {
+    return v >= -(1 << (bits - 1)) && v < (1 << (bits - 1));
+}
+
+static void operands_of(const Instruction& instr, int& a, int& b, int& c) {
+    if (instr.op == JUMP) {
+        a = instr.arg2;
+        b = instr.arg1;
+        c = instr.arg3;
+    } else {
+        a = instr.arg1;
+        b = instr.arg2;
+        c = instr.arg3;
+    }
+}
+
+static bool is_wide(int a, int b, int c) {
+    return !fits(a, 16) || !fits(b, 24) || !fits(c, 16);
+}
+
+static Bytecode pack(int op, int a, int b, int c) {
+    return static_cast<Bytecode>(op & 0xff)
+        | static_cast<Bytecode>(a & 0xffff) << 8
+        | static_cast<Bytecode>(b & 0xffffff) << 24
+        | static_cast<Bytecode>(c & 0xffff) << 48;
+}
+
+std::vector<Bytecode> bytecode::assemble(const std::vector<Instruction>& instrs, std::vector<int>& addr_of, size_t first, int base) {
+    size_t n = instrs.size() - first;
+    std::vector<bool> wide(n, false);
+    addr_of.assign(n + 1, base);
+
+    auto resolved = [&](size_t i) {
+        Instruction instr = instrs[first + i];
+        if (instr.op == JUMP) instr.arg1 = addr_of[instr.arg1 - first];
+        if (instr.op == JNT || instr.op == INT_JNT) instr.arg2 = addr_of[instr.arg2 - first];
+        return instr;
+    };
+
+    // widening an instruction moves the ones after it, which can push a jump
+    // target out of range, so iterate until the layout is stable
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (size_t i = 0; i < n; i++) {
+            addr_of[i + 1] = addr_of[i] + (wide[i] ? 2 : 1);
+        }
+
+        for (size_t i = 0; i < n; i++) {
+            if (wide[i]) continue;
+            int a, b, c;
+            operands_of(resolved(i), a, b, c);
+            if (is_wide(a, b, c)) {
+                wide[i] = true;
+                changed = true;
+            }
+        }
+    }
+
+    std::vector<Bytecode> code;
+    code.reserve(addr_of[n] - base);
+    for (size_t i = 0; i < n; i++) {
+        int a, b, c;
+        Instruction instr = resolved(i);
+        operands_of(instr, a, b, c);
+        if (wide[i]) {
+            code.push_back(pack(WIDE, a >> 16, b >> 24, c >> 16));
+        }
+        code.push_back(pack(instr.op, a, b, c));
+    }
+
+    return code;
+}
+
+Instruction bytecode::decode(const std::vector<Bytecode>& code, size_t addr, size_t& len) {
+    Bytecode w = code[addr];
+    int a, b, c;
+    if (op(w) == WIDE) {
+        Bytecode next = code[addr + 1];
+        a = wide_a(w, next);
+        b = wide_b(w, next);
+        c = wide_c(w, next);
+        w = next;
+        len = 2;
+    } else {
+        a = bytecode::a(w);
+        b = bytecode::b(w);
+        c = bytecode::c(w);
+        len = 1;
+    }
+
+    // InstructionType is not encoded, it only matters to the generators
+    if (op(w) == JUMP) return {JTYPE, JUMP, b, a, c};
+    return {RTYPE, op(w), a, b, c};
+}
+
+OPCode bytecode::generic(OPCode op) {
+    switch (op) {
+        case ADD_INT_INT: case ADD_STR_STR: return ADD_OP;
+        case SUB_INT_INT: return SUB_OP;
+        case MUL_INT_INT: return MUL_OP;
+        case DIV_INT_INT: return DIV_OP;
+        case MOD_INT_INT: return MOD_OP;
+        case LT_INT_INT: return LT_OP;
+        case LTE_INT_INT: return LTE_OP;
+        case GT_INT_INT: return GT_OP;
+        case GTE_INT_INT: return GTE_OP;
+        case EQ_INT_INT: return EQ_OP;
+        case NEQ_INT_INT: return NEQ_OP;
+        default: return op;
+    }
+}
@@ -0,0 +1,147 @@
+#include "capture_resolver.hpp"
+#include "builtins.hpp"
+#include "ir_generator.hpp"
+
+#include <algorithm>
+
+void CaptureResolver::declare(Expression* exp) {
+    if (exp->get_signature() == ExpressionType::FUNC_ASSIGN_EXP) {
+        FunctionAssignmentExpression* func_exp = dynamic_cast<FunctionAssignmentExpression*>(exp);
+        declared[func_exp->get_name()].push_back(func_exp);
+        for (Expression* body_exp : func_exp->get_body_exps()) declare(body_exp);
+        return;
+    }
+    for (Expression* child : IRGenerator::sub_expressions(exp)) declare(child);
+}
+
+// names exp reads from its frame, a call adds its callee's upvalues
+void CaptureResolver::collect(Expression* exp, std::set<std::string>& reads) const {
+    switch (exp->get_signature()) {
+        case ExpressionType::VAR_EXP:
+            reads.insert(dynamic_cast<VarExp*>(exp)->get_var_name());
+            break;
+        case ExpressionType::LET_EXP: {
+            // in place stores update the variable's current list
+            AssignmentExpression* let_exp = dynamic_cast<AssignmentExpression*>(exp);
+            if (let_exp->is_index_store() || IRGenerator::in_place_list_op(let_exp) != NOP) reads.insert(let_exp->get_id());
+            break;
+        }
+        case ExpressionType::FUNC_CALL_EXP: {
+            auto it = upvalues_of.find(dynamic_cast<FunctionCallExpression*>(exp)->get_name());
+            if (it != upvalues_of.end()) reads.insert(it->second.begin(), it->second.end());
+            break;
+        }
+        default:
+            break;
+    }
+    for (Expression* child : IRGenerator::sub_expressions(exp)) collect(child, reads);
+}
+
+// variables a function assigns before anything could read them, at the top
+// of its body and from a right hand side that does not mention them
+std::set<std::string> CaptureResolver::local_names(FunctionAssignmentExpression* func_exp) const {
+    std::set<std::string> seen, locals;
+    for (Expression* exp : func_exp->get_body_exps()) {
+        AssignmentExpression* let_exp = dynamic_cast<AssignmentExpression*>(exp);
+        if (let_exp && !let_exp->is_index_store() && IRGenerator::in_place_list_op(let_exp) == NOP) {
+            std::set<std::string> rhs;
+            collect(let_exp->get_right(), rhs);
+            if (!seen.count(let_exp->get_id()) && !rhs.count(let_exp->get_id())) locals.insert(let_exp->get_id());
+        }
+        collect(exp, seen);
+        if (let_exp) seen.insert(let_exp->get_id());
+    }
+    return locals;
+}
+
+// a callee's upvalues become reads of its callers, repeated until nothing
+// changes for recursion
+void CaptureResolver::resolve(const std::vector<Expression*>& program) {
+    for (Expression* exp : program) declare(exp);
+    for (const auto& entry : declared) upvalues_of[entry.first];
+
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (const auto& [name, func_exps] : declared) {
+            std::set<std::string>& upvalues = upvalues_of[name];
+            size_t known = upvalues.size();
+            for (FunctionAssignmentExpression* func_exp : func_exps) {
+                std::set<std::string> reads;
+                for (Expression* exp : func_exp->get_body_exps()) collect(exp, reads);
+                const std::vector<std::string>& params = func_exp->get_arg_names();
+                std::set<std::string> locals = local_names(func_exp);
+                for (const std::string& read : reads) {
+                    bool param = std::find(params.begin(), params.end(), read) != params.end();
+                    if (!param && !locals.count(read)) upvalues.insert(read);
+                }
+            }
+            changed = changed || upvalues.size() != known;
+        }
+    }
+    resolve_pure();
+}
+
+// false for a print, a declaration or an impure native anywhere in exp, the
+// functions it calls go in callees
+bool CaptureResolver::effect_free(Expression* exp, std::set<std::string>& callees) const {
+    switch (exp->get_signature()) {
+        case ExpressionType::MON_EXP:
+            if (dynamic_cast<MonadicExpression*>(exp)->get_type() == MonadicOperator::PrintOp) return false;
+            break;
+        case ExpressionType::FUNC_ASSIGN_EXP:
+            return false;
+        case ExpressionType::FUNC_CALL_EXP: {
+            FunctionCallExpression* call_exp = dynamic_cast<FunctionCallExpression*>(exp);
+            int nid = IRGenerator::resolve_native(call_exp);
+            if (nid < 0) callees.insert(call_exp->get_name());
+            else if (!builtin::natives()[nid].pure) return false;
+            break;
+        }
+        default:
+            break;
+    }
+    for (Expression* child : IRGenerator::sub_expressions(exp)) {
+        if (!effect_free(child, callees)) return false;
+    }
+    return true;
+}
+
+// starts from every function that is pure on its own and drops the ones
+// calling a function that is not, until nothing changes
+void CaptureResolver::resolve_pure() {
+    std::map<std::string, std::set<std::string>> callees_of;
+    for (const auto& [name, func_exps] : declared) {
+        // a name declared twice runs whichever declaration came last
+        if (func_exps.size() != 1 || !upvalues_of.at(name).empty()) continue;
+        std::set<std::string> callees;
+        bool free = true;
+        for (Expression* exp : func_exps[0]->get_body_exps()) free = free && effect_free(exp, callees);
+        if (free) callees_of[name] = std::move(callees);
+    }
+    for (const auto& entry : callees_of) pure.insert(entry.first);
+
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (const auto& [name, callees] : callees_of) {
+            if (!pure.count(name)) continue;
+            for (const std::string& callee : callees) {
+                if (pure.count(callee)) continue;
+                pure.erase(name);
+                changed = true;
+                break;
+            }
+        }
+    }
+}
+
+bool CaptureResolver::frame_of(const FunctionCallExpression* call_exp, std::vector<std::string>& names) const {
+    auto it = upvalues_of.find(call_exp->get_name());
+    if (it == upvalues_of.end()) return false;
+
+    std::set<std::string> reads = it->second;
+    for (Expression* arg_exp : call_exp->get_arg_exps()) collect(arg_exp, reads);
+    names.assign(reads.begin(), reads.end());
+    return true;
+}
@@ -0,0 +1,312 @@
+#include "closure_evaluator.hpp"
+#include "builtins.hpp"
+#include "ir_generator.hpp"
+#include "tree_evaluator.hpp"
+#include "value_ops.hpp"
+
+#include <stdexcept>
+
+int ClosureEvaluator::var_slot(const std::string& name) {
+    auto [it, added] = var_slots.emplace(name, static_cast<int>(var_names.size()));
+    if (added) var_names.push_back(name);
+    return it->second;
+}
+
+int ClosureEvaluator::func_slot(const std::string& name) {
+    auto [it, added] = func_slots.emplace(name, static_cast<int>(bound.size()));
+    if (added) bound.push_back(nullptr);
+    return it->second;
+}
+
+void ClosureEvaluator::undefined(int slot) const {
+    throw std::runtime_error("Error identifier " + var_names[slot] + " does not exist in store");
+}
+
+Value ClosureEvaluator::run_block(const std::vector<Code>& block, Frame& frame) {
+    // only the last statement's value is kept, a list held on to by an
+    // earlier one would make the next in place store copy it
+    for (size_t i = 0; i + 1 < block.size(); i++) {
+        Value val = block[i](frame);
+        if (frame.returning) return val;
+    }
+    return block.empty() ? Value() : block.back()(frame);
+}
+
+std::vector<ClosureEvaluator::Code> ClosureEvaluator::compile_block(const std::vector<Expression*>& exps) {
+    std::vector<Code> block;
+    block.reserve(exps.size());
+    for (Expression* exp : exps) block.push_back(compile(exp));
+    return block;
+}
+
+ClosureEvaluator::Code ClosureEvaluator::compile(Expression* exp) {
+    Code code = compile_node(exp);
+    if (!exp->is_returnable()) return code;
+
+    // the nodes TreeEvaluator hands back as returned when the parser marked
+    // them, statements never return themselves
+    switch (exp->get_signature()) {
+        case ExpressionType::LET_EXP:
+        case ExpressionType::FUNC_ASSIGN_EXP:
+        case ExpressionType::LIST_MODIFY_EXP:
+        case ExpressionType::IF_EXP:
+        case ExpressionType::WHILE_EXP:
+            return code;
+        case ExpressionType::MON_EXP:
+            if (dynamic_cast<MonadicExpression*>(exp)->get_type() == MonadicOperator::PrintOp) return code;
+            break;
+        default:
+            break;
+    }
+    return [code](Frame& frame) {
+        Value val = code(frame);
+        frame.returning = true;
+        return val;
+    };
+}
+
+ClosureEvaluator::Code ClosureEvaluator::compile_node(Expression* exp) {
+    switch (exp->get_signature()) {
+        case ExpressionType::EMPTY_EXP:
+            return [](Frame&) { return Value(); };
+        case ExpressionType::CONST_EXP: {
+            Value val = dynamic_cast<ConstExp*>(exp)->get_val();
+            return [val](Frame&) { return val; };
+        }
+        case ExpressionType::VAR_EXP: {
+            int slot = var_slot(dynamic_cast<VarExp*>(exp)->get_var_name());
+            return [this, slot](Frame& frame) {
+                const Slot& var = frame.vars[slot];
+                if (!var.defined) undefined(slot);
+                return var.value;
+            };
+        }
+        case ExpressionType::BIN_EXP: {
+            BinaryExpression* bin_exp = dynamic_cast<BinaryExpression*>(exp);
+            Code left = compile(bin_exp->get_left());
+            Code right = compile(bin_exp->get_right());
+            BinaryOperator bin_op = bin_exp->get_type();
+            if (bin_op == BinaryOperator::IntPlusOp) {
+                // an unshared list on the left is appended to in place
+                return [left, right](Frame& frame) {
+                    Value lhs = left(frame);
+                    return std::move(lhs) + right(frame);
+                };
+            }
+            return [left, right, bin_op](Frame& frame) {
+                Value lhs = left(frame);
+                Value rhs = right(frame);
+                return value_ops::binary(TreeEvaluator::binop_of(bin_op), lhs, rhs);
+            };
+        }
+        case ExpressionType::MON_EXP: {
+            MonadicExpression* mon_exp = dynamic_cast<MonadicExpression*>(exp);
+            Code right = compile(mon_exp->get_right());
+            switch (mon_exp->get_type()) {
+                case MonadicOperator::IntNegOp: return [right](Frame& frame) { return -right(frame); };
+                case MonadicOperator::NotOp: return [right](Frame& frame) { return !right(frame); };
+                case MonadicOperator::SizeOp: return [right](Frame& frame) { return right(frame).size(); };
+                case MonadicOperator::PrintOp:
+                    return [this, right](Frame& frame) {
+                        output.write_line(right(frame));
+                        return Value();
+                    };
+                default: throw std::runtime_error("Incorrect MonOp (int): " + std::to_string(int(mon_exp->get_type())));
+            }
+        }
+        case ExpressionType::LET_EXP:
+            return compile_let(dynamic_cast<AssignmentExpression*>(exp));
+        case ExpressionType::IF_EXP: {
+            IfExpression* if_exp = dynamic_cast<IfExpression*>(exp);
+            Code cond = compile(if_exp->get_conditional());
+            std::vector<Code> then_block = compile_block(if_exp->get_if_exps());
+            std::vector<Code> else_block = compile_block(if_exp->get_else_exps());
+            return [cond, then_block, else_block](Frame& frame) {
+                Value cond_val = cond(frame);
+                if (!cond_val.is_bool()) throw std::runtime_error("If condition does not evaluate to bool");
+                return run_block(cond_val.as_bool() ? then_block : else_block, frame);
+            };
+        }
+        case ExpressionType::WHILE_EXP: {
+            WhileExpression* while_exp = dynamic_cast<WhileExpression*>(exp);
+            Code cond = compile(while_exp->get_conditional());
+            std::vector<Code> body = compile_block(while_exp->get_body_exps());
+            return [cond, body](Frame& frame) {
+                while (true) {
+                    Value cond_val = cond(frame);
+                    if (!cond_val.is_bool()) throw std::runtime_error("While loop condition does not evaluate to bool");
+                    if (!cond_val.as_bool()) return Value();
+
+                    Value last = run_block(body, frame);
+                    if (frame.returning) return last;
+                }
+            };
+        }
+        case ExpressionType::FUNC_ASSIGN_EXP: {
+            FunctionAssignmentExpression* func_exp = dynamic_cast<FunctionAssignmentExpression*>(exp);
+            functions.push_back(std::make_unique<Function>());
+            Function* fn = functions.back().get();
+            for (const std::string& param : func_exp->get_arg_names()) fn->params.push_back(var_slot(param));
+            fn->body = compile_block(func_exp->get_body_exps());
+
+            int slot = func_slot(func_exp->get_name());
+            return [this, slot, fn](Frame&) {
+                bound[slot] = fn;
+                return Value();
+            };
+        }
+        case ExpressionType::FUNC_CALL_EXP:
+            return compile_call(dynamic_cast<FunctionCallExpression*>(exp));
+        case ExpressionType::LIST_EXP: {
+            std::vector<Code> elements = compile_block(dynamic_cast<ListExpression*>(exp)->get_elements());
+            return [elements](Frame& frame) {
+                std::vector<Value> items;
+                items.reserve(elements.size());
+                for (const Code& element : elements) items.push_back(element(frame));
+                return Value(std::move(items));
+            };
+        }
+        case ExpressionType::LIST_ACCESS_EXP: {
+            ListAccessExpression* access_exp = dynamic_cast<ListAccessExpression*>(exp);
+            Code arr = compile(access_exp->get_arr_exp());
+            Code idx = compile(access_exp->get_idx_exp());
+            return [arr, idx](Frame& frame) {
+                Value arr_val = arr(frame);
+                Value idx_val = idx(frame);
+                return arr_val[idx_val];
+            };
+        }
+        case ExpressionType::LIST_MODIFY_EXP: {
+            ListModifyExpression* modify_exp = dynamic_cast<ListModifyExpression*>(exp);
+            Code list = compile(modify_exp->get_ident_exp());
+            Code idx = compile(modify_exp->get_idx_exp());
+            Code val = compile(modify_exp->get_exp());
+            return [list, idx, val](Frame& frame) {
+                Value list_val = list(frame);
+                Value idx_val = idx(frame);
+                Value new_val = val(frame);
+                if (!list_val.is_list() || !idx_val.is_int()) throw std::runtime_error("Unidentified Expression Type");
+
+                std::vector<Value>& arr = list_val.list_ref();
+                int i = idx_val.as_int();
+                if (i < 0 || static_cast<size_t>(i) >= arr.size()) throw std::runtime_error("Index out of bounds");
+                arr[i] = std::move(new_val);
+                return list_val;
+            };
+        }
+    }
+    throw std::runtime_error("Unidentified Expression Type");
+}
+
+ClosureEvaluator::Code ClosureEvaluator::compile_let(AssignmentExpression* let_exp) {
+    int slot = var_slot(let_exp->get_id());
+
+    // x = append(x, e) and friends mutate x's slot instead of rebuilding it
+    OPCode in_place_op = IRGenerator::in_place_list_op(let_exp);
+    if (in_place_op != NOP) {
+        const std::vector<Expression*>& arg_exps = dynamic_cast<FunctionCallExpression*>(let_exp->get_right())->get_arg_exps();
+        std::vector<Code> args;
+        for (size_t i = 1; i < arg_exps.size(); i++) args.push_back(compile(arg_exps[i]));
+        return [this, slot, in_place_op, args](Frame& frame) {
+            if (!frame.vars[slot].defined) undefined(slot);
+            Value argv[2];
+            for (size_t i = 0; i < args.size(); i++) argv[i] = args[i](frame);
+
+            Value& list = frame.vars[slot].value;
+            switch (in_place_op) {
+                case APPEND_VAR: builtin::append_ref(list, std::move(argv[0])); break;
+                case INSERT_VAR: builtin::insert_ref(list, argv[0], std::move(argv[1])); break;
+                case REMOVE_VAR: builtin::remove_ref(list, argv[0]); break;
+                default: builtin::pop_ref(list); break;
+            }
+            return list;
+        };
+    }
+
+    // x[i] = e stores into x's slot, deeper paths copy like the tree does
+    if (let_exp->is_index_store()) {
+        ListModifyExpression* modify_exp = dynamic_cast<ListModifyExpression*>(let_exp->get_right());
+        Expression* ident_exp = modify_exp->get_ident_exp();
+        if (ident_exp->get_signature() == ExpressionType::VAR_EXP &&
+            dynamic_cast<VarExp*>(ident_exp)->get_var_name() == let_exp->get_id() &&
+            modify_exp->get_exp()->get_signature() != ExpressionType::LIST_MODIFY_EXP) {
+            Code idx = compile(modify_exp->get_idx_exp());
+            Code val = compile(modify_exp->get_exp());
+            return [this, slot, idx, val](Frame& frame) {
+                if (!frame.vars[slot].defined) undefined(slot);
+                Value idx_val = idx(frame);
+                Value new_val = val(frame);
+
+                Value& list = frame.vars[slot].value;
+                if (!list.is_list() || !idx_val.is_int()) throw std::runtime_error("Unidentified Expression Type");
+                std::vector<Value>& arr = list.list_ref();
+                int i = idx_val.as_int();
+                if (i < 0 || static_cast<size_t>(i) >= arr.size()) throw std::runtime_error("Index out of bounds");
+                arr[i] = std::move(new_val);
+                return list;
+            };
+        }
+    }
+
+    Code right = compile(let_exp->get_right());
+    return [slot, right](Frame& frame) {
+        Value val = right(frame);
+        Slot& var = frame.vars[slot];
+        var.value = val;
+        var.defined = true;
+        return val;
+    };
+}
+
+ClosureEvaluator::Code ClosureEvaluator::compile_call(FunctionCallExpression* call_exp) {
+    std::vector<Code> args = compile_block(call_exp->get_arg_exps());
+
+    int nid = call_exp->calls_user_function() ? -1 : builtin::find_native(call_exp->get_name());
+    if (nid >= 0) {
+        const builtin::NativeFunction& native = builtin::natives()[nid];
+        if (static_cast<int>(args.size()) != native.arity()) {
+            std::string error = "function call does not match " + native.signature();
+            return [args, error](Frame& frame) -> Value {
+                for (const Code& arg : args) arg(frame);
+                throw std::runtime_error(error);
+            };
+        }
+        builtin::NativeFn fn = native.fn;
+        return [args, fn](Frame& frame) {
+            Value argv[builtin::MAX_NATIVE_ARGS];
+            for (size_t i = 0; i < args.size(); i++) argv[i] = args[i](frame);
+            return fn(argv);
+        };
+    }
+
+    int slot = func_slot(call_exp->get_name());
+    return [this, slot, args](Frame& frame) {
+        std::vector<Value> argv;
+        argv.reserve(args.size());
+        for (const Code& arg : args) argv.push_back(arg(frame));
+
+        // looked up after the args ran, one of them may have declared it
+        Function* fn = bound[slot];
+        if (!fn) throw std::runtime_error("function does not exist");
+        if (fn->params.size() != argv.size()) throw std::runtime_error("function call does not have same # of args as declaration");
+
+        Frame callee{frame.vars};
+        for (size_t i = 0; i < argv.size(); i++) callee.vars[fn->params[i]] = {std::move(argv[i]), true};
+        return run_block(fn->body, callee);
+    };
+}
+
+void ClosureEvaluator::evaluate_commands(const std::vector<Expression*>& commands) {
+    std::vector<Code> program = compile_block(commands);
+    Frame top{std::vector<Slot>(var_names.size())};
+    try {
+        for (const Code& code : program) {
+            code(top);
+            top.returning = false;
+        }
+    } catch (...) {
+        output.flush();
+        throw;
+    }
+    output.flush();
+}
@@ -0,0 +1,475 @@
+#include "cpp_emitter.hpp"
+#include "ir_generator.hpp"
+#include "builtins.hpp"
+
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+#include <stdexcept>
+
+static bool is_simple(Expression* exp) {
+    return exp->get_signature() == ExpressionType::CONST_EXP || exp->get_signature() == ExpressionType::VAR_EXP;
+}
+
+static std::string quote(const std::string& s) {
+    std::string res = "\"";
+    for (unsigned char c : s) {
+        if (c == '"' || c == '\\') {
+            res += '\\';
+            res += c;
+        } else if (c < 32 || c >= 127) {
+            char esc[8];
+            std::snprintf(esc, sizeof(esc), "\\%03o", c);
+            res += esc;
+        } else {
+            res += c;
+        }
+    }
+    return res + "\"";
+}
+
+std::string CppEmitter::emit(const std::vector<Expression*>& exps) {
+    functions.push_back({nullptr, "rv_main", {}, {}});
+    for (Expression* exp : exps) resolve(exp, 0);
+    while (!func_queue.empty()) {
+        int f = func_queue.front();
+        func_queue.pop();
+        for (const std::string& param : functions[f].exp->get_arg_names()) declare(param);
+        for (Expression* exp : functions[f].exp->get_body_exps()) resolve(exp, f);
+    }
+    find_frames(exps);
+
+    out << "// generated by --emit-cpp\n";
+    out << "#include \"cpp_runtime.hpp\"\n\n";
+    out << "static OutputWriter out;\n";
+    out << "static Value v0; // the VM's return register\n";
+
+    std::vector<std::string> strings(string_ids.size());
+    for (const auto& [s, id] : string_ids) strings[id] = s;
+    for (size_t i = 0; i < strings.size(); i++) out << "static Value s" << i << ";\n";
+    for (int nid : natives_used) out << "static builtin::NativeFn native_" << builtin::natives()[nid].name << ";\n";
+    out << "\n";
+
+    for (size_t f = 1; f < functions.size(); f++) out << "static " << signature(f) << ";\n";
+    out << "\n";
+
+    function(0, exps);
+    for (size_t f = 1; f < functions.size(); f++) function(f, functions[f].exp->get_body_exps());
+
+    out << "int main() {\n";
+    for (size_t i = 0; i < strings.size(); i++) {
+        out << "    s" << i << " = Value(std::string(" << quote(strings[i]) << ", " << strings[i].size() << "));\n";
+    }
+    for (int nid : natives_used) {
+        const std::string& name = builtin::natives()[nid].name;
+        out << "    native_" << name << " = rv::native(" << quote(name) << ");\n";
+    }
+    out << "    rv::run(rv_main, out);\n";
+    out << "}\n";
+    return out.str();
+}
+
+// Resolution
+
+void CppEmitter::resolve(Expression* exp, int f) {
+    switch (exp->get_signature()) {
+        case ExpressionType::CONST_EXP: {
+            ConstExp* const_exp = dynamic_cast<ConstExp*>(exp);
+            if (const_exp->get_type() == ConstType::StringConst) {
+                string_ids.emplace(const_exp->get_val().as_string(), string_ids.size());
+            }
+            return;
+        }
+        case ExpressionType::VAR_EXP: {
+            // names resolve in any order, like IRGenerator::intern_ident
+            const std::string& name = dynamic_cast<VarExp*>(exp)->get_var_name();
+            declare(name);
+            var_of[exp] = name;
+            return;
+        }
+        case ExpressionType::LET_EXP: {
+            AssignmentExpression* let_exp = dynamic_cast<AssignmentExpression*>(exp);
+            if (let_exp->is_index_store() || IRGenerator::in_place_list_op(let_exp) != NOP) {
+                var_of[exp] = declared(let_exp->get_id(), f);
+                for (Expression* child : IRGenerator::sub_expressions(exp)) resolve(child, f);
+                return;
+            }
+            resolve(let_exp->get_right(), f);
+            if (!let_exp->is_reassign()) declare(let_exp->get_id());
+            var_of[exp] = declared(let_exp->get_id(), f);
+            return;
+        }
+        case ExpressionType::BIN_EXP: {
+            if (dynamic_cast<BinaryExpression*>(exp)->get_type() == BinaryOperator::EqualsOp) {
+                throw std::runtime_error("Unknown binary operation");
+            }
+            break;
+        }
+        case ExpressionType::FUNC_ASSIGN_EXP: {
+            FunctionAssignmentExpression* func_exp = dynamic_cast<FunctionAssignmentExpression*>(exp);
+            int index = functions.size();
+            functions.push_back({func_exp, "f" + std::to_string(index - 1) + "_" + func_exp->get_name(), {}, {}});
+            fid_of[func_exp->get_name()] = index;
+            func_queue.push(index);
+            return;
+        }
+        case ExpressionType::FUNC_CALL_EXP: {
+            FunctionCallExpression* call_exp = dynamic_cast<FunctionCallExpression*>(exp);
+            const std::vector<Expression*>& args = call_exp->get_arg_exps();
+            int nid = IRGenerator::resolve_native(call_exp);
+            if (nid >= 0) {
+                callee_of[call_exp] = -1 - nid;
+                natives_used.insert(nid);
+                for (Expression* arg : args) resolve(arg, f);
+                return;
+            }
+
+            // an unknown name calls the first function, like ident_to_fid's default
+            auto it = fid_of.find(call_exp->get_name());
+            if (it == fid_of.end()) {
+                if (functions.size() == 1) throw std::runtime_error("function " + call_exp->get_name() + " does not exist");
+                it = fid_of.emplace(call_exp->get_name(), 1).first;
+            }
+            int callee = it->second;
+            const std::vector<std::string>& params = functions[callee].exp->get_arg_names();
+            if (params.size() != args.size()) throw std::runtime_error("function call does not have same # of args as declaration");
+
+            for (size_t i = 0; i < args.size(); i++) {
+                resolve(args[i], f);
+                declare(params[i]);
+            }
+            callee_of[call_exp] = callee;
+            return;
+        }
+        default:
+            break;
+    }
+    for (Expression* child : IRGenerator::sub_expressions(exp)) resolve(child, f);
+}
+
+void CppEmitter::declare(const std::string& name) {
+    idents.insert(name);
+}
+
+// a function body may assign a variable its callers declare, like
+// IRGenerator::declared_ident
+const std::string& CppEmitter::declared(const std::string& name, int f) {
+    if (f > 0) declare(name);
+    auto it = idents.find(name);
+    if (it == idents.end()) throw std::runtime_error("Variable " + name + " has not been properly declared");
+    return *it;
+}
+
+// Frames
+
+// the variables exp reads or writes in its frame, a call reads what its
+// callee inherits
+void CppEmitter::collect(Expression* exp, std::set<std::string>& mentions) const {
+    auto var = var_of.find(exp);
+    if (var != var_of.end()) mentions.insert(var->second);
+    if (exp->get_signature() == ExpressionType::FUNC_CALL_EXP) {
+        int callee = callee_of.at(dynamic_cast<FunctionCallExpression*>(exp));
+        if (callee >= 0) mentions.insert(functions[callee].inherited.begin(), functions[callee].inherited.end());
+    }
+    for (Expression* child : IRGenerator::sub_expressions(exp)) collect(child, mentions);
+}
+
+// variables a function assigns before anything could read them, at the top
+// of its body and from a right hand side that does not mention them
+std::set<std::string> CppEmitter::local_names(int f) const {
+    std::set<std::string> seen, locals;
+    for (Expression* exp : functions[f].exp->get_body_exps()) {
+        AssignmentExpression* let_exp = dynamic_cast<AssignmentExpression*>(exp);
+        if (let_exp && !let_exp->is_index_store() && IRGenerator::in_place_list_op(let_exp) == NOP) {
+            const std::string& name = var_of.at(exp);
+            std::set<std::string> rhs;
+            collect(let_exp->get_right(), rhs);
+            if (!seen.count(name) && !rhs.count(name)) locals.insert(name);
+        }
+        collect(exp, seen);
+    }
+    return locals;
+}
+
+// a callee's inherited variables become names of its callers, repeated until
+// nothing changes for recursion
+void CppEmitter::find_frames(const std::vector<Expression*>& top_level) {
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (size_t f = 0; f < functions.size(); f++) {
+            Function& func = functions[f];
+            std::set<std::string> names;
+            for (Expression* exp : f == 0 ? top_level : func.exp->get_body_exps()) collect(exp, names);
+
+            std::set<std::string> inherited;
+            if (f > 0) {
+                const std::vector<std::string>& params = func.exp->get_arg_names();
+                names.insert(params.begin(), params.end());
+                std::set<std::string> locals = local_names(f);
+                for (const std::string& name : names) {
+                    bool param = std::find(params.begin(), params.end(), name) != params.end();
+                    if (!param && !locals.count(name)) inherited.insert(name);
+                }
+            }
+
+            if (names != func.names || inherited != func.inherited) {
+                func.names = names;
+                func.inherited = inherited;
+                changed = true;
+            }
+        }
+    }
+}
+
+// Emission
+
+bool CppEmitter::has_effect(Expression* exp) const {
+    if (exp->get_signature() == ExpressionType::FUNC_CALL_EXP) return true;
+    if (exp->get_signature() == ExpressionType::MON_EXP && dynamic_cast<MonadicExpression*>(exp)->get_type() == MonadicOperator::PrintOp) return true;
+    for (Expression* child : IRGenerator::sub_expressions(exp)) {
+        if (has_effect(child)) return true;
+    }
+    return false;
+}
+
+std::string CppEmitter::lookup(const std::string& name) const {
+    auto it = bound.find(name);
+    return it != bound.end() ? it->second : "v_" + name;
+}
+
+std::string CppEmitter::temp(const std::string& exp) {
+    std::string name = "t" + std::to_string(temps++);
+    line("Value " + name + " = " + exp + ";");
+    return name;
+}
+
+void CppEmitter::line(const std::string& code) {
+    out << std::string(4 * depth, ' ') << code << "\n";
+}
+
+// operands evaluated left to right, one that a later call or print could
+// otherwise overtake is computed into a temp first
+std::vector<std::string> CppEmitter::operands(const std::vector<Expression*>& exps) {
+    std::vector<std::string> vals;
+    for (size_t i = 0; i < exps.size(); i++) {
+        std::string val = expression(exps[i]);
+        bool overtaken = false;
+        for (size_t j = i + 1; j < exps.size(); j++) overtaken = overtaken || has_effect(exps[j]);
+        vals.push_back(overtaken && !is_simple(exps[i]) ? temp(val) : val);
+    }
+    return vals;
+}
+
+std::string CppEmitter::expression(Expression* exp) {
+    switch (exp->get_signature()) {
+        case ExpressionType::CONST_EXP: {
+            ConstExp* const_exp = dynamic_cast<ConstExp*>(exp);
+            Value val = const_exp->get_val();
+            switch (const_exp->get_type()) {
+                case ConstType::IntConst: return val.as_int() == INT_MIN ? "Value(INT_MIN)" : "Value(" + std::to_string(val.as_int()) + ")";
+                case ConstType::BoolConst: return val.as_bool() ? "Value(true)" : "Value(false)";
+                case ConstType::StringConst: return "s" + std::to_string(string_ids.at(val.as_string()));
+            }
+            return "Value()";
+        }
+        case ExpressionType::VAR_EXP:
+            return lookup(var_of.at(exp));
+        case ExpressionType::MON_EXP: {
+            MonadicExpression* mon_exp = dynamic_cast<MonadicExpression*>(exp);
+            std::string val = expression(mon_exp->get_right());
+            switch (mon_exp->get_type()) {
+                case MonadicOperator::NotOp: return "(!" + val + ")";
+                case MonadicOperator::IntNegOp: return "(-" + val + ")";
+                case MonadicOperator::SizeOp: return val + ".size()";
+                case MonadicOperator::PrintOp:
+                    line("out.write_line(" + val + ");");
+                    return "Value()";
+            }
+            throw std::runtime_error("Unknown mon op");
+        }
+        case ExpressionType::BIN_EXP: {
+            BinaryExpression* bin_exp = dynamic_cast<BinaryExpression*>(exp);
+            std::vector<std::string> vals = operands({bin_exp->get_left(), bin_exp->get_right()});
+            std::string fn;
+            switch (bin_exp->get_type()) {
+                case BinaryOperator::IntPlusOp: fn = "add"; break;
+                case BinaryOperator::IntMinusOp: fn = "sub"; break;
+                case BinaryOperator::IntTimesOp: fn = "mul"; break;
+                case BinaryOperator::IntDivOp: fn = "div"; break;
+                case BinaryOperator::IntPowOp: fn = "pow"; break;
+                case BinaryOperator::ModOp: fn = "mod"; break;
+                case BinaryOperator::EqualityOp: fn = "eq"; break;
+                case BinaryOperator::NotEqualsOp: fn = "neq"; break;
+                case BinaryOperator::AndOp: fn = "logical_and"; break;
+                case BinaryOperator::OrOp: fn = "logical_or"; break;
+                case BinaryOperator::LtOp: fn = "lt"; break;
+                case BinaryOperator::LteOp: fn = "lte"; break;
+                case BinaryOperator::GtOp: fn = "gt"; break;
+                case BinaryOperator::GteOp: fn = "gte"; break;
+                default: throw std::runtime_error("Unknown binary operation");
+            }
+            return "rv::" + fn + "(" + vals[0] + ", " + vals[1] + ")";
+        }
+        case ExpressionType::LIST_EXP: {
+            std::string res = "rv::list({";
+            std::vector<std::string> vals = operands(dynamic_cast<ListExpression*>(exp)->get_elements());
+            for (size_t i = 0; i < vals.size(); i++) res += (i ? ", " : "") + vals[i];
+            return res + "})";
+        }
+        case ExpressionType::LIST_ACCESS_EXP: {
+            std::vector<std::string> vals = operands(IRGenerator::sub_expressions(exp));
+            return vals[0] + "[" + vals[1] + "]";
+        }
+        case ExpressionType::LIST_MODIFY_EXP: {
+            std::vector<std::string> vals = operands(IRGenerator::sub_expressions(exp));
+            return "rv::modify(" + vals[0] + ", " + vals[1] + ", " + vals[2] + ")";
+        }
+        case ExpressionType::FUNC_CALL_EXP:
+            return call(dynamic_cast<FunctionCallExpression*>(exp));
+        default:
+            return "Value()";
+    }
+}
+
+// A native gets its evaluated args. A user function gets its args, each
+// evaluated with the params before it already bound, then what it inherits
+// from the frame the call runs in.
+std::string CppEmitter::call(FunctionCallExpression* call_exp) {
+    int callee = callee_of.at(call_exp);
+    const std::vector<Expression*>& args = call_exp->get_arg_exps();
+    if (callee < 0) {
+        std::string res = "rv::call(native_" + builtin::natives()[-1 - callee].name;
+        for (const std::string& val : operands(args)) res += ", " + val;
+        return res + ")";
+    }
+
+    const Function& func = functions[callee];
+    const std::vector<std::string>& params = func.exp->get_arg_names();
+    std::map<std::string, std::string> saved = bound;
+    std::vector<std::string> vals;
+    for (size_t i = 0; i < args.size(); i++) {
+        std::string val = expression(args[i]);
+        if (!is_simple(args[i])) val = temp(val);
+        bound[params[i]] = val;
+        vals.push_back(val);
+    }
+    for (const std::string& name : func.inherited) vals.push_back(lookup(name));
+    bound = saved;
+
+    std::string res = func.name + "(";
+    for (size_t i = 0; i < vals.size(); i++) res += (i ? ", " : "") + vals[i];
+    return res + ")";
+}
+
+void CppEmitter::statement(Expression* exp) {
+    switch (exp->get_signature()) {
+        case ExpressionType::LET_EXP: {
+            AssignmentExpression* let_exp = dynamic_cast<AssignmentExpression*>(exp);
+            std::string var = "v_" + var_of.at(exp);
+            if (let_exp->is_index_store()) {
+                // arr[i][j] = x, the path ends in the slot that is stored into
+                std::vector<std::string> vals = operands(IRGenerator::sub_expressions(exp));
+                std::string slot = var;
+                for (size_t i = 0; i + 2 < vals.size(); i++) slot += ".index_ref(" + vals[i] + ")";
+                line(slot + ".store_index(" + vals[vals.size() - 2] + ", " + vals.back() + ");");
+                return;
+            }
+            OPCode in_place = IRGenerator::in_place_list_op(let_exp);
+            if (in_place != NOP) {
+                std::string fn = in_place == APPEND_VAR ? "append_ref" : in_place == INSERT_VAR ? "insert_ref" : in_place == REMOVE_VAR ? "remove_ref" : "pop_ref";
+                std::string res = "builtin::" + fn + "(" + var;
+                for (const std::string& val : operands(IRGenerator::sub_expressions(exp))) res += ", " + val;
+                line(res + ");");
+                return;
+            }
+            line(var + " = " + expression(let_exp->get_right()) + ";");
+            return;
+        }
+        case ExpressionType::IF_EXP: {
+            IfExpression* if_exp = dynamic_cast<IfExpression*>(exp);
+            line("if (rv::truthy(" + expression(if_exp->get_conditional()) + ")) {");
+            block(if_exp->get_if_exps());
+            if (!if_exp->get_else_exps().empty()) {
+                line("} else {");
+                block(if_exp->get_else_exps());
+            }
+            line("}");
+            return;
+        }
+        case ExpressionType::WHILE_EXP: {
+            WhileExpression* while_exp = dynamic_cast<WhileExpression*>(exp);
+            line("for (;;) {");
+            depth++;
+            line("if (!rv::truthy(" + expression(while_exp->get_conditional()) + ")) break;");
+            depth--;
+            block(while_exp->get_body_exps());
+            line("}");
+            return;
+        }
+        case ExpressionType::FUNC_ASSIGN_EXP:
+            return;
+        case ExpressionType::EMPTY_EXP:
+            if (exp->is_returnable()) line("return v0;");
+            return;
+        case ExpressionType::MON_EXP:
+            if (dynamic_cast<MonadicExpression*>(exp)->get_type() == MonadicOperator::PrintOp) {
+                line("out.write_line(" + expression(dynamic_cast<MonadicExpression*>(exp)->get_right()) + ");");
+                return;
+            }
+            break;
+        case ExpressionType::FUNC_CALL_EXP:
+            // returning a user call's value just leaves it in v0, the
+            // function carries on like it does in the VM
+            if (callee_of.at(dynamic_cast<FunctionCallExpression*>(exp)) >= 0) {
+                line(expression(exp) + ";");
+                return;
+            }
+            break;
+        default:
+            break;
+    }
+
+    std::string val = expression(exp);
+    if (exp->is_returnable() && exp->get_signature() != ExpressionType::LIST_MODIFY_EXP) {
+        line("v0 = " + val + ";");
+        line("return v0;");
+    } else {
+        line("(void)" + val + ";");
+    }
+}
+
+void CppEmitter::block(const std::vector<Expression*>& exps) {
+    depth++;
+    for (Expression* exp : exps) statement(exp);
+    depth--;
+}
+
+std::string CppEmitter::signature(int f) const {
+    const Function& func = functions[f];
+    std::string res = "Value " + func.name + "(";
+    std::vector<std::string> params;
+    if (func.exp) params = func.exp->get_arg_names();
+    params.insert(params.end(), func.inherited.begin(), func.inherited.end());
+    for (size_t i = 0; i < params.size(); i++) res += (i ? ", " : "") + ("Value v_" + params[i]);
+    return res + ")";
+}
+
+void CppEmitter::function(int f, const std::vector<Expression*>& body) {
+    const Function& func = functions[f];
+    std::vector<std::string> params;
+    if (func.exp) params = func.exp->get_arg_names();
+
+    out << "static " << signature(f) << " {\n";
+    depth = 1;
+    for (const std::string& name : func.names) {
+        bool param = std::find(params.begin(), params.end(), name) != params.end();
+        if (!param && !func.inherited.count(name)) line("Value v_" + name + ";");
+    }
+    depth = 0;
+    block(body);
+    depth = 1;
+    line("return v0;");
+    depth = 0;
+    out << "}\n\n";
+}
@@ -55,14 +55,14 @@ Value MonadicExpression::evaluate(Environment& env) const {
         };
     };
 
-    if (std::holds_alternative<std::string>(val.data)) {
-        return handle_string(std::get<std::string>(val.data));
-    } else if (std::holds_alternative<int>(val.data)) {
-        return handle_int(std::get<int>(val.data));
-    } else if (std::holds_alternative<bool>(val.data)) {
-        return handle_bool(std::get<bool>(val.data));
-    } else if (std::holds_alternative<std::vector<Value>>(val.data)) {
-        return handle_list(std::get<std::vector<Value>>(val.data));
+    if (val.is_string()) {
+        return handle_string(val.as_string());
+    } else if (val.is_int()) {
+        return handle_int(val.as_int());
+    } else if (val.is_bool()) {
+        return handle_bool(val.as_bool());
+    } else if (val.is_list()) {
+        return handle_list(val.as_list());
     }
 
     return Value();
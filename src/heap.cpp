@@ -0,0 +1,158 @@
+#include "heap.hpp"
+#include "value.hpp"
+
+#include <chrono>
+#include <vector>
+
+// Cycle collection by trial deletion: a list's gc_refs starts at its
+// reference count and loses one for every reference from another list, so
+// what is left counts references from outside the heap (VM registers and
+// frames, constant tables, the AST, C++ locals). Lists with outside
+// references are the roots, everything reachable from them survives and the
+// rest can only be referenced by each other.
+
+static heap::Config gc_config;
+static heap::Stats gc_stats;
+
+// sentinel heads of the circular object lists
+static HeapObject strings_head = {0, 0, &strings_head, &strings_head};
+static HeapObject lists_head = {0, 0, &lists_head, &lists_head};
+
+static size_t allocations = 0; // lists since the last collection
+static size_t threshold = heap::Config().min_threshold;
+
+static const uint32_t REACHABLE = UINT32_MAX;
+
+static void link(HeapObject& head, HeapObject* obj) {
+    obj->gc_prev = head.gc_prev;
+    obj->gc_next = &head;
+    head.gc_prev->gc_next = obj;
+    head.gc_prev = obj;
+}
+
+static void unlink(HeapObject* obj) {
+    obj->gc_prev->gc_next = obj->gc_next;
+    obj->gc_next->gc_prev = obj->gc_prev;
+}
+
+static const std::vector<Value>& items_of(HeapObject* obj) {
+    return static_cast<ListObject*>(obj)->items;
+}
+
+static void update_threshold() {
+    size_t scaled = static_cast<size_t>(gc_stats.live_lists * gc_config.growth);
+    threshold = scaled > gc_config.min_threshold ? scaled : gc_config.min_threshold;
+}
+
+void heap::configure(const Config& config) {
+    gc_config = config;
+    update_threshold();
+}
+
+const heap::Config& heap::config() {
+    return gc_config;
+}
+
+const heap::Stats& heap::stats() {
+    return gc_stats;
+}
+
+size_t heap::collect() {
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<HeapObject*> objs;
+    objs.reserve(gc_stats.live_lists);
+    for (HeapObject* obj = lists_head.gc_next; obj != &lists_head; obj = obj->gc_next) {
+        obj->gc_refs = obj->refs;
+        objs.push_back(obj);
+    }
+
+    for (HeapObject* obj : objs) {
+        for (const Value& item : items_of(obj)) {
+            if (item.is_list()) item.object()->gc_refs--;
+        }
+    }
+
+    // without a candidate every list has an outside reference, skip marking
+    bool candidates = false;
+    for (HeapObject* obj : objs) candidates = candidates || obj->gc_refs == 0;
+
+    std::vector<HeapObject*> worklist;
+    for (HeapObject* obj : objs) {
+        if (!candidates) break;
+        if (obj->gc_refs > 0) {
+            obj->gc_refs = REACHABLE;
+            worklist.push_back(obj);
+        }
+    }
+    while (!worklist.empty()) {
+        HeapObject* obj = worklist.back();
+        worklist.pop_back();
+        for (const Value& item : items_of(obj)) {
+            if (!item.is_list() || item.object()->gc_refs == REACHABLE) continue;
+            item.object()->gc_refs = REACHABLE;
+            worklist.push_back(item.object());
+        }
+    }
+
+    std::vector<HeapObject*> garbage;
+    for (HeapObject* obj : objs) {
+        if (candidates && obj->gc_refs != REACHABLE) garbage.push_back(obj);
+    }
+
+    // pin the garbage so dropping the references between them never frees
+    // one half way through, then every count is back to the pin
+    for (HeapObject* obj : garbage) obj->refs++;
+    for (HeapObject* obj : garbage) static_cast<ListObject*>(obj)->items.clear();
+    for (HeapObject* obj : garbage) {
+        untrack_list(obj);
+        delete static_cast<ListObject*>(obj);
+    }
+
+    double pause = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    gc_stats.last_pause_ns = pause;
+    gc_stats.total_pause_ns += pause;
+    if (pause > gc_stats.max_pause_ns) gc_stats.max_pause_ns = pause;
+
+    gc_stats.collections++;
+    gc_stats.freed_lists += garbage.size();
+    allocations = 0;
+    update_threshold();
+    return garbage.size();
+}
+
+size_t heap::heap_bytes() {
+    size_t bytes = 0;
+    for (HeapObject* obj = strings_head.gc_next; obj != &strings_head; obj = obj->gc_next) {
+        const StringObject* str = static_cast<StringObject*>(obj);
+        bytes += sizeof(StringObject) + str->str.capacity();
+        if (str->buf) bytes += str->buf->data.capacity() / str->buf->refs; // shared buffers split between their strings
+    }
+    for (HeapObject* obj = lists_head.gc_next; obj != &lists_head; obj = obj->gc_next) {
+        bytes += sizeof(ListObject) + items_of(obj).capacity() * sizeof(Value);
+    }
+    return bytes;
+}
+
+void heap::track_string(HeapObject* obj) {
+    link(strings_head, obj);
+    gc_stats.live_strings++;
+}
+
+void heap::track_list(HeapObject* obj) {
+    // obj is not linked yet, so the collection sees its items as referenced
+    // from outside
+    if (gc_config.enabled && ++allocations >= threshold) collect();
+    link(lists_head, obj);
+    gc_stats.live_lists++;
+}
+
+void heap::untrack_string(HeapObject* obj) {
+    unlink(obj);
+    gc_stats.live_strings--;
+}
+
+void heap::untrack_list(HeapObject* obj) {
+    unlink(obj);
+    gc_stats.live_lists--;
+}
@@ -1,5 +1,7 @@
 #include "interpreter.hpp"
+#include "bytecode.hpp"
 #include "builtins.hpp"
+#include "value_ops.hpp"
 
 #include <unistd.h>
 
@@ -8,20 +10,46 @@ const int V0_REG = -2; // return reg id
 const int T0_REG = -3; // Temp0 reg id 
 
 const Value TRUE_VAL = Value(true);
+const uint8_t MAX_DEOPTS = 2;
 
 Interpreter::Interpreter(IRGenerator& gen): 
-    _instr(gen._instr), 
+    _gen(gen),
+    _code(gen._code), 
     _ident_table(gen._ident_table),
     _const_table(gen._const_table), 
-    _func_table(gen._func_table) 
+    _func_table(gen._func_table),
+    _capture_table(gen._capture_table),
+    dispatch_mode(threaded_dispatch_supported() ? DispatchMode::Threaded : DispatchMode::Switch),
+    jit(gen),
+    jit_enabled(Jit::supported()),
+    traces(gen),
+    tracing(TraceJit::supported())
 {
-    program_stack.push(RvStackFrame{{}, {}, 0});
+    program_stack.push(RvStackFrame{{}, {}, 0, std::vector<int>(gen._int_reg_count)});
     current_frame = &program_stack.top();
 }
 
-void Interpreter::push_stack_frame() {
-    RvStackFrame frame_copy = *current_frame; // make a copy of the topmost frame
-    program_stack.push(frame_copy);
+void Interpreter::push_stack_frame(int captures, bool registers) {
+    if (captures < 0) {
+        RvStackFrame frame_copy = *current_frame; // make a copy of the topmost frame
+        program_stack.push(frame_copy);
+    } else {
+        // only the variables the call can read, the names are sorted so each
+        // one goes in at the end of the new map. Plain codegen evaluates the
+        // args into fresh registers, so the caller's are only copied for the
+        // SSA tier
+        RvStackFrame frame{{}, {}, 0, std::vector<int>(current_frame->int_regs.size())};
+        if (registers) {
+            frame.register_file = current_frame->register_file;
+            frame.int_regs = current_frame->int_regs;
+        }
+        const Environment& env = current_frame->env;
+        for (const std::string& name : _capture_table[captures]) {
+            auto it = env.find(name);
+            if (it != env.end()) frame.env.emplace_hint(frame.env.end(), name, it->second);
+        }
+        program_stack.push(std::move(frame));
+    }
     current_frame = &program_stack.top(); // set current frame to the top of the stack (this new frame)
 }
 
@@ -30,134 +58,515 @@ void Interpreter::pop_stack_frame() {
     current_frame = &program_stack.top();
 }
 
+// On the callee's frame, its params bound. True with the cached value in v0,
+// otherwise the call runs and memo_return stores what it returns
+bool Interpreter::memo_call(int fid) {
+    MemoCache::Key key;
+    key.fid = fid;
+    const Environment& env = current_frame->env;
+    for (const std::string& param : _func_table[fid].func_exp->get_arg_names()) {
+        auto it = env.find(param);
+        if (it == env.end() || !key.add(it->second)) {
+            memo.uncached();
+            return false;
+        }
+    }
+    if (memo.lookup(key, v0)) return true;
+    memo_pending.push_back({program_stack.size(), key});
+    return false;
+}
+
+// before the callee's frame is popped
+void Interpreter::memo_return() {
+    if (memo_pending.empty() || memo_pending.back().depth != program_stack.size()) return;
+    memo.store(memo_pending.back().key, v0);
+    memo_pending.pop_back();
+}
+
+#if defined(__GNUC__)
+#define RV_COMPUTED_GOTO 1
+#endif
+
+bool Interpreter::threaded_dispatch_supported() {
+#ifdef RV_COMPUTED_GOTO
+    return true;
+#else
+    return false;
+#endif
+}
+
+void Interpreter::set_dispatch_mode(DispatchMode mode) {
+    dispatch_mode = threaded_dispatch_supported() ? mode : DispatchMode::Switch;
+}
+
 void Interpreter::execute() {
+    dispatched = 0;
+    try {
+        run_loop();
+    } catch (...) {
+        output->flush(); // what was printed before the error
+        throw;
+    }
+    output->flush();
+}
+
+Value Interpreter::call(int fid, Environment env) {
+    if (jit_enabled && jit.call(fid, env, v0, program_stack.size() + 1)) return v0;
+
+    program_stack.push(RvStackFrame{{}, std::move(env), 0, std::vector<int>(current_frame->int_regs.size())});
+    current_frame = &program_stack.top();
+    pc = _func_table[fid].start_addr;
+    run_loop();
+    return v0;
+}
+
+// the profiled loops are separate instantiations, so the plain ones do not
+// test for it on every dispatch
+void Interpreter::run_loop() {
+    bool threaded = dispatch_mode == DispatchMode::Threaded;
+    if (profiling) {
+        if (threaded) run<true, true>();
+        else run<false, true>();
+    } else {
+        if (threaded) run<true, false>();
+        else run<false, false>();
+    }
+}
+
+void Interpreter::print_profile() const {
+    profile.report(_gen, memoizing ? &memo.stats() : nullptr);
+}
+
+// Handlers are written once and shared by both loops. TARGET gives each one a
+// case label for the switch and a plain label for the threaded table,
+// DISPATCH moves on to the instruction at pc. A computed goto out of a block
+// skips its destructors, so handlers with locals dispatch after the block.
+#ifdef RV_COMPUTED_GOTO
+#define TARGET(name) case name: L_##name
+#else
+#define TARGET(name) case name
+#endif
+#define REG(i) (*regs)[i]
+#define IREG(i) iregs[i]
+#define DECODE()                                        \
+    w = code[pc];                                       \
+    op = bytecode::op(w);                               \
+    a1 = bytecode::a(w);                                \
+    a2 = bytecode::b(w);                                \
+    a3 = bytecode::c(w);                                \
+    if constexpr (Profiled) {                           \
+        steps++;                                        \
+        profile.step(pc, op);                           \
+    }
+
+#ifdef RV_COMPUTED_GOTO
+#define DISPATCH()                                      \
+    if constexpr (Threaded) {                           \
+        DECODE();                                       \
+        goto *handlers[pc];                             \
+    }                                                   \
+    continue;
+#else
+#define DISPATCH() continue;
+#endif
+
+// frames live in a std::stack, so the cached pointers are refreshed whenever
+// a frame is pushed or popped
+#define RELOAD_FRAME()                                  \
+    regs = &current_frame->register_file;               \
+    iregs = current_frame->int_regs.data();             \
+    env = &current_frame->env;
+
+// R[A] = R[B] op R[C], computed on the raw ints (or bools) and written over
+// R[A] in place when both operands have that type, through the operator
+// matrix otherwise
+#define BINARY(is_type, as_type, op, binop)             \
+    {                                                   \
+        const Value& x = REG(a2);                       \
+        const Value& y = REG(a3);                       \
+        Value& dst = REG(a1);                           \
+        if (x.is_type() && y.is_type()) dst = x.as_type() op y.as_type(); \
+        else dst = value_ops::binary(value_ops::BinOp::binop, x, y); \
+    }
+#define INT_BINARY(op, binop) BINARY(is_int, as_int, op, binop)
+// / and %, which check the divisor
+#define INT_DIVIDE(fn, binop)                           \
+    {                                                   \
+        const Value& x = REG(a2);                       \
+        const Value& y = REG(a3);                       \
+        Value& dst = REG(a1);                           \
+        if (x.is_int() && y.is_int()) dst = value_ops::fn(x.as_int(), y.as_int()); \
+        else dst = value_ops::binary(value_ops::BinOp::binop, x, y); \
+    }
+
+// a function compiled at run time (its COMPILE_FUNC stub, or the JIT
+// reaching it from a hot caller) is appended to the code, which can move it
+#ifdef RV_COMPUTED_GOTO
+#define GROW_HANDLERS()                                 \
+    if constexpr (Threaded) {                           \
+        size_t known = handlers.size();                 \
+        handlers.resize(code_size);                     \
+        for (size_t i = known; i < code_size; i++) handlers[i] = labels[bytecode::op(_code[i])]; \
+    }
+#else
+#define GROW_HANDLERS()
+#endif
+#define RELOAD_CODE()                                   \
+    if (_code.size() != code_size) {                    \
+        code = _code.data();                            \
+        code_size = _code.size();                       \
+        if (quickening) deopts.resize(code_size);       \
+        GROW_HANDLERS();                                \
+    }
+
+// Quickening: a generic binary op whose operands are both ints (or both
+// strings for +) rewrites its own word to the specialised opcode before
+// running. The specialised handler only guards the operand types, and when
+// the guess is wrong rewrites the word back and reruns it as the generic op.
+// A word that keeps failing its guard (a polymorphic site) stays generic.
+#ifdef RV_COMPUTED_GOTO
+#define REWRITE(new_op)                                 \
+    do {                                                \
+        code[pc] = bytecode::with_op(code[pc], new_op); \
+        if constexpr (Threaded) handlers[pc] = labels[new_op]; \
+    } while (0)
+#define REDISPATCH(generic)                             \
+    if constexpr (Threaded) goto *handlers[pc];         \
+    op = generic;                                       \
+    goto reswitch;
+#else
+#define REWRITE(new_op) code[pc] = bytecode::with_op(code[pc], new_op)
+#define REDISPATCH(generic)                             \
+    op = generic;                                       \
+    goto reswitch;
+#endif
+#define QUICKEN_IF(is_type, quick)                      \
+    if (quickening && deopts[pc] < MAX_DEOPTS && REG(a2).is_type() && REG(a3).is_type()) REWRITE(quick);
+#define GUARDED_BINARY(is_type, result, generic)        \
+    {                                                   \
+        const Value& x = REG(a2);                       \
+        const Value& y = REG(a3);                       \
+        if (!x.is_type() || !y.is_type()) {             \
+            deopts[pc]++;                               \
+            REWRITE(generic);                           \
+            REDISPATCH(generic);                        \
+        }                                               \
+        REG(a1) = result;                               \
+    }
+#define INT_INT(op, generic) GUARDED_BINARY(is_int, x.as_int() op y.as_int(), generic)
+
+#ifdef RV_COMPUTED_GOTO
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+#pragma GCC diagnostic ignored "-Wunused-label" // the switch instantiation never takes their address
+#endif
+
+template <bool Threaded, bool Profiled>
+void Interpreter::run() {
+    Bytecode* code = _code.data(); // written by quickening
+    size_t code_size = _code.size();
+    const std::vector<builtin::NativeFunction>& natives = builtin::natives();
+    std::map<int, Value>* regs;
+    int* iregs;
+    Environment* env;
+    RELOAD_FRAME();
+
+    Bytecode w;
+    OPCode op;
+    int a1, a2, a3;
+    uint64_t steps = 0;
+    std::vector<uint8_t> deopts(quickening ? _code.size() : 0); // guard failures per word
+
+#ifdef RV_COMPUTED_GOTO
+    // resolve every word's handler once up front, so dispatch is a single
+    // indirect jump with no opcode decode or bounds check
+    std::vector<const void*> handlers;
+    const void* labels[NUM_OPCODES];
+    if constexpr (Threaded) {
+        for (int i = 0; i < NUM_OPCODES; i++) labels[i] = &&L_NOP;
+        labels[END] = &&L_END;
+        labels[NOP] = &&L_NOP;
+        labels[ADD_OP] = &&L_ADD_OP;
+        labels[SUB_OP] = &&L_SUB_OP;
+        labels[MUL_OP] = &&L_MUL_OP;
+        labels[DIV_OP] = &&L_DIV_OP;
+        labels[MOD_OP] = &&L_MOD_OP;
+        labels[POW_OP] = &&L_POW_OP;
+        labels[GT_OP] = &&L_GT_OP;
+        labels[GTE_OP] = &&L_GTE_OP;
+        labels[LT_OP] = &&L_LT_OP;
+        labels[LTE_OP] = &&L_LTE_OP;
+        labels[EQ_OP] = &&L_EQ_OP;
+        labels[NEQ_OP] = &&L_NEQ_OP;
+        labels[AND_OP] = &&L_AND_OP;
+        labels[OR_OP] = &&L_OR_OP;
+        labels[PRINT_OP] = &&L_PRINT_OP;
+        labels[NEG_OP] = &&L_NEG_OP;
+        labels[NOT_OP] = &&L_NOT_OP;
+        labels[SIZE_OP] = &&L_SIZE_OP;
+        labels[LOAD_CONST_OP] = &&L_LOAD_CONST_OP;
+        labels[STORE_VAR_OP] = &&L_STORE_VAR_OP;
+        labels[LOAD_VAR_OP] = &&L_LOAD_VAR_OP;
+        labels[INIT_LIST] = &&L_INIT_LIST;
+        labels[APPEND] = &&L_APPEND;
+        labels[ACCESS] = &&L_ACCESS;
+        labels[MODIFY] = &&L_MODIFY;
+        labels[STORE_INDEX] = &&L_STORE_INDEX;
+        labels[STORE_INDEX_PATH] = &&L_STORE_INDEX_PATH;
+        labels[APPEND_VAR] = &&L_APPEND_VAR;
+        labels[INSERT_VAR] = &&L_INSERT_VAR;
+        labels[REMOVE_VAR] = &&L_REMOVE_VAR;
+        labels[POP_VAR] = &&L_POP_VAR;
+        labels[CALL_NATIVE] = &&L_CALL_NATIVE;
+        labels[PUSH] = &&L_PUSH;
+        labels[MOVE_OP] = &&L_MOVE_OP;
+        labels[JUMP] = &&L_JUMP;
+        labels[JUMPF] = &&L_JUMPF;
+        labels[COMPILE_FUNC] = &&L_COMPILE_FUNC;
+        labels[JNT] = &&L_JNT;
+        labels[RET] = &&L_RET;
+        labels[WIDE] = &&L_WIDE;
+        labels[INT_LOAD_CONST] = &&L_INT_LOAD_CONST;
+        labels[INT_MOVE] = &&L_INT_MOVE;
+        labels[BOX_INT] = &&L_BOX_INT;
+        labels[BOX_BOOL] = &&L_BOX_BOOL;
+        labels[UNBOX] = &&L_UNBOX;
+        labels[INT_ADD] = &&L_INT_ADD;
+        labels[INT_SUB] = &&L_INT_SUB;
+        labels[INT_MUL] = &&L_INT_MUL;
+        labels[INT_DIV] = &&L_INT_DIV;
+        labels[INT_MOD] = &&L_INT_MOD;
+        labels[INT_LT] = &&L_INT_LT;
+        labels[INT_LTE] = &&L_INT_LTE;
+        labels[INT_GT] = &&L_INT_GT;
+        labels[INT_GTE] = &&L_INT_GTE;
+        labels[INT_EQ] = &&L_INT_EQ;
+        labels[INT_NEQ] = &&L_INT_NEQ;
+        labels[INT_AND] = &&L_INT_AND;
+        labels[INT_OR] = &&L_INT_OR;
+        labels[INT_NOT] = &&L_INT_NOT;
+        labels[INT_NEG] = &&L_INT_NEG;
+        labels[INT_JNT] = &&L_INT_JNT;
+        labels[ADD_INT_INT] = &&L_ADD_INT_INT;
+        labels[ADD_STR_STR] = &&L_ADD_STR_STR;
+        labels[SUB_INT_INT] = &&L_SUB_INT_INT;
+        labels[MUL_INT_INT] = &&L_MUL_INT_INT;
+        labels[DIV_INT_INT] = &&L_DIV_INT_INT;
+        labels[MOD_INT_INT] = &&L_MOD_INT_INT;
+        labels[LT_INT_INT] = &&L_LT_INT_INT;
+        labels[LTE_INT_INT] = &&L_LTE_INT_INT;
+        labels[GT_INT_INT] = &&L_GT_INT_INT;
+        labels[GTE_INT_INT] = &&L_GTE_INT_INT;
+        labels[EQ_INT_INT] = &&L_EQ_INT_INT;
+        labels[NEQ_INT_INT] = &&L_NEQ_INT_INT;
+
+        handlers.resize(_code.size());
+        for (size_t i = 0; i < _code.size(); i++) handlers[i] = labels[bytecode::op(_code[i])];
+    }
+#endif
 
     // Interpreter Loop - each iter is a virtual clock cycle
     while (true) {
-        Instruction curr_instr = _instr[pc];
-        // std::cout << "PC: " << pc << std::endl;
-        int a1 = curr_instr.arg1, a2 = curr_instr.arg2, a3 = curr_instr.arg3;
-        Environment& env = current_frame->env;
-        auto& register_file = current_frame->register_file;
-        int& frame_return_addr = current_frame->return_addr;
-
-        //     AND_OP,
-        //     OR_OP,
-        //     EQ_OP,
-        //     NEQ_OP,
-        //     LT_OP,
-        //     LTE_OP,
-        //     GT_OP,
-        //     GTE_OP,
-
-        //     NOT_OP,
-        //     PRINT_OP,
-        //     SIZE_OP,
-
-        //     POP,
-        // };
-
-        switch (curr_instr.op) {
-            case END: return; // terminate program
-            case NOP: pc += 1; break;
-
-            case ADD_OP: register_file[a1] = register_file[a2] + register_file[a3]; pc += 1; break;
-            case SUB_OP: register_file[a1] = register_file[a2] - register_file[a3]; pc += 1; break;
-            case MUL_OP: register_file[a1] = register_file[a2] * register_file[a3]; pc += 1; break;
-            case DIV_OP: register_file[a1] = register_file[a2] / register_file[a3]; pc += 1; break;
-            case MOD_OP: register_file[a1] = register_file[a2] % register_file[a3]; pc += 1; break;
-            case POW_OP: register_file[a1] = register_file[a2].pow(register_file[a3]); pc += 1; break;
-            case GT_OP: register_file[a1] = register_file[a2] > register_file[a3]; pc += 1; break;
-            case GTE_OP: register_file[a1] = register_file[a2] >= register_file[a3]; pc += 1; break;
-            case LT_OP: register_file[a1] = register_file[a2] < register_file[a3]; pc += 1; break;
-            case LTE_OP: register_file[a1] = register_file[a2] <= register_file[a3]; pc += 1; break;
-
-            case EQ_OP: register_file[a1] = register_file[a2] == register_file[a3]; pc += 1; break;
-            case NEQ_OP: register_file[a1] = register_file[a2] != register_file[a3]; pc += 1; break;
-            case AND_OP: register_file[a1] = register_file[a2] && register_file[a3]; pc += 1; break;
-            case OR_OP: register_file[a1] = register_file[a2] || register_file[a3]; pc += 1; break;
-
-            case PRINT_OP: std::cout << register_file[a1].to_string(false) << std::endl; pc += 1; break;
-            case NEG_OP: register_file[a1] = -register_file[a2]; pc += 1; break;
-            case NOT_OP: register_file[a1] = !register_file[a2]; pc += 1; break;
-            case SIZE_OP: register_file[a1] = register_file[a2].size(); pc += 1; break;
-
-            case LOAD_CONST_OP: register_file[a1] = _const_table[a2]; pc += 1; break;
-            case STORE_VAR_OP: env[_ident_table[a1]] = register_file[a2]; pc += 1; break;
-            case LOAD_VAR_OP: register_file[a1] = env[_ident_table[a2]]; pc += 1; break;
-            case INIT_LIST: register_file[a1] = Value(std::vector<Value>()); pc += 1; break;
-            case APPEND: register_file[a1].append_ref(register_file[a2]); pc += 1; break;
-            case ACCESS: {
-                Value list = register_file[a2]; 
-                register_file[a1] = list[register_file[a3]]; 
-                pc += 1; 
-                break;
+        DECODE();
+    reswitch:
+        switch (op) {
+            TARGET(END): // terminate program
+                dispatched = steps;
+                if constexpr (Profiled) profile.stop();
+                return;
+            TARGET(NOP): pc += 1; DISPATCH();
+
+            TARGET(ADD_OP):
+                QUICKEN_IF(is_int, ADD_INT_INT)
+                else QUICKEN_IF(is_string, ADD_STR_STR)
+                INT_BINARY(+, Add) pc += 1; DISPATCH();
+            TARGET(SUB_OP): QUICKEN_IF(is_int, SUB_INT_INT) INT_BINARY(-, Sub) pc += 1; DISPATCH();
+            TARGET(MUL_OP): QUICKEN_IF(is_int, MUL_INT_INT) INT_BINARY(*, Mul) pc += 1; DISPATCH();
+            TARGET(DIV_OP): QUICKEN_IF(is_int, DIV_INT_INT) INT_DIVIDE(int_div, Div) pc += 1; DISPATCH();
+            TARGET(MOD_OP): QUICKEN_IF(is_int, MOD_INT_INT) INT_DIVIDE(int_mod, Mod) pc += 1; DISPATCH();
+            TARGET(POW_OP): REG(a1) = value_ops::binary(value_ops::BinOp::Pow, REG(a2), REG(a3)); pc += 1; DISPATCH();
+            TARGET(GT_OP): QUICKEN_IF(is_int, GT_INT_INT) INT_BINARY(>, Gt) pc += 1; DISPATCH();
+            TARGET(GTE_OP): QUICKEN_IF(is_int, GTE_INT_INT) INT_BINARY(>=, Gte) pc += 1; DISPATCH();
+            TARGET(LT_OP): QUICKEN_IF(is_int, LT_INT_INT) INT_BINARY(<, Lt) pc += 1; DISPATCH();
+            TARGET(LTE_OP): QUICKEN_IF(is_int, LTE_INT_INT) INT_BINARY(<=, Lte) pc += 1; DISPATCH();
+
+            TARGET(EQ_OP): QUICKEN_IF(is_int, EQ_INT_INT) INT_BINARY(==, Eq) pc += 1; DISPATCH();
+            TARGET(NEQ_OP): QUICKEN_IF(is_int, NEQ_INT_INT) INT_BINARY(!=, Neq) pc += 1; DISPATCH();
+            TARGET(AND_OP): BINARY(is_bool, as_bool, &&, And) pc += 1; DISPATCH();
+            TARGET(OR_OP): BINARY(is_bool, as_bool, ||, Or) pc += 1; DISPATCH();
+
+            TARGET(PRINT_OP): output->write_line(REG(a1)); pc += 1; DISPATCH();
+            TARGET(NEG_OP): REG(a1) = -REG(a2); pc += 1; DISPATCH();
+            TARGET(NOT_OP): REG(a1) = !REG(a2); pc += 1; DISPATCH();
+            TARGET(SIZE_OP): REG(a1) = REG(a2).size(); pc += 1; DISPATCH();
+
+            TARGET(LOAD_CONST_OP): REG(a1) = _const_table[a2]; pc += 1; DISPATCH();
+            TARGET(STORE_VAR_OP): (*env)[_ident_table[a1]] = REG(a2); pc += 1; DISPATCH();
+            TARGET(LOAD_VAR_OP): REG(a1) = (*env)[_ident_table[a2]]; pc += 1; DISPATCH();
+            TARGET(INIT_LIST): REG(a1) = Value(std::vector<Value>()); pc += 1; DISPATCH();
+            TARGET(APPEND): REG(a1).append_ref(REG(a2)); pc += 1; DISPATCH();
+            TARGET(ACCESS): REG(a1) = REG(a2)[REG(a3)]; pc += 1; DISPATCH();
+            TARGET(MODIFY): t0 = REG(a1).modify_arr(REG(a2), REG(a3)); pc += 1; DISPATCH();
+            TARGET(STORE_INDEX): (*env)[_ident_table[a1]].store_index(REG(a2), REG(a3)); pc += 1; DISPATCH();
+            TARGET(APPEND_VAR): builtin::append_ref((*env)[_ident_table[a1]], REG(a2)); pc += 1; DISPATCH();
+            TARGET(INSERT_VAR): builtin::insert_ref((*env)[_ident_table[a1]], REG(a2), REG(a3)); pc += 1; DISPATCH();
+            TARGET(REMOVE_VAR): builtin::remove_ref((*env)[_ident_table[a1]], REG(a2)); pc += 1; DISPATCH();
+            TARGET(POP_VAR): builtin::pop_ref((*env)[_ident_table[a1]]); pc += 1; DISPATCH();
+            TARGET(CALL_NATIVE): {
+                const builtin::NativeFunction& native = natives[a2];
+                Value args[builtin::MAX_NATIVE_ARGS];
+                for (int i = 0; i < native.arity(); i++) args[i] = REG(a3 + i);
+                REG(a1) = native.fn(args);
             }
-            case MODIFY: {
-                Value list = register_file[a1];
-                t0 = list.modify_arr(register_file[a2], register_file[a3]);
-                pc += 1;
-                break;
+            pc += 1;
+            DISPATCH();
+            TARGET(STORE_INDEX_PATH): {
+                Value* slot = &(*env)[_ident_table[a1]];
+                for (int i = 0; i < a3 - 1; i++) slot = &slot->index_ref(REG(a2 + i));
+                slot->store_index(REG(a2 + a3 - 1), REG(a2 + a3));
             }
+            pc += 1;
+            DISPATCH();
 
-            case PUSH: push_stack_frame(); pc += 1; break; // push a copy of env onto the stack
-            case MOVE_OP: {
+            TARGET(PUSH): push_stack_frame(a1, a2 != 0); RELOAD_FRAME(); pc += 1; DISPATCH(); // push the call's frame onto the stack
+            TARGET(MOVE_OP): {
                 if (a1 == V0_REG) {
-                    v0 = register_file[a2];
+                    v0 = REG(a2);
                 } else if (a2 == V0_REG) {
-                    register_file[a1] = v0;
+                    REG(a1) = v0;
                 } else if (a1 == T0_REG) {
-                    t0 = register_file[a2];
+                    t0 = REG(a2);
                 } else if (a2 == T0_REG) {
-                    register_file[a1] = t0;
+                    REG(a1) = t0;
+                } else {
+                    REG(a1) = REG(a2);
                 }
-                pc += 1; 
-                break;
+                pc += 1;
+                DISPATCH();
             }
-            case JUMP: pc = a1; break;
-            case JUMPF: {
-                frame_return_addr = pc + 1; 
-                if (a1 < 0) { 
-                    handle_builtin_func(a1, a2, a3);
-                } else {
-                    pc = _func_table[a1].start_addr;
+            TARGET(JUMP): // target is packed into B
+                if (tracing && a2 <= pc) pc = traces.loop(pc, a2, *regs, current_frame->int_regs, *env); // a back-edge
+                else pc = a2;
+                DISPATCH();
+            TARGET(JUMPF):
+                if (memoizing && _func_table[a1].pure && memo_call(a1)) {
+                    pop_stack_frame();
+                    RELOAD_FRAME();
+                    pc += 1;
+                    DISPATCH();
+                }
+                if (jit_enabled) {
+                    bool ran = jit.call(a1, *env, v0, program_stack.size());
+                    RELOAD_CODE();
+                    if (ran) {
+                        // ran natively, return as RET would
+                        if (memoizing) memo_return();
+                        pop_stack_frame();
+                        RELOAD_FRAME();
+                        pc += 1;
+                        DISPATCH();
+                    }
                 }
-                break;
+                current_frame->return_addr = pc + 1;
+                pc = _func_table[a1].start_addr;
+                DISPATCH();
+            TARGET(COMPILE_FUNC): // first call, the table entry points at the body from now on
+                _gen.compile_function(a1);
+                RELOAD_CODE();
+                pc = _func_table[a1].start_addr;
+                DISPATCH();
+            TARGET(JNT): pc = (REG(a1).equals(TRUE_VAL)) ? pc + 1 : a2; DISPATCH();
+            TARGET(RET): if (memoizing) memo_return(); pc = current_frame->return_addr; pop_stack_frame(); RELOAD_FRAME(); DISPATCH();
+
+            TARGET(INT_LOAD_CONST): IREG(a1) = _const_table[a2].is_bool() ? _const_table[a2].as_bool() : _const_table[a2].as_int(); pc += 1; DISPATCH();
+            TARGET(INT_MOVE): IREG(a1) = IREG(a2); pc += 1; DISPATCH();
+            TARGET(BOX_INT): REG(a1) = IREG(a2); pc += 1; DISPATCH();
+            TARGET(BOX_BOOL): REG(a1) = IREG(a2) != 0; pc += 1; DISPATCH();
+            TARGET(UNBOX): IREG(a1) = REG(a2).is_bool() ? REG(a2).as_bool() : REG(a2).as_int(); pc += 1; DISPATCH();
+            TARGET(INT_ADD): IREG(a1) = IREG(a2) + IREG(a3); pc += 1; DISPATCH();
+            TARGET(INT_SUB): IREG(a1) = IREG(a2) - IREG(a3); pc += 1; DISPATCH();
+            TARGET(INT_MUL): IREG(a1) = IREG(a2) * IREG(a3); pc += 1; DISPATCH();
+            TARGET(INT_DIV): IREG(a1) = value_ops::int_div(IREG(a2), IREG(a3)); pc += 1; DISPATCH();
+            TARGET(INT_MOD): IREG(a1) = value_ops::int_mod(IREG(a2), IREG(a3)); pc += 1; DISPATCH();
+            TARGET(INT_LT): IREG(a1) = IREG(a2) < IREG(a3); pc += 1; DISPATCH();
+            TARGET(INT_LTE): IREG(a1) = IREG(a2) <= IREG(a3); pc += 1; DISPATCH();
+            TARGET(INT_GT): IREG(a1) = IREG(a2) > IREG(a3); pc += 1; DISPATCH();
+            TARGET(INT_GTE): IREG(a1) = IREG(a2) >= IREG(a3); pc += 1; DISPATCH();
+            TARGET(INT_EQ): IREG(a1) = IREG(a2) == IREG(a3); pc += 1; DISPATCH();
+            TARGET(INT_NEQ): IREG(a1) = IREG(a2) != IREG(a3); pc += 1; DISPATCH();
+            TARGET(INT_AND): IREG(a1) = IREG(a2) && IREG(a3); pc += 1; DISPATCH();
+            TARGET(INT_OR): IREG(a1) = IREG(a2) || IREG(a3); pc += 1; DISPATCH();
+            TARGET(INT_NOT): IREG(a1) = !IREG(a2); pc += 1; DISPATCH();
+            TARGET(INT_NEG): IREG(a1) = -1 * IREG(a2); pc += 1; DISPATCH();
+            TARGET(INT_JNT): pc = IREG(a1) ? pc + 1 : a2; DISPATCH();
+
+            TARGET(ADD_INT_INT): INT_INT(+, ADD_OP) pc += 1; DISPATCH();
+            TARGET(ADD_STR_STR): GUARDED_BINARY(is_string, x.concat(y), ADD_OP) pc += 1; DISPATCH();
+            TARGET(SUB_INT_INT): INT_INT(-, SUB_OP) pc += 1; DISPATCH();
+            TARGET(MUL_INT_INT): INT_INT(*, MUL_OP) pc += 1; DISPATCH();
+            TARGET(DIV_INT_INT): GUARDED_BINARY(is_int, value_ops::int_div(x.as_int(), y.as_int()), DIV_OP) pc += 1; DISPATCH();
+            TARGET(MOD_INT_INT): GUARDED_BINARY(is_int, value_ops::int_mod(x.as_int(), y.as_int()), MOD_OP) pc += 1; DISPATCH();
+            TARGET(LT_INT_INT): INT_INT(<, LT_OP) pc += 1; DISPATCH();
+            TARGET(LTE_INT_INT): INT_INT(<=, LTE_OP) pc += 1; DISPATCH();
+            TARGET(GT_INT_INT): INT_INT(>, GT_OP) pc += 1; DISPATCH();
+            TARGET(GTE_INT_INT): INT_INT(>=, GTE_OP) pc += 1; DISPATCH();
+            TARGET(EQ_INT_INT): INT_INT(==, EQ_OP) pc += 1; DISPATCH();
+            TARGET(NEQ_INT_INT): INT_INT(!=, NEQ_OP) pc += 1; DISPATCH();
+
+            TARGET(WIDE): {
+                // widen the operands, then run the prefixed word's handler,
+                // which steps past both words
+                Bytecode next = code[pc + 1];
+                a1 = bytecode::wide_a(w, next);
+                a2 = bytecode::wide_b(w, next);
+                a3 = bytecode::wide_c(w, next);
+                pc += 1;
+#ifdef RV_COMPUTED_GOTO
+                if constexpr (Threaded) goto *handlers[pc];
+#endif
+                op = bytecode::op(next);
+                goto reswitch;
             }
-            case JNT: pc = (register_file[a1].equals(TRUE_VAL)) ? pc + 1 : a2; break;
-            case RET: pc = frame_return_addr; pop_stack_frame(); break;
-            default: break;
-        };
-        // sleep(1);
+            default: pc += 1; DISPATCH();
+        }
     }
 }
 
-void Interpreter::handle_builtin_func(int a1, int a2, int a3) {
-    Environment& env = current_frame->env;
-    int& frame_return_addr = current_frame->return_addr;
-
-    std::string func_name = builtin::fid_to_builtin.at(a1);
-    // std::cout << func_name << " " << env["ele_val"].to_string() << "\n";
-    Value res;
-    if (func_name == "append") res = builtin::append(env["arr_val"], env["ele_val"]);
-    if (func_name == "remove") res = builtin::remove(env["arr_val"], env["idx_val"]);
-    if (func_name == "type") res = builtin::type(env["val"]);
-    if (func_name == "string") res = builtin::string(env["val"]);
-
-    v0 = res;
-    pc = frame_return_addr; 
-    pop_stack_frame();
-}
+#ifdef RV_COMPUTED_GOTO
+#pragma GCC diagnostic pop
+#endif
+
+#undef TARGET
+#undef REG
+#undef IREG
+#undef DECODE
+#undef DISPATCH
+#undef RELOAD_FRAME
+#undef GROW_HANDLERS
+#undef RELOAD_CODE
+#undef BINARY
+#undef INT_BINARY
+#undef REWRITE
+#undef REDISPATCH
+#undef QUICKEN_IF
+#undef GUARDED_BINARY
+#undef INT_INT
 
 void Interpreter::print_reg_file() const {
     for (const auto& pair : current_frame->register_file) {
-        std::cout << "R" << pair.first << ": " << pair.second.to_string(true) << "\n";
+        std::cout << "R" << pair.first << ": ";
+        pair.second.write_to(std::cout, true);
+        std::cout << "\n";
     }
-    std::cout << "v0: " << v0.to_string(true) << "\n";
+    std::cout << "v0: ";
+    v0.write_to(std::cout, true);
+    std::cout << "\n";
 }
 
 void Interpreter::print_env() const {
     for (const auto& pair : current_frame->env) {
-        std::cout << pair.first << ": " << pair.second.to_string(true) << "\n";
+        std::cout << pair.first << ": ";
+        pair.second.write_to(std::cout, true);
+        std::cout << "\n";
     }
 }
\ No newline at end of file
@@ -1,4 +1,5 @@
 #include "ir_generator.hpp"
+#include "bytecode.hpp"
 #include "builtins.hpp"
 #include "utils.hpp"
 
@@ -9,20 +10,86 @@
 const int T0_REG = -3; // Temp0 reg id 
 
 std::vector<Instruction>& IRGenerator::generate_ir_code(const std::vector<Expression*>& _exps) {
+    captures.resolve(_exps);
     for (auto exp : _exps) {
         generate_ir_block(exp);
     }
 
     _instr.push_back({ITYPE, END, -1, -1, -1});
 
-    // define functions;
+    for (int fid : define_functions()) addr_to_ident[_func_table[fid].start_addr] = _func_table[fid].name;
+    assemble();
+    return _instr;
+}
+
+// generates the queued functions, or a stub for each when lazy, and returns
+// their fids
+std::vector<int> IRGenerator::define_functions() {
+    std::vector<int> fids;
     while (!func_assign_queue.empty()) {
         int fid = func_assign_queue.front();
         func_assign_queue.pop();
+        fids.push_back(fid);
+
+        if (lazy) {
+            _func_table[fid].start_addr = _instr.size();
+            _func_table[fid].stub = true;
+            _instr.push_back({JTYPE, COMPILE_FUNC, fid, -1, -1});
+        } else {
+            gen_func_assign_exp_ir(_func_table[fid]);
+        }
+    }
+    return fids;
+}
+
+bool IRGenerator::compile_function(int fid) {
+    if (!_func_table[fid].stub) return false;
+
+    int stub_addr = _func_table[fid].start_addr;
+    size_t first = _instr.size();
+    try {
         gen_func_assign_exp_ir(_func_table[fid]);
+    } catch (...) {
+        // the function stays a stub and raises the error again on its next
+        // call, the functions it declared before the error keep theirs
+        _instr.resize(first);
+        in_function = false;
+        _func_table[fid].start_addr = stub_addr;
+        assemble_tail(first, define_functions());
+        throw;
     }
+    _func_table[fid].stub = false;
 
-    return _instr;
+    std::vector<int> fids = define_functions();
+    fids.push_back(fid);
+    assemble_tail(first, fids);
+    return true;
+}
+
+void IRGenerator::assemble() {
+    std::vector<int> addr_of;
+    _code = bytecode::assemble(_instr, addr_of);
+
+    // function entries move to word addresses
+    std::map<int, std::string> labels;
+    for (const auto& [addr, name] : addr_to_ident) labels[addr_of[addr]] = name;
+    addr_to_ident = labels;
+    for (FunctionInfo& func_info : _func_table) {
+        if (func_info.start_addr >= 0) func_info.start_addr = addr_of[func_info.start_addr];
+    }
+}
+
+// appends _instr[first...] to the code, fids are the functions whose entries
+// lie there
+void IRGenerator::assemble_tail(size_t first, const std::vector<int>& fids) {
+    std::vector<int> addr_of;
+    std::vector<Bytecode> tail = bytecode::assemble(_instr, addr_of, first, _code.size());
+    _code.insert(_code.end(), tail.begin(), tail.end());
+
+    for (int fid : fids) {
+        _func_table[fid].start_addr = addr_of[_func_table[fid].start_addr - first];
+        addr_to_ident[_func_table[fid].start_addr] = _func_table[fid].name;
+    }
 }
 
 int IRGenerator::generate_ir_block(Expression* exp) {
@@ -113,7 +180,7 @@ int IRGenerator::gen_const_exp_ir(ConstExp* const_exp) {
 int IRGenerator::gen_var_exp_ir(VarExp* var_exp) {
     std::string var_name = var_exp->get_var_name();
 
-    _instr.push_back({RTYPE, LOAD_VAR_OP, curr_reg, ident_to_idx[var_name], -1}); // curr_reg <- VAR
+    _instr.push_back({RTYPE, LOAD_VAR_OP, curr_reg, intern_ident(var_name), -1}); // curr_reg <- VAR
 
     if (var_exp->is_returnable()) {
         _instr.push_back({RTYPE, MOVE_OP, -2, curr_reg, -1});
@@ -124,6 +191,10 @@ int IRGenerator::gen_var_exp_ir(VarExp* var_exp) {
 }
 
 int IRGenerator::gen_let_exp_ir(AssignmentExpression* let_exp) {
+    if (let_exp->is_index_store()) return gen_store_index_ir(let_exp);
+    OPCode in_place_op = in_place_list_op(let_exp);
+    if (in_place_op != NOP) return gen_in_place_call_ir(let_exp, in_place_op);
+
     // std::cout << "building let" << std::endl ;
     int t1 = generate_ir_block(let_exp->get_right());
     std::string var_name = let_exp->get_id();
@@ -135,8 +206,7 @@ int IRGenerator::gen_let_exp_ir(AssignmentExpression* let_exp) {
         _ident_table.push_back(var_name);
         ident_to_idx[var_name] = ident_idx;
     } else {
-        if (ident_to_idx.find(var_name) == ident_to_idx.end()) throw std::runtime_error("Variable " + var_name + " has not been properly declared");
-        ident_idx = ident_to_idx[var_name];
+        ident_idx = declared_ident(var_name);
     }
 
     _instr.push_back({RTYPE, STORE_VAR_OP, ident_idx, t1, -1}); // Var name -> curr_reg
@@ -172,14 +242,15 @@ int IRGenerator::gen_mon_exp_ir(MonadicExpression* mon_exp) {
             return curr_reg;
         }
         case MonadicOperator::SizeOp: {
-            _instr.push_back({RTYPE, SIZE_OP, curr_reg, t1, -1}); // cur_reg = size(t1)
+            // overwrite the operand's temp, so a list loaded for size() is not kept alive
+            _instr.push_back({RTYPE, SIZE_OP, t1, t1, -1}); // t1 = size(t1)
 
             if (mon_exp->is_returnable()) {
-                _instr.push_back({RTYPE, MOVE_OP, -2, curr_reg, -1});
+                _instr.push_back({RTYPE, MOVE_OP, -2, t1, -1});
                 _instr.push_back({JTYPE, RET, -1, -1, -1});
             }
 
-            return curr_reg++;
+            return t1;
         }
     };
 
@@ -206,7 +277,7 @@ int IRGenerator::gen_if_exp_ir(IfExpression* if_exp) {
     int t1 = generate_ir_block(if_exp->get_conditional());
     int cond_jump_instr_idx = _instr.size();
     _instr.push_back({JTYPE, JNT, t1, -1, -1}); // if not t1, jumpt to arg2 (empty for now until exps)
-    int ti;
+    int ti = -1;
     for (Expression* exp : if_exp->get_if_exps()) {
         ti = generate_ir_block(exp);
     }
@@ -230,7 +301,7 @@ int IRGenerator::gen_while_exp_ir(WhileExpression* while_exp) {
     int t1 = generate_ir_block(while_exp->get_conditional());
     int jump_instr_idx = _instr.size();
     _instr.push_back({JTYPE, JNT, t1, -1, -1}); // if not t1, jumpt to arg2 (empty for now until exps)
-    int ti;
+    int ti = -1;
     for (Expression* exp : while_exp->get_body_exps()) {
         ti = generate_ir_block(exp);
     }
@@ -245,7 +316,7 @@ int IRGenerator::store_func_assign_exp(FunctionAssignmentExpression* func_exp) {
     // this just creates and stores meta data, the actual function will be declared at the end
     int fid = _func_table.size();
     ident_to_fid[func_exp->get_name()] = fid;
-    _func_table.push_back({func_exp->get_name(), -1, func_exp}); // function addr is resolved at the end
+    _func_table.push_back({func_exp->get_name(), -1, func_exp, false, captures.is_pure(func_exp->get_name())}); // function addr is resolved at the end
     func_assign_queue.push(fid);
     return curr_reg;
 }
@@ -253,11 +324,15 @@ int IRGenerator::store_func_assign_exp(FunctionAssignmentExpression* func_exp) {
 int IRGenerator::gen_func_assign_exp_ir(FunctionInfo& func_info) {
     FunctionAssignmentExpression* func_exp = func_info.func_exp;
     func_info.start_addr = _instr.size();
-    addr_to_ident[func_info.start_addr] = func_info.name;
 
+    // the body resolves names the same whenever it is generated, see intern_ident
+    bool was_in_function = in_function;
+    in_function = true;
+    for (const std::string& param : func_exp->get_arg_names()) intern_ident(param);
     for (Expression* exp : func_exp->get_body_exps()) {
         generate_ir_block(exp);
     }
+    in_function = was_in_function;
 
     _instr.push_back({JTYPE, RET, -1, -1, -1}); // This instruction is psuedo for POP eip (which puts the top stack value into PC) (acts as the return)
 
@@ -265,22 +340,17 @@ int IRGenerator::gen_func_assign_exp_ir(FunctionInfo& func_info) {
 }
 
 int IRGenerator::gen_func_call_exp_ir(FunctionCallExpression* call_exp) {
-    FunctionAssignmentExpression* func_exp;
-    int fid;
+    int nid = resolve_native(call_exp);
+    if (nid >= 0) return gen_native_call_ir(call_exp, nid);
+
+    int fid = ident_to_fid[call_exp->get_name()];
+    FunctionAssignmentExpression* func_exp = _func_table[fid].func_exp;
 
-    if (builtin::is_builtin_func(call_exp->get_name())) {
-        fid = builtin::builtin_to_fid.at(call_exp->get_name());
-        func_exp = builtin::builtin_func_exps[call_exp->get_name()];
-    } else {
-        fid = ident_to_fid[call_exp->get_name()];
-        func_exp = _func_table[fid].func_exp;
-    }
-    
 
     const std::vector<std::string> arg_names = func_exp->get_arg_names();
     const std::vector<Expression*> arg_exps = call_exp->get_arg_exps();
     
-    _instr.push_back({RTYPE, PUSH, -1, -1, -1}); // PUSH PC (-1) reg onto stack
+    _instr.push_back({RTYPE, PUSH, capture_id(call_exp), 0, -1}); // a frame with what the args and the callee read
     // load variables
     for (size_t i = 0; i < call_exp->get_args_length(); i++) {
         std::string argi = arg_names[i];
@@ -302,6 +372,31 @@ int IRGenerator::gen_func_call_exp_ir(FunctionCallExpression* call_exp) {
     
 }
 
+// natives run on the caller's frame, their args sit in consecutive registers
+int IRGenerator::gen_native_call_ir(FunctionCallExpression* call_exp, int nid) {
+    std::vector<int> arg_regs;
+    for (Expression* exp : call_exp->get_arg_exps()) arg_regs.push_back(generate_ir_block(exp));
+
+    bool consecutive = true;
+    for (size_t i = 0; i < arg_regs.size(); i++) consecutive = consecutive && arg_regs[i] == arg_regs[0] + static_cast<int>(i);
+
+    int base = consecutive && !arg_regs.empty() ? arg_regs[0] : curr_reg;
+    if (!consecutive) {
+        curr_reg += arg_regs.size();
+        for (size_t i = 0; i < arg_regs.size(); i++) {
+            _instr.push_back({RTYPE, MOVE_OP, base + static_cast<int>(i), arg_regs[i], -1});
+        }
+    }
+    _instr.push_back({RTYPE, CALL_NATIVE, curr_reg, nid, base});
+
+    if (call_exp->is_returnable()) {
+        _instr.push_back({RTYPE, MOVE_OP, -2, curr_reg, -1});
+        _instr.push_back({JTYPE, RET, -1, -1, -1});
+    }
+
+    return curr_reg++;
+}
+
 int IRGenerator::gen_list_exp_ir(ListExpression* list_exp) {
     // std::cout << "called list" << std::endl;
     int list_reg = curr_reg++;
@@ -323,14 +418,16 @@ int IRGenerator::gen_list_exp_ir(ListExpression* list_exp) {
 int IRGenerator::gen_list_access_exp_ir(ListAccessExpression* access_exp) {
     int t1 = generate_ir_block(access_exp->get_arr_exp());
     int t2 = generate_ir_block(access_exp->get_idx_exp());
-    _instr.push_back({RTYPE, ACCESS, curr_reg, t1, t2}); // curr = t1[t2]
+    // the element replaces the list in its temp, a list register left behind
+    // would share the list and force the next in place store to copy it
+    _instr.push_back({RTYPE, ACCESS, t1, t1, t2}); // t1 = t1[t2]
 
     if (access_exp->is_returnable()) {
-        _instr.push_back({RTYPE, MOVE_OP, -2, curr_reg, -1});
+        _instr.push_back({RTYPE, MOVE_OP, -2, t1, -1});
         _instr.push_back({JTYPE, RET, -1, -1, -1});
     }
 
-    return curr_reg++;
+    return t1;
 }
 
 int IRGenerator::gen_list_modify_exp_ir(ListModifyExpression* modify_exp) {
@@ -344,8 +441,161 @@ int IRGenerator::gen_list_modify_exp_ir(ListModifyExpression* modify_exp) {
     return curr_reg++;
 }
 
+// arr[i][j] = x stores into the variable's list in place instead of
+// rebuilding it with MODIFY and storing the copy back
+int IRGenerator::gen_store_index_ir(AssignmentExpression* let_exp) {
+    const std::string& var_name = let_exp->get_id();
+    int ident_idx = declared_ident(var_name);
+
+    std::vector<Expression*> idx_exps;
+    Expression* val_exp = dynamic_cast<ListModifyExpression*>(let_exp->get_right())->flatten(idx_exps);
+
+    std::vector<int> idx_regs;
+    for (Expression* exp : idx_exps) idx_regs.push_back(generate_ir_block(exp));
+    int val_reg = generate_ir_block(val_exp);
+
+    if (idx_regs.size() == 1) {
+        _instr.push_back({RTYPE, STORE_INDEX, ident_idx, idx_regs[0], val_reg});
+        return curr_reg;
+    }
+
+    // the path operands have to sit in consecutive registers
+    int base = curr_reg;
+    curr_reg += idx_regs.size() + 1;
+    for (size_t i = 0; i < idx_regs.size(); i++) {
+        _instr.push_back({RTYPE, MOVE_OP, base + static_cast<int>(i), idx_regs[i], -1});
+    }
+    _instr.push_back({RTYPE, MOVE_OP, base + static_cast<int>(idx_regs.size()), val_reg, -1});
+    _instr.push_back({RTYPE, STORE_INDEX_PATH, ident_idx, base, static_cast<int>(idx_regs.size())});
+    return curr_reg;
+}
+
+// x = append(x, e) mutates x's list in place instead of calling the builtin
+// on a copy of it and storing the result back
+int IRGenerator::gen_in_place_call_ir(AssignmentExpression* let_exp, OPCode op) {
+    const std::string& var_name = let_exp->get_id();
+    int ident_idx = declared_ident(var_name);
+
+    const std::vector<Expression*>& arg_exps = dynamic_cast<FunctionCallExpression*>(let_exp->get_right())->get_arg_exps();
+    int operands[2] = {-1, -1};
+    for (size_t i = 1; i < arg_exps.size(); i++) operands[i - 1] = generate_ir_block(arg_exps[i]);
+
+    _instr.push_back({RTYPE, op, ident_idx, operands[0], operands[1]});
+    return curr_reg;
+}
+
+OPCode IRGenerator::in_place_list_op(const AssignmentExpression* let_exp) {
+    if (!let_exp->is_reassign() || let_exp->get_right()->get_signature() != ExpressionType::FUNC_CALL_EXP) return NOP;
+    FunctionCallExpression* call_exp = dynamic_cast<FunctionCallExpression*>(let_exp->get_right());
+    if (call_exp->calls_user_function()) return NOP;
+    const std::vector<Expression*>& arg_exps = call_exp->get_arg_exps();
+    if (arg_exps.empty() || arg_exps[0]->get_signature() != ExpressionType::VAR_EXP) return NOP;
+    if (dynamic_cast<VarExp*>(arg_exps[0])->get_var_name() != let_exp->get_id()) return NOP;
+
+    static const std::map<std::string, std::pair<OPCode, size_t>> ops = {
+        {"append", {APPEND_VAR, 2}},
+        {"insert", {INSERT_VAR, 3}},
+        {"remove", {REMOVE_VAR, 2}},
+        {"pop", {POP_VAR, 1}},
+    };
+    auto it = ops.find(call_exp->get_name());
+    if (it == ops.end() || it->second.second != arg_exps.size()) return NOP;
+    return it->second.first;
+}
+
+int IRGenerator::capture_id(const FunctionCallExpression* call_exp) {
+    std::vector<std::string> names;
+    if (!captures.frame_of(call_exp, names)) return -1;
+    auto [it, added] = capture_ids.emplace(names, _capture_table.size());
+    if (added) _capture_table.push_back(names);
+    return it->second;
+}
+
+int IRGenerator::intern_ident(const std::string& name) {
+    auto it = ident_to_idx.find(name);
+    if (it != ident_to_idx.end()) return it->second;
+    declare_variable(name);
+    return ident_to_idx[name];
+}
+
+// a function body may assign a variable its callers declare, only the top
+// level knows every variable there is
+int IRGenerator::declared_ident(const std::string& name) {
+    if (!in_function && ident_to_idx.find(name) == ident_to_idx.end()) throw std::runtime_error("Variable " + name + " has not been properly declared");
+    return intern_ident(name);
+}
+
+void IRGenerator::declare_variable(const std::string& name) {
+    ident_to_idx[name] = _ident_table.size();
+    _ident_table.push_back(name);
+}
+
 // Helpers
 
+std::vector<Expression*> IRGenerator::sub_expressions(Expression* exp) {
+    switch (exp->get_signature()) {
+        case ExpressionType::MON_EXP:
+            return {dynamic_cast<MonadicExpression*>(exp)->get_right()};
+        case ExpressionType::BIN_EXP: {
+            BinaryExpression* bin_exp = dynamic_cast<BinaryExpression*>(exp);
+            return {bin_exp->get_left(), bin_exp->get_right()};
+        }
+        case ExpressionType::LET_EXP: {
+            AssignmentExpression* let_exp = dynamic_cast<AssignmentExpression*>(exp);
+            if (let_exp->is_index_store()) {
+                std::vector<Expression*> exps;
+                Expression* val_exp = dynamic_cast<ListModifyExpression*>(let_exp->get_right())->flatten(exps);
+                exps.push_back(val_exp);
+                return exps;
+            }
+            if (IRGenerator::in_place_list_op(let_exp) != NOP) {
+                const std::vector<Expression*>& args = dynamic_cast<FunctionCallExpression*>(let_exp->get_right())->get_arg_exps();
+                return std::vector<Expression*>(args.begin() + 1, args.end());
+            }
+            return {let_exp->get_right()};
+        }
+        case ExpressionType::IF_EXP: {
+            IfExpression* if_exp = dynamic_cast<IfExpression*>(exp);
+            std::vector<Expression*> exps = {if_exp->get_conditional()};
+            exps.insert(exps.end(), if_exp->get_if_exps().begin(), if_exp->get_if_exps().end());
+            exps.insert(exps.end(), if_exp->get_else_exps().begin(), if_exp->get_else_exps().end());
+            return exps;
+        }
+        case ExpressionType::WHILE_EXP: {
+            WhileExpression* while_exp = dynamic_cast<WhileExpression*>(exp);
+            std::vector<Expression*> exps = {while_exp->get_conditional()};
+            exps.insert(exps.end(), while_exp->get_body_exps().begin(), while_exp->get_body_exps().end());
+            return exps;
+        }
+        case ExpressionType::LIST_EXP:
+            return dynamic_cast<ListExpression*>(exp)->get_elements();
+        case ExpressionType::LIST_ACCESS_EXP: {
+            ListAccessExpression* access_exp = dynamic_cast<ListAccessExpression*>(exp);
+            return {access_exp->get_arr_exp(), access_exp->get_idx_exp()};
+        }
+        case ExpressionType::LIST_MODIFY_EXP: {
+            ListModifyExpression* modify_exp = dynamic_cast<ListModifyExpression*>(exp);
+            return {modify_exp->get_ident_exp(), modify_exp->get_idx_exp(), modify_exp->get_exp()};
+        }
+        case ExpressionType::FUNC_CALL_EXP:
+            return dynamic_cast<FunctionCallExpression*>(exp)->get_arg_exps();
+        default:
+            return {};
+    }
+}
+
+int IRGenerator::resolve_native(const FunctionCallExpression* call_exp) {
+    if (call_exp->calls_user_function()) return -1;
+    int nid = builtin::find_native(call_exp->get_name());
+    if (nid < 0) return -1;
+
+    const builtin::NativeFunction& native = builtin::natives()[nid];
+    if (static_cast<int>(call_exp->get_args_length()) != native.arity()) {
+        throw std::runtime_error("function call does not match " + native.signature());
+    }
+    return nid;
+}
+
 OPCode IRGenerator::map_binexp_to_opcode(BinaryOperator op) const {
     switch (op) {
         case BinaryOperator::IntPlusOp: return ADD_OP;
@@ -397,6 +647,13 @@ std::string to_string(OPCode op) {
         case APPEND: return "APPEND";
         case ACCESS: return "ACCESS";
         case MODIFY: return "MODIFY";
+        case STORE_INDEX: return "STORE_INDEX";
+        case STORE_INDEX_PATH: return "STORE_INDEX_PATH";
+        case APPEND_VAR: return "APPEND_VAR";
+        case INSERT_VAR: return "INSERT_VAR";
+        case REMOVE_VAR: return "REMOVE_VAR";
+        case POP_VAR: return "POP_VAR";
+        case CALL_NATIVE: return "CALL_NATIVE";
 
         case PRINT_OP: return "PRINT";
         case SIZE_OP: return "SIZE";
@@ -405,29 +662,70 @@ std::string to_string(OPCode op) {
 
         case JNT: return "JNT";
         case JUMP: return "JUMP";
-        case JUMPF: return "JUMP";
+        case JUMPF: return "JUMPF";
+        case COMPILE_FUNC: return "COMPILE_FUNC";
         case MOVE_OP: return "MOVE";
         case RET: return "RET";
         case PUSH: return "PUSH";
         case POP: return "POP";
 
+        case INT_LOAD_CONST: return "INT_LOAD_CONST";
+        case INT_MOVE: return "INT_MOVE";
+        case BOX_INT: return "BOX_INT";
+        case BOX_BOOL: return "BOX_BOOL";
+        case UNBOX: return "UNBOX";
+        case INT_ADD: return "INT_ADD";
+        case INT_SUB: return "INT_SUB";
+        case INT_MUL: return "INT_MUL";
+        case INT_DIV: return "INT_DIV";
+        case INT_MOD: return "INT_MOD";
+        case INT_LT: return "INT_LT";
+        case INT_LTE: return "INT_LTE";
+        case INT_GT: return "INT_GT";
+        case INT_GTE: return "INT_GTE";
+        case INT_EQ: return "INT_EQ";
+        case INT_NEQ: return "INT_NEQ";
+        case INT_AND: return "INT_AND";
+        case INT_OR: return "INT_OR";
+        case INT_NOT: return "INT_NOT";
+        case INT_NEG: return "INT_NEG";
+        case INT_JNT: return "INT_JNT";
+
+        case ADD_INT_INT: return "ADD_INT_INT";
+        case ADD_STR_STR: return "ADD_STR_STR";
+        case SUB_INT_INT: return "SUB_INT_INT";
+        case MUL_INT_INT: return "MUL_INT_INT";
+        case DIV_INT_INT: return "DIV_INT_INT";
+        case MOD_INT_INT: return "MOD_INT_INT";
+        case LT_INT_INT: return "LT_INT_INT";
+        case LTE_INT_INT: return "LTE_INT_INT";
+        case GT_INT_INT: return "GT_INT_INT";
+        case GTE_INT_INT: return "GTE_INT_INT";
+        case EQ_INT_INT: return "EQ_INT_INT";
+        case NEQ_INT_INT: return "NEQ_INT_INT";
+
         case NOP: return "NOP";
         case END: return "END";
+        case WIDE: return "WIDE";
         default: return "UNKOWN OP";
     };
 }
 
 void IRGenerator::print_instructions() const {
+    // disassembles the packed code, addresses are word addresses
     std::cout << "main" << "\n";
-    for (size_t i = 0; i < _instr.size(); i++) {
+    size_t len;
+    for (size_t i = 0; i < _code.size(); i += len) {
         if (addr_to_ident.find(i) != addr_to_ident.end()) std::cout << addr_to_ident.at(i) << "\n";
+        Instruction instr = bytecode::decode(_code, i, len);
         
         std::string indent;
         if (i < 10) indent = "    ";
         if (i >= 10 && i < 100) indent = "   ";
         if (i >= 100 && i < 1000) indent = "  ";
         std::cout << indent << i << "   ";
-        print_instruction(_instr[i]);
+        if (len > 1) std::cout << "WIDE ";
+        print_instruction(instr);
     }
 }
 
@@ -466,13 +764,26 @@ void IRGenerator::print_instruction(Instruction inst) const {
         case (GTE_OP): std::cout << "R" << inst.arg1 << " R" << inst.arg2 << " R" << inst.arg3; break;
         case (AND_OP): std::cout << "R" << inst.arg1 << " R" << inst.arg2 << " R" << inst.arg3; break;
         case (OR_OP): std::cout << "R" << inst.arg1 << " R" << inst.arg2 << " R" << inst.arg3; break;
+        case (ADD_INT_INT):
+        case (ADD_STR_STR):
+        case (SUB_INT_INT):
+        case (MUL_INT_INT):
+        case (DIV_INT_INT):
+        case (MOD_INT_INT):
+        case (LT_INT_INT):
+        case (LTE_INT_INT):
+        case (GT_INT_INT):
+        case (GTE_INT_INT):
+        case (EQ_INT_INT):
+        case (NEQ_INT_INT):
+            std::cout << "R" << inst.arg1 << " R" << inst.arg2 << " R" << inst.arg3; break;
         case (NOT_OP): std::cout << "R" << inst.arg1 << " R" << inst.arg2; break; 
 
         case (STORE_VAR_OP): {
             // std::cout << "DEBUG " << inst.arg1 << " " << _ident_table[inst.arg1] << "\n";
             std::cout << _ident_table[inst.arg1] << " R" << inst.arg2; break;
         }
-        case (LOAD_CONST_OP): std::cout << "R" << inst.arg1 << " " << _const_table[inst.arg2].to_string(true); break;
+        case (LOAD_CONST_OP): std::cout << "R" << inst.arg1 << " "; _const_table[inst.arg2].write_to(std::cout, true); break;
         case (LOAD_VAR_OP): {
             // std::cout << "DEBUG " << inst.arg2 << " " << _ident_table[inst.arg2] << "\n";
             std::cout << "R" << inst.arg1 << " " << _ident_table[inst.arg2]; break;
@@ -480,19 +791,54 @@ void IRGenerator::print_instruction(Instruction inst) const {
         case (INIT_LIST): std::cout << "R" << inst.arg1; break;
         case (APPEND): std::cout << "R" << inst.arg1 << " " << "R" << inst.arg2; break;
         case (ACCESS): std::cout << "R" << inst.arg1 << " R" << inst.arg2 << " R" << inst.arg3; break;
+        case (STORE_INDEX): std::cout << _ident_table[inst.arg1] << " R" << inst.arg2 << " R" << inst.arg3; break;
+        case (STORE_INDEX_PATH): std::cout << _ident_table[inst.arg1] << " R" << inst.arg2 << " " << inst.arg3; break;
+        case (APPEND_VAR): std::cout << _ident_table[inst.arg1] << " R" << inst.arg2; break;
+        case (INSERT_VAR): std::cout << _ident_table[inst.arg1] << " R" << inst.arg2 << " R" << inst.arg3; break;
+        case (REMOVE_VAR): std::cout << _ident_table[inst.arg1] << " R" << inst.arg2; break;
+        case (POP_VAR): std::cout << _ident_table[inst.arg1]; break;
+        case (CALL_NATIVE): std::cout << "R" << inst.arg1 << " " << builtin::natives()[inst.arg2].name << " R" << inst.arg3; break;
         
         case (PRINT_OP): std::cout << "R" << inst.arg1; break;
         case (SIZE_OP): std::cout << "R" << inst.arg1 << " R" << inst.arg2; break;
         case (NEG_OP): std::cout << "R" << inst.arg1 << " R" << inst.arg2; break;
         case (JNT): std::cout << "R" << inst.arg1 << " " << inst.arg2; break;
+        case (INT_JNT): std::cout << "I" << inst.arg1 << " " << inst.arg2; break;
+        case (INT_LOAD_CONST): std::cout << "I" << inst.arg1 << " "; _const_table[inst.arg2].write_to(std::cout, true); break;
+        case (INT_MOVE): case (INT_NOT): case (INT_NEG): std::cout << "I" << inst.arg1 << " I" << inst.arg2; break;
+        case (BOX_INT): case (BOX_BOOL): std::cout << "R" << inst.arg1 << " I" << inst.arg2; break;
+        case (UNBOX): std::cout << "I" << inst.arg1 << " R" << inst.arg2; break;
+        case (INT_ADD):
+        case (INT_SUB):
+        case (INT_MUL):
+        case (INT_DIV):
+        case (INT_MOD):
+        case (INT_LT):
+        case (INT_LTE):
+        case (INT_GT):
+        case (INT_GTE):
+        case (INT_EQ):
+        case (INT_NEQ):
+        case (INT_AND):
+        case (INT_OR):
+            std::cout << "I" << inst.arg1 << " I" << inst.arg2 << " I" << inst.arg3; break;
         case (JUMP): std::cout << inst.arg1; break;
-        case (JUMPF): {
-            std::string func_string = (inst.arg1 < 0) ? builtin::fid_to_builtin.at(inst.arg1) : _func_table[inst.arg1].name;
-            std::cout << func_string; 
+        case (JUMPF):
+        case (COMPILE_FUNC): {
+            std::cout << _func_table[inst.arg1].name;
             break;
         }
         case (MOVE_OP): std::cout << reg_string(inst.arg1) << " " << reg_string(inst.arg2); break;
-        case (PUSH): std::cout << reg_string(inst.arg1); break;
+        case (PUSH): {
+            if (inst.arg1 < 0) {
+                std::cout << "*";
+                break;
+            }
+            std::cout << "{";
+            for (size_t i = 0; i < _capture_table[inst.arg1].size(); i++) std::cout << (i ? ", " : "") << _capture_table[inst.arg1][i];
+            std::cout << "}";
+            break;
+        }
         case (POP): std::cout << reg_string(inst.arg1); break;
         case (RET): break;
         case (NOP): break;
@@ -0,0 +1,750 @@
+#include "jit.hpp"
+#include "bytecode.hpp"
+#include "x86.hpp"
+
+#include <cstddef>
+#include <cstring>
+#include <map>
+#include <set>
+
+#ifdef RV_JIT
+#include <sys/mman.h>
+#endif
+
+const int V0_REG = -2;
+const int T0_REG = -3;
+
+static const size_t CODE_BYTES = 4 << 20;
+static const size_t STACK_BYTES = 64 << 20;
+static const size_t STACK_MARGIN = 64 << 10; // left below the limit, more than any frame
+static const int MAX_FRAME = 32 << 10;
+static const int MAX_ROUNDS = 64; // of type inference over a group of functions
+
+// First page of the arena, the native code reaches it rip relative
+struct JitData {
+    uint8_t bailed;       // why a call left native code early, 0 if it did not
+    uint64_t stack_limit;
+};
+
+enum Bail : uint8_t { NO_BAIL = 0, STACK_BAIL = 1, DIVIDE_BAIL = 2 };
+
+using namespace x86;
+
+static const Reg ARG_REGS[Jit::MAX_PARAMS] = {EDI, ESI, EDX, ECX, R8D, R9D};
+
+namespace {
+
+struct Decoded {
+    Instruction instr;
+    int next; // address of the following word
+};
+
+// The reachable instructions of a function and its frame: one 8 byte slot
+// per register, int register and variable, v0, and the slots the call
+// sequences save their writes in
+struct Body {
+    std::vector<std::string> params;
+    std::map<int, Decoded> instrs;           // by address
+    std::map<int, int> push_of;              // JUMPF address -> its PUSH
+    std::map<int, int> call_before;          // address after a JUMPF -> the JUMPF
+    std::map<int, std::vector<int>> written; // PUSH address -> slots written before its JUMPF
+    std::map<int, int> save_base;            // PUSH address -> first save slot
+    std::set<int> returned_calls;            // JUMPFs whose result a RET can return as is
+    std::map<int, int> regs, iregs;
+    std::map<std::string, int> vars;
+    int v0 = -1;
+    int slots = 0;
+    std::vector<JitType> types; // per slot, of registers and variables
+};
+
+} // namespace
+
+// What each operand names: r register, i int register, v variable, k
+// constant, t jump target, f function, - nothing. The first one is written
+// unless the op branches. nullptr for ops without a template.
+static const char* shape_of(OPCode op) {
+    switch (op) {
+        case NOP: case PUSH: case RET: return "---";
+        case LOAD_CONST_OP: return "rk-";
+        case LOAD_VAR_OP: return "rv-";
+        case STORE_VAR_OP: return "vr-";
+        case MOVE_OP: case NOT_OP: case NEG_OP: return "rr-";
+        case ADD_OP: case SUB_OP: case MUL_OP: case DIV_OP: case MOD_OP: case POW_OP:
+        case GT_OP: case GTE_OP: case LT_OP: case LTE_OP: case EQ_OP: case NEQ_OP:
+        case AND_OP: case OR_OP: return "rrr";
+        case JNT: return "rt-";
+        case JUMP: return "t--";
+        case JUMPF: return "f--";
+        case INT_LOAD_CONST: return "ik-";
+        case INT_MOVE: case INT_NOT: case INT_NEG: return "ii-";
+        case BOX_INT: case BOX_BOOL: return "ri-";
+        case UNBOX: return "ir-";
+        case INT_ADD: case INT_SUB: case INT_MUL: case INT_DIV: case INT_MOD:
+        case INT_LT: case INT_LTE: case INT_GT: case INT_GTE: case INT_EQ: case INT_NEQ:
+        case INT_AND: case INT_OR: return "iii";
+        case INT_JNT: return "it-";
+        default: return nullptr;
+    }
+}
+
+static int var_slot(Body& body, const std::string& name) {
+    auto [it, added] = body.vars.try_emplace(name, body.slots);
+    if (added) body.slots++;
+    return it->second;
+}
+
+static int slot_of(Body& body, char kind, int operand, const std::vector<std::string>& idents) {
+    if (kind == 'v') return var_slot(body, idents[operand]);
+    std::map<int, int>& table = kind == 'r' ? body.regs : body.iregs;
+    auto [it, added] = table.try_emplace(operand, body.slots);
+    if (added) body.slots++;
+    return it->second;
+}
+
+// slots an instruction reads and writes, v0 aside
+static void operands(Body& body, const Instruction& instr, const std::vector<std::string>& idents,
+                     std::vector<int>& reads, std::vector<int>& writes) {
+    reads.clear();
+    writes.clear();
+    if (instr.op == MOVE_OP) {
+        if (instr.arg1 != V0_REG) writes.push_back(slot_of(body, 'r', instr.arg1, idents));
+        if (instr.arg2 != V0_REG) reads.push_back(slot_of(body, 'r', instr.arg2, idents));
+        return;
+    }
+    const char* shape = shape_of(instr.op);
+    int args[3] = {instr.arg1, instr.arg2, instr.arg3};
+    for (int i = 0; i < 3; i++) {
+        if (shape[i] != 'r' && shape[i] != 'i' && shape[i] != 'v') continue;
+        int slot = slot_of(body, shape[i], args[i], idents);
+        bool branch = instr.op == JNT || instr.op == INT_JNT;
+        if (i == 0 && !branch) writes.push_back(slot);
+        else reads.push_back(slot);
+    }
+}
+
+static JitType join(JitType a, JitType b) {
+    if (a == JitType::None) return b;
+    if (b == JitType::None || a == b) return a;
+    return JitType::Conflict;
+}
+
+static JitType type_of(const Value& val) {
+    if (val.is_int()) return JitType::Int;
+    if (val.is_bool()) return JitType::Bool;
+    return JitType::Conflict;
+}
+
+// Decodes what is reachable from the function's entry and lays out its
+// frame. Fails on ops without a template and on call sequences (PUSH, the
+// argument stores, JUMPF) that branch.
+static bool build_body(const std::vector<Bytecode>& code, const std::vector<std::string>& idents,
+                       const FunctionInfo& info, const std::vector<JitFunction>& functions, Body& body) {
+    if (info.start_addr < 0 || !info.func_exp) return false;
+    body.params = info.func_exp->get_arg_names();
+    if (static_cast<int>(body.params.size()) > Jit::MAX_PARAMS) return false;
+
+    std::vector<int> work = {info.start_addr};
+    while (!work.empty()) {
+        int addr = work.back();
+        work.pop_back();
+        if (body.instrs.count(addr)) continue;
+        if (addr < 0 || addr >= static_cast<int>(code.size())) return false;
+
+        size_t len;
+        Instruction instr = bytecode::decode(code, addr, len);
+        instr.op = bytecode::generic(instr.op);
+        if (!shape_of(instr.op)) return false;
+        if (instr.op == MOVE_OP && (instr.arg1 == T0_REG || instr.arg2 == T0_REG)) return false;
+        if (instr.op == MOVE_OP && instr.arg1 == V0_REG && instr.arg2 == V0_REG) return false;
+        int next = addr + static_cast<int>(len);
+        body.instrs[addr] = {instr, next};
+
+        if (instr.op == JUMP) work.push_back(instr.arg1);
+        else if (instr.op == JNT || instr.op == INT_JNT) work.insert(work.end(), {next, instr.arg2});
+        else if (instr.op != RET) work.push_back(next);
+    }
+
+    if (body.instrs.begin()->first != info.start_addr) return false; // entered at the top
+
+    for (const std::string& param : body.params) var_slot(body, param);
+    std::vector<int> reads, writes;
+    for (auto& [addr, d] : body.instrs) operands(body, d.instr, idents, reads, writes);
+    body.v0 = body.slots++;
+
+    for (auto& [addr, d] : body.instrs) {
+        if (d.instr.op == JUMPF) {
+            if (d.instr.arg1 < 0 || d.instr.arg1 >= static_cast<int>(functions.size())) return false;
+            for (const std::string& param : functions[d.instr.arg1].params) {
+                if (!body.vars.count(param)) return false; // the callee would read the caller's variable
+            }
+        }
+        if (d.instr.op != PUSH) continue;
+        std::vector<int>& written = body.written[addr];
+        int depth = 0;
+        for (int at = addr;; at = body.instrs.at(at).next) {
+            const Instruction& instr = body.instrs.at(at).instr;
+            if (instr.op == JUMP || instr.op == JNT || instr.op == INT_JNT || instr.op == RET) return false;
+            if (instr.op == PUSH) depth++;
+            if (instr.op == JUMPF && --depth == 0) {
+                body.push_of[at] = addr;
+                body.call_before[body.instrs.at(at).next] = at;
+                break;
+            }
+            operands(body, instr, idents, reads, writes);
+            for (int slot : writes) {
+                bool seen = false;
+                for (int w : written) seen = seen || w == slot;
+                if (!seen) written.push_back(slot);
+            }
+        }
+        body.save_base[addr] = body.slots;
+        body.slots += written.size();
+    }
+    for (auto& [addr, d] : body.instrs) {
+        if (d.instr.op == JUMPF && !body.push_of.count(addr)) return false;
+        bool reads_v0 = d.instr.op == MOVE_OP && d.instr.arg2 == V0_REG;
+        if (reads_v0 && !body.call_before.count(addr)) return false;
+    }
+    return body.slots * 8 <= MAX_FRAME;
+}
+
+// Every slot has to be written before it is read on every path, the
+// parameters are written on entry. A call puts the frame back the way its
+// PUSH found it, and a RET needs v0 set, by the function or by a call
+// (return f(x) leaves the callee's result in v0).
+static bool check_assigned(Body& body, const std::vector<std::string>& idents, const std::vector<JitFunction>& functions) {
+    struct State {
+        bool reached = false;
+        std::vector<bool> set;
+        bool v0 = false;
+        std::set<int> v0_from; // the JUMPFs (or -1, the function) that may have set it
+    };
+    std::map<int, State> in;
+    State& entry = in[body.instrs.begin()->first];
+    entry.reached = true;
+    entry.set.assign(body.slots, false);
+    for (const std::string& param : body.params) entry.set[body.vars.at(param)] = true;
+
+    auto merge = [](State& into, const State& from) {
+        if (!into.reached) {
+            into = from;
+            return true;
+        }
+        bool changed = false;
+        for (size_t i = 0; i < into.set.size(); i++) {
+            if (into.set[i] && !from.set[i]) into.set[i] = false, changed = true;
+        }
+        if (into.v0 && !from.v0) into.v0 = false, changed = true;
+        for (int source : from.v0_from) changed = into.v0_from.insert(source).second || changed;
+        return changed;
+    };
+
+    std::vector<int> reads, writes;
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (auto& [addr, d] : body.instrs) {
+            if (!in[addr].reached) continue;
+            State out = in[addr];
+            if (d.instr.op == JUMPF) {
+                out = in[body.push_of.at(addr)];
+                out.v0 = true;
+                out.v0_from = {addr};
+            } else {
+                operands(body, d.instr, idents, reads, writes);
+                for (int slot : writes) out.set[slot] = true;
+                if (d.instr.op == MOVE_OP && d.instr.arg1 == V0_REG) {
+                    out.v0 = true;
+                    out.v0_from = {-1};
+                }
+            }
+            if (d.instr.op == RET) continue;
+            int target = d.instr.op == JUMP ? d.instr.arg1 : d.next;
+            changed = merge(in[target], out) || changed;
+            if (d.instr.op == JNT || d.instr.op == INT_JNT) changed = merge(in[d.instr.arg2], out) || changed;
+        }
+    }
+
+    for (auto& [addr, d] : body.instrs) {
+        const State& state = in[addr];
+        operands(body, d.instr, idents, reads, writes);
+        for (int slot : reads) {
+            if (!state.set[slot]) return false;
+        }
+        if (d.instr.op == JUMPF) {
+            for (const std::string& param : functions[d.instr.arg1].params) {
+                if (!state.set[body.vars.at(param)]) return false;
+            }
+        }
+        if (d.instr.op == RET && !state.v0) return false;
+        if (d.instr.op == RET) {
+            for (int source : state.v0_from) {
+                if (source >= 0) body.returned_calls.insert(source);
+            }
+        }
+    }
+    return true;
+}
+
+// Flow insensitive: a slot has one type wherever it is written. ret is the
+// join of what the function moves into v0 and of the calls it returns the
+// result of, rets has the callees'.
+static bool infer_types(Body& body, const std::vector<std::string>& idents, const std::vector<Value>& consts,
+                        const std::vector<JitType>& param_types, std::map<int, JitType>& rets, JitType& ret) {
+    body.types.assign(body.slots, JitType::None);
+    for (size_t i = 0; i < body.params.size(); i++) body.types[body.vars.at(body.params[i])] = param_types[i];
+    ret = JitType::None;
+
+    std::vector<int> reads, writes;
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (int call : body.returned_calls) {
+            JitType joined = join(ret, rets[body.instrs.at(call).instr.arg1]);
+            changed = changed || joined != ret;
+            ret = joined;
+        }
+        for (auto& [addr, d] : body.instrs) {
+            const Instruction& instr = d.instr;
+            operands(body, instr, idents, reads, writes);
+            JitType t = JitType::None;
+            switch (instr.op) {
+                case LOAD_CONST_OP:
+                    t = type_of(consts[instr.arg2]);
+                    break;
+                case LOAD_VAR_OP: case STORE_VAR_OP: case MOVE_OP:
+                    if (instr.op == MOVE_OP && instr.arg1 == V0_REG) {
+                        JitType joined = join(ret, body.types[reads[0]]);
+                        changed = changed || joined != ret;
+                        ret = joined;
+                        continue;
+                    }
+                    if (instr.op == MOVE_OP && instr.arg2 == V0_REG) {
+                        t = rets[body.instrs.at(body.call_before.at(addr)).instr.arg1];
+                    } else {
+                        t = body.types[reads[0]];
+                    }
+                    break;
+                case ADD_OP: case SUB_OP: case MUL_OP: case DIV_OP: case MOD_OP: case POW_OP: case NEG_OP: case BOX_INT:
+                    t = JitType::Int;
+                    break;
+                case GT_OP: case GTE_OP: case LT_OP: case LTE_OP: case EQ_OP: case NEQ_OP:
+                case AND_OP: case OR_OP: case NOT_OP: case BOX_BOOL:
+                    t = JitType::Bool;
+                    break;
+                default:
+                    continue; // writes an int register or nothing
+            }
+            JitType joined = join(body.types[writes[0]], t);
+            if (joined == JitType::Conflict) return false;
+            changed = changed || joined != body.types[writes[0]];
+            body.types[writes[0]] = joined;
+        }
+    }
+    return ret != JitType::Conflict;
+}
+
+// the operand types the VM's ops accept, given the inferred ones
+static bool check_types(Body& body, const std::vector<std::string>& idents, JitType ret) {
+    if (ret != JitType::Int && ret != JitType::Bool) return false;
+    std::vector<int> reads, writes;
+    for (auto& [addr, d] : body.instrs) {
+        operands(body, d.instr, idents, reads, writes);
+        auto all = [&](JitType t) {
+            for (int slot : reads) {
+                if (body.types[slot] != t) return false;
+            }
+            return true;
+        };
+        OPCode op = d.instr.op;
+        for (int slot : writes) {
+            bool typed = shape_of(op)[0] != 'i'; // int registers hold raw ints and bools
+            if (typed && body.types[slot] != JitType::Int && body.types[slot] != JitType::Bool) return false;
+        }
+        switch (op) {
+            case ADD_OP: case SUB_OP: case MUL_OP: case DIV_OP: case MOD_OP: case POW_OP: case NEG_OP:
+            case GT_OP: case GTE_OP: case LT_OP: case LTE_OP:
+                if (!all(JitType::Int)) return false;
+                break;
+            case AND_OP: case OR_OP: case NOT_OP: case JNT:
+                if (!all(JitType::Bool)) return false;
+                break;
+            case EQ_OP: case NEQ_OP:
+                if (!all(JitType::Int) && !all(JitType::Bool)) return false;
+                break;
+            case UNBOX:
+                if (!all(JitType::Int) && !all(JitType::Bool)) return false;
+                break;
+            default:
+                break;
+        }
+    }
+    return true;
+}
+
+static std::vector<JitType> arg_types(const Body& body, const JitFunction& callee) {
+    std::vector<JitType> types;
+    for (const std::string& param : callee.params) types.push_back(body.types[body.vars.at(param)]);
+    return types;
+}
+
+Jit::Jit(IRGenerator& gen):
+    _gen(gen),
+    _code(gen._code),
+    _ident_table(gen._ident_table),
+    _const_table(gen._const_table),
+    _func_table(gen._func_table)
+{
+    add_functions();
+}
+
+// functions declared in bodies compiled since
+void Jit::add_functions() {
+    for (size_t fid = functions.size(); fid < _func_table.size(); fid++) {
+        functions.emplace_back();
+        if (_func_table[fid].func_exp) functions[fid].params = _func_table[fid].func_exp->get_arg_names();
+    }
+}
+
+// the function's bytecode, generating it if it is still a stub, false when
+// the generator rejects its body (the VM raises that error on the call)
+bool Jit::generate(int fid) {
+    try {
+        _gen.compile_function(fid);
+    } catch (const std::runtime_error&) {
+        return false;
+    }
+    add_functions();
+    return true;
+}
+
+Jit::~Jit() {
+#ifdef RV_JIT
+    if (stack) munmap(stack, STACK_BYTES);
+#endif
+}
+
+bool Jit::supported() {
+#ifdef RV_JIT
+    return true;
+#else
+    return false;
+#endif
+}
+
+int Jit::compiled_count() const {
+    int count = 0;
+    for (const JitFunction& fn : functions) count += fn.status == JitFunction::Compiled;
+    return count;
+}
+
+// Maps the arena and the native stack, and writes the two stubs every
+// function shares: the trampoline the VM enters native code through, and
+// where a function that runs out of stack returns from.
+bool Jit::init() {
+#ifdef RV_JIT
+    if (arena.mapped()) return false; // a failed init is not retried
+    if (!arena.map(CODE_BYTES)) return false;
+    void* mem = mmap(nullptr, STACK_BYTES, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (mem == MAP_FAILED) return false;
+    stack = static_cast<uint8_t*>(mem);
+
+    JitData* data = reinterpret_cast<JitData*>(arena.data());
+    data->bailed = NO_BAIL;
+    data->stack_limit = reinterpret_cast<uint64_t>(stack + STACK_MARGIN);
+
+    Assembler as;
+    as.base = arena.next();
+    // int trampoline(const int* args, const uint8_t* fn, uint8_t* stack_top)
+    as.emit({0x55});                   // push rbp
+    as.emit({0x48, 0x89, 0xE5});       // mov rbp, rsp
+    as.emit({0x48, 0x89, 0xD4});       // mov rsp, rdx
+    as.emit({0x48, 0x89, 0xF0});       // mov rax, rsi
+    as.emit({0x49, 0x89, 0xFB});       // mov r11, rdi
+    as.emit({0x41, 0x8B, 0x3B});       // mov edi, [r11]
+    as.emit({0x41, 0x8B, 0x73, 0x04}); // mov esi, [r11 + 4]
+    as.emit({0x41, 0x8B, 0x53, 0x08}); // mov edx, [r11 + 8]
+    as.emit({0x41, 0x8B, 0x4B, 0x0C}); // mov ecx, [r11 + 12]
+    as.emit({0x45, 0x8B, 0x43, 0x10}); // mov r8d, [r11 + 16]
+    as.emit({0x45, 0x8B, 0x4B, 0x14}); // mov r9d, [r11 + 20]
+    as.emit({0xFF, 0xD0});             // call rax
+    as.emit({0x48, 0x89, 0xEC});       // mov rsp, rbp
+    as.emit({0x5D, 0xC3});             // pop rbp, ret
+    overflow = as.here();
+    as.emit({0xC6, 0x05});             // mov byte [bailed], STACK_BAIL
+    as.rel32(&data->bailed, 1);
+    as.emit({STACK_BAIL});
+    as.emit({0x31, 0xC0, 0xC3});       // xor eax, eax, ret
+
+    trampoline = arena.add(as.buf);
+    return trampoline != nullptr;
+#else
+    return false;
+#endif
+}
+
+// Compiles fid for the given parameter types together with every function
+// it reaches through calls, inferring the callees' parameter and return
+// types until they are stable.
+bool Jit::compile(int root, const std::vector<JitType>& root_types) {
+#ifdef RV_JIT
+    if (!trampoline && !init()) return false;
+
+    std::map<int, Body> bodies;
+    std::map<int, std::vector<JitType>> params; // the group, by fid
+    std::map<int, JitType> rets;
+    params[root] = root_types;
+
+    bool stable = false;
+    for (int round = 0; round < MAX_ROUNDS && !stable; round++) {
+        stable = true;
+        std::vector<int> group;
+        for (const auto& entry : params) group.push_back(entry.first);
+        for (int fid : group) {
+            if (!bodies.count(fid)) {
+                Body body;
+                if (!generate(fid)) return false;
+                if (!build_body(_code, _ident_table, _func_table[fid], functions, body)) return false;
+                if (!check_assigned(body, _ident_table, functions)) return false;
+                bodies.emplace(fid, std::move(body));
+            }
+            Body& body = bodies.at(fid);
+            JitType ret;
+            if (!infer_types(body, _ident_table, _const_table, params[fid], rets, ret)) return false;
+            if (ret != rets[fid]) stable = false;
+            rets[fid] = ret;
+
+            for (const auto& [addr, d] : body.instrs) {
+                if (d.instr.op != JUMPF) continue;
+                int callee = d.instr.arg1;
+                std::vector<JitType> args = arg_types(body, functions[callee]);
+                if (functions[callee].status == JitFunction::Failed) return false;
+                if (functions[callee].status == JitFunction::Compiled) {
+                    rets[callee] = functions[callee].ret;
+                    continue; // the arguments are checked once stable
+                }
+                auto it = params.find(callee);
+                if (it == params.end()) {
+                    params[callee] = args;
+                    stable = false;
+                    continue;
+                }
+                for (size_t i = 0; i < args.size(); i++) {
+                    JitType joined = join(it->second[i], args[i]);
+                    if (joined == JitType::Conflict) return false;
+                    if (joined != it->second[i]) stable = false;
+                    it->second[i] = joined;
+                }
+            }
+        }
+    }
+    if (!stable) return false;
+
+    for (auto& [fid, body] : bodies) {
+        if (!check_types(body, _ident_table, rets[fid])) return false;
+        for (const auto& [addr, d] : body.instrs) {
+            if (d.instr.op != JUMPF) continue;
+            const JitFunction& callee = functions[d.instr.arg1];
+            std::vector<JitType> expected = callee.status == JitFunction::Compiled ? callee.param_types : params[d.instr.arg1];
+            if (arg_types(body, callee) != expected) return false;
+        }
+    }
+
+    JitData* data = reinterpret_cast<JitData*>(arena.data());
+    Assembler as;
+    as.base = arena.next();
+    std::map<int, const uint8_t*> entries;
+    std::vector<std::pair<size_t, int>> calls; // rel32 position, callee in the group
+
+    for (auto& [fid, body] : bodies) {
+        std::map<int, size_t> labels;
+        std::vector<std::pair<size_t, int>> jumps; // rel32 position, target address
+        std::vector<size_t> bails;
+        std::vector<size_t> zero_divisors;
+        entries[fid] = as.here();
+
+        // checked before the frame exists, so the overflow stub returns
+        // straight to the caller
+        as.emit({0x48, 0x3B, 0x25});      // cmp rsp, [stack_limit]
+        as.rel32(&data->stack_limit);
+        as.emit({0x0F, 0x82});            // jb overflow
+        as.rel32(overflow);
+        as.emit({0x55});                  // push rbp
+        as.emit({0x48, 0x89, 0xE5});      // mov rbp, rsp
+        as.emit({0x48, 0x81, 0xEC});      // sub rsp, frame
+        as.u32((body.slots * 8 + 15) / 16 * 16);
+        for (size_t i = 0; i < body.params.size(); i++) as.store(body.vars.at(body.params[i]), ARG_REGS[i]);
+
+        std::vector<int> reads, writes;
+        for (auto it = body.instrs.begin(); it != body.instrs.end(); ++it) {
+            int addr = it->first;
+            const Instruction& instr = it->second.instr;
+            labels[addr] = as.buf.size();
+            operands(body, instr, _ident_table, reads, writes);
+            int d = writes.empty() ? -1 : writes[0];
+            int x = reads.size() > 0 ? reads[0] : -1;
+            int y = reads.size() > 1 ? reads[1] : -1;
+
+            switch (instr.op) {
+                case NOP: break;
+                case LOAD_CONST_OP: case INT_LOAD_CONST: {
+                    const Value& k = _const_table[instr.arg2];
+                    as.mem({0xC7}, 0, d); // mov dword [d], imm32
+                    as.u32(k.is_bool() ? k.as_bool() : k.as_int());
+                    break;
+                }
+                case MOVE_OP:
+                    if (instr.arg1 == V0_REG) as.copy(body.v0, x);
+                    else if (instr.arg2 == V0_REG) as.copy(d, body.v0);
+                    else as.copy(d, x);
+                    break;
+                case LOAD_VAR_OP: case STORE_VAR_OP: case INT_MOVE: case BOX_INT: case UNBOX:
+                    as.copy(d, x);
+                    break;
+                case JNT: case INT_JNT:
+                    as.is_zero(x);
+                    as.emit({0x0F, 0x84});   // je
+                    jumps.push_back({as.buf.size(), instr.arg2});
+                    as.u32(0);
+                    break;
+                case JUMP:
+                    as.emit({0xE9});
+                    jumps.push_back({as.buf.size(), instr.arg1});
+                    as.u32(0);
+                    break;
+                case PUSH: {
+                    // the callee's frame is a copy, so whatever the call
+                    // sequence writes is put back after the call
+                    const std::vector<int>& written = body.written.at(addr);
+                    for (size_t i = 0; i < written.size(); i++) as.copy(body.save_base.at(addr) + i, written[i]);
+                    break;
+                }
+                case JUMPF: {
+                    const JitFunction& callee = functions[instr.arg1];
+                    for (size_t i = 0; i < callee.params.size(); i++) as.load(ARG_REGS[i], body.vars.at(callee.params[i]));
+                    as.emit({0xE8});         // call
+                    if (callee.status == JitFunction::Compiled) {
+                        as.rel32(callee.entry);
+                    } else {
+                        calls.push_back({as.buf.size(), instr.arg1});
+                        as.u32(0);
+                    }
+                    as.emit({0x80, 0x3D});   // cmp byte [bailed], 0
+                    as.rel32(&data->bailed, 1);
+                    as.emit({0x00});
+                    as.emit({0x0F, 0x85});   // jne bail
+                    bails.push_back(as.buf.size());
+                    as.u32(0);
+                    as.store(body.v0, EAX);
+                    int push = body.push_of.at(addr);
+                    const std::vector<int>& written = body.written.at(push);
+                    for (size_t i = 0; i < written.size(); i++) as.copy(written[i], body.save_base.at(push) + i);
+                    break;
+                }
+                case RET:
+                    as.load(EAX, body.v0);
+                    as.emit({0xC9, 0xC3});   // leave, ret
+                    break;
+                default:
+                    if (divides(instr.op)) {
+                        as.is_zero(y);
+                        as.emit({0x0F, 0x84});   // je divide bail
+                        zero_divisors.push_back(as.buf.size());
+                        as.u32(0);
+                    }
+                    if (!int_op(as, instr.op, d, x, y)) return false;
+                    break;
+            }
+
+            auto next = std::next(it);
+            bool falls_through = instr.op != JUMP && instr.op != RET;
+            if (falls_through && (next == body.instrs.end() || next->first != it->second.next)) {
+                as.emit({0xE9});
+                jumps.push_back({as.buf.size(), it->second.next});
+                as.u32(0);
+            }
+        }
+
+        const uint8_t* bail = as.here();
+        as.emit({0xC9, 0xC3});               // leave, ret, the caller checks bailed too
+        // the VM runs the call again and reports the division by zero
+        const uint8_t* divide_bail = as.here();
+        as.emit({0xC6, 0x05});               // mov byte [bailed], DIVIDE_BAIL
+        as.rel32(&data->bailed, 1);
+        as.emit({DIVIDE_BAIL});
+        as.emit({0xC9, 0xC3});               // leave, ret
+        for (auto [at, target] : jumps) as.patch(at, as.base + labels.at(target));
+        for (size_t at : bails) as.patch(at, bail);
+        for (size_t at : zero_divisors) as.patch(at, divide_bail);
+    }
+    for (auto [at, callee] : calls) as.patch(at, entries.at(callee));
+
+    if (!arena.add(as.buf)) return false;
+
+    for (auto& [fid, types] : params) {
+        JitFunction& fn = functions[fid];
+        fn.status = JitFunction::Compiled;
+        fn.param_types = types;
+        fn.ret = rets[fid];
+        fn.entry = entries.at(fid);
+    }
+    return true;
+#else
+    (void)root;
+    (void)root_types;
+    return false;
+#endif
+}
+
+bool Jit::call(int fid, const Environment& env, Value& v0, size_t depth) {
+    if (bailed_depth > 0) {
+        if (depth > bailed_depth) return false;
+        bailed_depth = 0; // the VM returned from the call that bailed
+    }
+    add_functions();
+    if (functions[fid].status == JitFunction::Failed) return false;
+    if (static_cast<int>(functions[fid].params.size()) > MAX_PARAMS) {
+        functions[fid].status = JitFunction::Failed;
+        return false;
+    }
+
+    int args[MAX_PARAMS] = {};
+    std::vector<JitType> types;
+    for (size_t i = 0; i < functions[fid].params.size(); i++) {
+        auto it = env.find(functions[fid].params[i]);
+        if (it == env.end()) return false;
+        types.push_back(type_of(it->second));
+        if (types.back() == JitType::Conflict) return false;
+        args[i] = it->second.is_bool() ? it->second.as_bool() : it->second.as_int();
+    }
+
+    if (functions[fid].status == JitFunction::Cold) {
+        if (++functions[fid].calls < threshold) return false;
+        if (!compile(fid, types)) { // can add functions, so fn is bound after it
+            functions[fid].status = JitFunction::Failed;
+            return false;
+        }
+    }
+    const JitFunction& fn = functions[fid];
+    if (types != fn.param_types) return false;
+
+#ifdef RV_JIT
+    using Trampoline = int (*)(const int* args, const uint8_t* fn, uint8_t* stack_top);
+    Trampoline enter;
+    std::memcpy(&enter, &trampoline, sizeof(enter));
+    int res = enter(args, fn.entry, stack + STACK_BYTES);
+
+    JitData* data = reinterpret_cast<JitData*>(arena.data());
+    if (data->bailed != NO_BAIL) {
+        // no side effects to undo, the VM runs the call again
+        if (data->bailed == STACK_BAIL) bailed_depth = depth;
+        data->bailed = NO_BAIL;
+        return false;
+    }
+    if (fn.ret == JitType::Bool) v0 = res != 0;
+    else v0 = res;
+    return true;
+#else
+    return false;
+#endif
+}
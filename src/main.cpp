@@ -4,6 +4,10 @@
 #include "utils.hpp"
 #include "ir_generator.hpp"
 #include "interpreter.hpp"
+#include "ssa_generator.hpp"
+#include "heap.hpp"
+#include "cpp_emitter.hpp"
+#include "closure_evaluator.hpp"
 
 #include <string>
 #include <vector>
@@ -16,6 +20,21 @@ std::unordered_map<std::string, bool> flags = {
     {"--output-parser", false},
     {"--tree-evaluate", false},
     {"--output-ir", false},
+    {"--optimize", false},
+    {"--output-ssa", false},
+    {"--switch-dispatch", false},
+    {"--gc-stats", false},
+    {"--unbuffered", false},
+    {"--no-quicken", false},
+    {"--no-jit", false},
+    {"--no-trace", false},
+    {"--emit-cpp", false},
+    {"--tiered", false},
+    {"--closure-evaluate", false},
+    {"--eager", false},
+    {"--memoize", false},
+    {"--memo-stats", false},
+    {"--profile", false},
 };
 
 void print_lexer_output(const std::vector<Token>& tokens) {
@@ -32,6 +51,18 @@ void print_parser_output(const std::vector<Expression*>& expressions) {
     std::cout << DELIMITER << "\n";
 }
 
+void print_gc_stats() {
+    const heap::Stats& stats = heap::stats();
+    std::cout << DELIMITER << "\n";
+    std::cout << "heap: " << stats.live_lists << " lists, " << stats.live_strings << " strings, " << heap::heap_bytes() << " bytes\n";
+    std::cout << "gc: " << stats.collections << " collections, " << stats.freed_lists << " lists freed\n";
+    std::cout << "gc pause: " << stats.total_pause_ns / 1e6 << " ms total, " << stats.max_pause_ns / 1e6 << " ms max\n";
+}
+
+void print_memo_stats(const MemoCache::Stats& stats) {
+    std::cout << DELIMITER << "\n";
+    std::cout << "memo: " << stats.hits << " hits, " << stats.misses << " misses, " << stats.evictions << " evictions, " << stats.uncached << " uncached calls\n";
+}
 
 int main(int argc, char *argv[]) {
     if (argc < 2) {
@@ -64,14 +95,34 @@ int main(int argc, char *argv[]) {
     std::vector<Expression*> expressions = np.parse_top_level_expressions();
     if (flags["--output-parser"]) print_parser_output(expressions);
     
-    if (flags["--tree-evaluate"]) {
-        // use TreeEvaluator
+    if (flags["--emit-cpp"]) {
+        // print the program as C++ instead of running it, see cpp_emitter.hpp
+        CppEmitter emitter;
+        std::cout << emitter.emit(expressions);
+    } else if (flags["--closure-evaluate"]) {
+        // the tree evaluator's semantics, compiled to closures first
+        ClosureEvaluator evaluator;
+        if (flags["--unbuffered"]) evaluator.set_output_policy(FlushPolicy::Line);
+        evaluator.evaluate_commands(expressions);
+    } else if (flags["--tree-evaluate"] || flags["--tiered"]) {
+        // use TreeEvaluator, --tiered moves hot functions to the VM
         TreeEvaluator evaluator;
+        if (flags["--tiered"]) evaluator.set_tier_threshold(TreeEvaluator::DEFAULT_TIER_THRESHOLD);
+        if (flags["--unbuffered"]) evaluator.set_output_policy(FlushPolicy::Line);
         evaluator.evaluate_commands(expressions);
     } else {
-        // use RV VM
-        IRGenerator gen;
+        // use RV VM, --optimize routes codegen through the SSA tier
+        IRGenerator plain_gen;
+        SSAGenerator ssa_gen;
+        IRGenerator& gen = flags["--optimize"] ? ssa_gen : plain_gen;
+        // functions compile on their first call, unless all of them are listed
+        if (flags["--eager"] || flags["--output-ir"]) gen.set_lazy(false);
         std::vector<Instruction> instr = gen.generate_ir_code(expressions);
+
+        if (flags["--output-ssa"] && flags["--optimize"]) {
+            ssa_gen.print_ssa();
+            std::cout << DELIMITER << "\n";
+        }
         
         if (flags["--output-ir"]) {
             gen.print_instructions();
@@ -79,8 +130,22 @@ int main(int argc, char *argv[]) {
         }
 
         Interpreter interpreter(gen);
+        if (flags["--switch-dispatch"]) interpreter.set_dispatch_mode(DispatchMode::Switch);
+        if (flags["--unbuffered"]) interpreter.set_output_policy(FlushPolicy::Line);
+        if (flags["--no-quicken"]) interpreter.set_quickening(false);
+        if (flags["--no-jit"]) interpreter.set_jit(false);
+        if (flags["--no-trace"]) interpreter.set_tracing(false);
+        if (flags["--memoize"]) interpreter.set_memoize(true);
+        if (flags["--profile"]) interpreter.set_profiling(true);
         interpreter.execute();
+        if (flags["--memo-stats"]) print_memo_stats(interpreter.memo_stats());
+        if (flags["--profile"]) {
+            std::cout << DELIMITER << "\n";
+            interpreter.print_profile();
+        }
     }
+
+    if (flags["--gc-stats"]) print_gc_stats();
     
     utils::cleanup_expressions(expressions);
 }
@@ -0,0 +1,60 @@
+#include "memo_cache.hpp"
+
+bool MemoCache::Key::operator==(const Key& other) const {
+    if (fid != other.fid || arity != other.arity) return false;
+    for (int i = 0; i < arity; i++) {
+        if (words[i] != other.words[i]) return false;
+    }
+    return true;
+}
+
+// the value in the high half and the tag in the low one, so 1 and true differ
+bool MemoCache::Key::add(const Value& arg) {
+    if (arity == MAX_ARGS) return false;
+    if (arg.is_int()) {
+        words[arity++] = static_cast<uint64_t>(static_cast<uint32_t>(arg.as_int())) << 32 | Value::INT_TAG;
+    } else if (arg.is_bool()) {
+        words[arity++] = static_cast<uint64_t>(arg.as_bool()) << 32 | Value::BOOL_TAG;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+MemoCache::MemoCache(size_t capacity) {
+    size_t size = 1;
+    while (size < capacity) size *= 2;
+    slots.resize(size);
+}
+
+size_t MemoCache::slot_of(const Key& key) const {
+    uint64_t h = static_cast<uint64_t>(key.fid) * 0x9E3779B97F4A7C15ULL;
+    for (int i = 0; i < key.arity; i++) {
+        h ^= key.words[i] + 0x9E3779B97F4A7C15ULL + (h << 6) + (h >> 2);
+    }
+    h ^= h >> 29;
+    return h & (slots.size() - 1);
+}
+
+bool MemoCache::lookup(const Key& key, Value& result) {
+    const Entry& entry = slots[slot_of(key)];
+    if (entry.key == key) {
+        counts.hits++;
+        result = entry.result;
+        return true;
+    }
+    counts.misses++;
+    return false;
+}
+
+void MemoCache::store(const Key& key, const Value& result) {
+    Entry& entry = slots[slot_of(key)];
+    if (entry.key.fid >= 0 && !(entry.key == key)) counts.evictions++;
+    entry.key = key;
+    entry.result = result;
+}
+
+void MemoCache::clear() {
+    for (Entry& entry : slots) entry = Entry();
+    counts = Stats();
+}
@@ -0,0 +1,19 @@
+#include "output_writer.hpp"
+
+OutputWriter::OutputWriter(std::ostream& out, FlushPolicy policy, size_t capacity): out(out) {
+    configure(policy, capacity);
+}
+
+void OutputWriter::configure(FlushPolicy new_policy, size_t new_capacity) {
+    flush();
+    policy = new_policy;
+    capacity = new_capacity;
+    if (policy == FlushPolicy::Full) buffer.reserve(capacity + 256);
+}
+
+void OutputWriter::flush() {
+    if (buffer.empty()) return;
+    out.write(buffer.data(), buffer.size());
+    out.flush();
+    buffer.clear();
+}
@@ -2,6 +2,7 @@
 #include "token.hpp"
 #include "expression.hpp"
 #include "arithmetic_parser.hpp"
+#include "ir_generator.hpp"
 
 #include <stack>
 
@@ -69,9 +70,32 @@ std::vector<Expression*> Parser::parse_top_level_expressions() {
         top_level_expressions.push_back(exp);
     }
 
+    // a call may come before the declaration it resolves to
+    for (Expression* exp : top_level_expressions) mark_user_calls(exp);
     return top_level_expressions;
 }
 
+void Parser::mark_user_calls(Expression* exp) const {
+    switch (exp->get_signature()) {
+        case ExpressionType::FUNC_CALL_EXP: {
+            FunctionCallExpression* call_exp = dynamic_cast<FunctionCallExpression*>(exp);
+            if (declared_functions.count(call_exp->get_name())) call_exp->set_calls_user_function(true);
+            break;
+        }
+        case ExpressionType::FUNC_ASSIGN_EXP:
+            for (Expression* body_exp : dynamic_cast<FunctionAssignmentExpression*>(exp)->get_body_exps()) mark_user_calls(body_exp);
+            return;
+        case ExpressionType::LET_EXP:
+            // not through sub_expressions, which drops the call of x = pop(x)
+            // while the call still looks like the native
+            mark_user_calls(dynamic_cast<AssignmentExpression*>(exp)->get_right());
+            return;
+        default:
+            break;
+    }
+    for (Expression* child : IRGenerator::sub_expressions(exp)) mark_user_calls(child);
+}
+
 Expression* Parser::parse_expression(int &idx, bool parsing_condition) {
     if (match(idx, LET)) { // let ...
         return parse_let_expression(idx);
@@ -261,6 +285,7 @@ IfExpression* Parser::parse_if_expression(int &idx) {
 FunctionAssignmentExpression* Parser::parse_function_expression(int &idx) {
     idx += 1; // Function
     const std::string func_name = _tokens[idx].get_string();
+    declared_functions.insert(func_name);
     idx += 1; // name
     idx += 1; // LEFT_PAREN
 
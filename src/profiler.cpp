@@ -0,0 +1,104 @@
+#include "profiler.hpp"
+#include "bytecode.hpp"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+Profiler::Profiler() {
+    clear();
+}
+
+const char* Profiler::tick_unit() {
+#ifdef RV_RDTSC
+    return "cycles";
+#else
+    return "ns";
+#endif
+}
+
+void Profiler::stop() {
+    if (last_pc >= 0) charge(now());
+    last_pc = -1;
+}
+
+void Profiler::clear() {
+    op_counts.assign(NUM_OPCODES, 0);
+    op_ticks.assign(NUM_OPCODES, 0);
+    pair_counts.assign(NUM_OPCODES * NUM_OPCODES, 0);
+    addr_counts.clear();
+    addr_ticks.clear();
+    last_pc = -1;
+}
+
+static double percent(uint64_t part, uint64_t total) {
+    return total == 0 ? 0 : 100.0 * part / total;
+}
+
+// the indices of values that are not zero, largest first
+static std::vector<size_t> ranked(const std::vector<uint64_t>& values, size_t rows) {
+    std::vector<size_t> order;
+    for (size_t i = 0; i < values.size(); i++) {
+        if (values[i] > 0) order.push_back(i);
+    }
+    std::stable_sort(order.begin(), order.end(), [&](size_t x, size_t y) { return values[x] > values[y]; });
+    if (order.size() > rows) order.resize(rows);
+    return order;
+}
+
+// the function whose code holds addr, functions are placed after the top
+// level code in the order they compile
+static std::string function_at(const IRGenerator& gen, size_t addr) {
+    std::string name = "main";
+    int start = -1;
+    for (const FunctionInfo& info : gen._func_table) {
+        if (info.start_addr >= 0 && info.start_addr > start && static_cast<size_t>(info.start_addr) <= addr) {
+            start = info.start_addr;
+            name = info.name;
+        }
+    }
+    return name;
+}
+
+void Profiler::report(const IRGenerator& gen, const MemoCache::Stats* memo, size_t rows) const {
+    uint64_t steps = 0, ticks = 0;
+    for (int op = 0; op < NUM_OPCODES; op++) {
+        steps += op_counts[op];
+        ticks += op_ticks[op];
+    }
+    std::cout << "profile: " << steps << " instructions, " << ticks << " " << tick_unit() << "\n";
+    std::cout << std::fixed << std::setprecision(1);
+
+    std::cout << "\n" << std::left << std::setw(18) << "opcode" << std::right << std::setw(12) << "count" << std::setw(8) << "%"
+              << std::setw(14) << tick_unit() << std::setw(8) << "%" << std::setw(10) << "per op" << "\n";
+    for (size_t op : ranked(op_ticks, rows)) {
+        std::cout << std::left << std::setw(18) << to_string(static_cast<OPCode>(op)) << std::right
+                  << std::setw(12) << op_counts[op] << std::setw(8) << percent(op_counts[op], steps)
+                  << std::setw(14) << op_ticks[op] << std::setw(8) << percent(op_ticks[op], ticks)
+                  << std::setw(10) << static_cast<double>(op_ticks[op]) / op_counts[op] << "\n";
+    }
+
+    // disassembled as the code is now, quickened words included
+    std::cout << "\n" << std::setw(6) << "addr" << "  " << std::left << std::setw(12) << "function" << std::right << std::setw(12) << "count"
+              << std::setw(14) << tick_unit() << std::setw(8) << "%" << "  instruction\n";
+    for (size_t addr : ranked(addr_ticks, rows)) {
+        std::cout << std::setw(6) << addr << "  " << std::left << std::setw(12) << function_at(gen, addr) << std::right
+                  << std::setw(12) << addr_counts[addr] << std::setw(14) << addr_ticks[addr] << std::setw(8) << percent(addr_ticks[addr], ticks) << "  ";
+        size_t len;
+        gen.print_instruction(bytecode::decode(gen._code, addr, len));
+    }
+
+    std::cout << "\n" << std::left << std::setw(36) << "opcode pair" << std::right << std::setw(12) << "count" << std::setw(8) << "%" << "\n";
+    uint64_t pairs = steps > 0 ? steps - 1 : 0;
+    for (size_t pair : ranked(pair_counts, rows)) {
+        std::string name = to_string(static_cast<OPCode>(pair / NUM_OPCODES)) + " -> " + to_string(static_cast<OPCode>(pair % NUM_OPCODES));
+        std::cout << std::left << std::setw(36) << name << std::right << std::setw(12) << pair_counts[pair] << std::setw(8) << percent(pair_counts[pair], pairs) << "\n";
+    }
+
+    if (memo) {
+        std::cout << "\nmemo: " << memo->hits << " hits, " << memo->misses << " misses, " << memo->evictions << " evictions, "
+                  << memo->uncached << " uncached calls, " << percent(memo->hits, memo->hits + memo->misses) << "% hit rate\n";
+    }
+    std::cout << std::defaultfloat;
+}
@@ -0,0 +1,504 @@
+#include "ssa.hpp"
+#include "ssa_generator.hpp"
+#include "builtins.hpp"
+
+#include <iostream>
+
+int SSAFunction::resolve(int v) const {
+    while (v >= 0 && replaced_by[v] != v) v = replaced_by[v];
+    return v;
+}
+
+bool SSAFunction::has_side_effects(const SSAInstr& instr) const {
+    if (instr.kind != SSA_OP) return false;
+    switch (instr.op) {
+        case PRINT_OP:
+        case STORE_VAR_OP:
+        case PUSH:
+        case JUMPF:
+            return true;
+        default:
+            return updates_env_list(instr.op);
+    }
+}
+
+bool SSAFunction::updates_env_list(OPCode op) {
+    return op == STORE_INDEX || op == APPEND_VAR || op == INSERT_VAR || op == REMOVE_VAR || op == POP_VAR;
+}
+
+// Builder
+
+int SSABuilder::new_block() {
+    _func.blocks.push_back(SSABlock());
+    return _func.blocks.size() - 1;
+}
+
+void SSABuilder::set_block(int b) {
+    curr_block = b;
+    _func.layout.push_back(b);
+}
+
+void SSABuilder::add_edge(int from, int to) {
+    _func.blocks[from].succs.push_back(to);
+    _func.blocks[to].preds.push_back(from);
+}
+
+void SSABuilder::seal_block(int b) {
+    for (auto& [var, phi] : incomplete_phis[b]) {
+        add_phi_operands(var, phi);
+    }
+    incomplete_phis.erase(b);
+    _func.blocks[b].sealed = true;
+}
+
+int SSABuilder::emit(SSAKind kind, OPCode op, std::vector<int> args, int imm) {
+    int id = _func.values.size();
+    _func.values.push_back({kind, op, args, imm, curr_block, call_depth, false});
+    _func.replaced_by.push_back(id);
+    _func.blocks[curr_block].instrs.push_back(id);
+    return id;
+}
+
+int SSABuilder::new_phi(int b) {
+    int id = _func.values.size();
+    _func.values.push_back({SSA_PHI, NOP, {}, -1, b, 0, false});
+    _func.replaced_by.push_back(id);
+    auto& instrs = _func.blocks[b].instrs;
+    instrs.insert(instrs.begin(), id); // phis always lead the block
+    return id;
+}
+
+void SSABuilder::write_variable(const std::string& var, int b, int val) {
+    current_def[var][b] = val;
+}
+
+int SSABuilder::read_variable(const std::string& var, int b) {
+    auto& defs = current_def[var];
+    if (defs.find(b) != defs.end()) return defs[b];
+    return read_variable_recursive(var, b);
+}
+
+int SSABuilder::read_variable_recursive(const std::string& var, int b) {
+    SSABlock& block = _func.blocks[b];
+    int val;
+    if (!block.sealed) {
+        val = new_phi(b);
+        incomplete_phis[b][var] = val;
+    } else if (block.preds.empty()) {
+        // only the entry block has no preds, the value comes from the incoming frame
+        int id = _func.values.size();
+        _func.values.push_back({SSA_OP, LOAD_VAR_OP, {}, _gen.intern_ident(var), b, 0, false});
+        _func.replaced_by.push_back(id);
+        entry_loads.push_back(id);
+        val = id;
+    } else if (block.preds.size() == 1) {
+        val = read_variable(var, block.preds[0]);
+    } else {
+        val = new_phi(b);
+        write_variable(var, b, val);
+        val = add_phi_operands(var, val);
+    }
+    write_variable(var, b, val);
+    return val;
+}
+
+int SSABuilder::add_phi_operands(const std::string& var, int phi) {
+    int b = _func.values[phi].block;
+    for (int pred : _func.blocks[b].preds) {
+        int arg = read_variable(var, pred);
+        _func.values[phi].args.push_back(arg);
+    }
+    return phi;
+}
+
+void SSABuilder::build(const std::vector<Expression*>& body, bool top_level) {
+    in_function = !top_level;
+    int entry = new_block();
+    seal_block(entry);
+    set_block(entry);
+
+    collect_memory_vars(body);
+    build_block(body);
+
+    if (!terminated()) {
+        _func.blocks[curr_block].term = top_level ? TERM_END : TERM_RET;
+    }
+
+    auto& instrs = _func.blocks[entry].instrs;
+    instrs.insert(instrs.begin(), entry_loads.begin(), entry_loads.end());
+}
+
+void SSABuilder::build_block(const std::vector<Expression*>& exps) {
+    for (Expression* exp : exps) {
+        if (terminated()) {
+            // unreachable, but IRGenerator still registers the functions declared here
+            declare_nested_functions(exp);
+            continue;
+        }
+        build_exp(exp);
+    }
+}
+
+void SSABuilder::declare_nested_functions(Expression* exp) {
+    switch (exp->get_signature()) {
+        case ExpressionType::FUNC_ASSIGN_EXP: {
+            _gen.declare_function(dynamic_cast<FunctionAssignmentExpression*>(exp));
+            break;
+        }
+        case ExpressionType::IF_EXP: {
+            IfExpression* if_exp = dynamic_cast<IfExpression*>(exp);
+            for (Expression* e : if_exp->get_if_exps()) declare_nested_functions(e);
+            for (Expression* e : if_exp->get_else_exps()) declare_nested_functions(e);
+            break;
+        }
+        case ExpressionType::WHILE_EXP: {
+            WhileExpression* while_exp = dynamic_cast<WhileExpression*>(exp);
+            for (Expression* e : while_exp->get_body_exps()) declare_nested_functions(e);
+            break;
+        }
+        default: break;
+    }
+}
+
+void SSABuilder::collect_memory_vars(const std::vector<Expression*>& exps) {
+    for (Expression* exp : exps) {
+        switch (exp->get_signature()) {
+            case ExpressionType::LET_EXP: {
+                AssignmentExpression* let_exp = dynamic_cast<AssignmentExpression*>(exp);
+                if (let_exp->is_index_store() || IRGenerator::in_place_list_op(let_exp) != NOP) memory_vars.insert(let_exp->get_id());
+                break;
+            }
+            case ExpressionType::IF_EXP: {
+                IfExpression* if_exp = dynamic_cast<IfExpression*>(exp);
+                collect_memory_vars(if_exp->get_if_exps());
+                collect_memory_vars(if_exp->get_else_exps());
+                break;
+            }
+            case ExpressionType::WHILE_EXP: {
+                collect_memory_vars(dynamic_cast<WhileExpression*>(exp)->get_body_exps());
+                break;
+            }
+            default: break;
+        }
+    }
+}
+
+int SSABuilder::finish_exp(Expression* exp, int val) {
+    if (exp->is_returnable()) {
+        _func.blocks[curr_block].term = TERM_RET;
+        _func.blocks[curr_block].ret_val = val;
+        curr_block = -1;
+    }
+    return val;
+}
+
+int SSABuilder::build_exp(Expression* exp) {
+    switch (exp->get_signature()) {
+        case ExpressionType::EMPTY_EXP: {
+            if (exp->is_returnable()) {
+                _func.blocks[curr_block].term = TERM_RET;
+                curr_block = -1;
+                return -1;
+            }
+            return emit(SSA_UNDEF, NOP, {});
+        }
+        case ExpressionType::CONST_EXP: {
+            ConstExp* const_exp = dynamic_cast<ConstExp*>(exp);
+            int val = emit(SSA_OP, LOAD_CONST_OP, {}, _gen.intern_const(const_exp->get_val()));
+            return finish_exp(exp, val);
+        }
+        case ExpressionType::VAR_EXP: {
+            VarExp* var_exp = dynamic_cast<VarExp*>(exp);
+            const std::string& var_name = var_exp->get_var_name();
+            if (memory_vars.count(var_name)) {
+                return finish_exp(exp, emit(SSA_LOAD_MEM, LOAD_VAR_OP, {}, _gen.intern_ident(var_name)));
+            }
+            int val = read_variable(var_name, curr_block);
+            return finish_exp(exp, val);
+        }
+        case ExpressionType::LET_EXP: return build_let(dynamic_cast<AssignmentExpression*>(exp));
+        case ExpressionType::MON_EXP: return build_mon(dynamic_cast<MonadicExpression*>(exp));
+        case ExpressionType::BIN_EXP: return build_bin(dynamic_cast<BinaryExpression*>(exp));
+        case ExpressionType::IF_EXP: {
+            build_if(dynamic_cast<IfExpression*>(exp));
+            return -1;
+        }
+        case ExpressionType::WHILE_EXP: {
+            build_while(dynamic_cast<WhileExpression*>(exp));
+            return -1;
+        }
+        case ExpressionType::FUNC_ASSIGN_EXP: {
+            _gen.declare_function(dynamic_cast<FunctionAssignmentExpression*>(exp));
+            return -1;
+        }
+        case ExpressionType::FUNC_CALL_EXP: return build_call(dynamic_cast<FunctionCallExpression*>(exp));
+        case ExpressionType::LIST_EXP: return build_list(dynamic_cast<ListExpression*>(exp));
+        case ExpressionType::LIST_ACCESS_EXP: return build_access(dynamic_cast<ListAccessExpression*>(exp));
+        case ExpressionType::LIST_MODIFY_EXP: return build_modify(dynamic_cast<ListModifyExpression*>(exp));
+        default: throw std::runtime_error("SSA: unknown expression type");
+    };
+}
+
+int SSABuilder::build_let(AssignmentExpression* let_exp) {
+    if (let_exp->is_index_store()) return build_store_index(let_exp);
+    OPCode in_place_op = IRGenerator::in_place_list_op(let_exp);
+    if (in_place_op != NOP) return build_in_place_call(let_exp, in_place_op);
+
+    int val = build_exp(let_exp->get_right());
+    if (val == -1) val = emit(SSA_UNDEF, NOP, {});
+    const std::string& var_name = let_exp->get_id();
+
+    if (!let_exp->is_reassign()) {
+        _gen.declare_ident(var_name);
+    } else if (!in_function && !_gen.is_declared(var_name)) {
+        throw std::runtime_error("Variable " + var_name + " has not been properly declared");
+    }
+
+    emit(SSA_OP, STORE_VAR_OP, {val}, _gen.intern_ident(var_name));
+    if (!memory_vars.count(var_name)) write_variable(var_name, curr_block, val);
+    return -1;
+}
+
+int SSABuilder::build_store_index(AssignmentExpression* let_exp) {
+    const std::string& var_name = let_exp->get_id();
+    if (!in_function && !_gen.is_declared(var_name)) throw std::runtime_error("Variable " + var_name + " has not been properly declared");
+
+    std::vector<Expression*> idx_exps;
+    Expression* val_exp = dynamic_cast<ListModifyExpression*>(let_exp->get_right())->flatten(idx_exps);
+
+    std::vector<int> args;
+    for (Expression* exp : idx_exps) args.push_back(build_exp(exp));
+    int val = build_exp(val_exp);
+    if (val == -1) val = emit(SSA_UNDEF, NOP, {});
+    args.push_back(val);
+
+    // args = index path followed by the stored value
+    emit(SSA_OP, STORE_INDEX, args, _gen.intern_ident(var_name));
+    return -1;
+}
+
+int SSABuilder::build_in_place_call(AssignmentExpression* let_exp, OPCode op) {
+    const std::string& var_name = let_exp->get_id();
+    if (!in_function && !_gen.is_declared(var_name)) throw std::runtime_error("Variable " + var_name + " has not been properly declared");
+
+    // args = the builtin's operands after the list itself
+    const std::vector<Expression*>& arg_exps = dynamic_cast<FunctionCallExpression*>(let_exp->get_right())->get_arg_exps();
+    std::vector<int> args;
+    for (size_t i = 1; i < arg_exps.size(); i++) {
+        int val = build_exp(arg_exps[i]);
+        if (val == -1) val = emit(SSA_UNDEF, NOP, {});
+        args.push_back(val);
+    }
+
+    emit(SSA_OP, op, args, _gen.intern_ident(var_name));
+    return -1;
+}
+
+int SSABuilder::build_mon(MonadicExpression* mon_exp) {
+    int t1 = build_exp(mon_exp->get_right());
+
+    switch (mon_exp->get_type()) {
+        case MonadicOperator::NotOp: return finish_exp(mon_exp, emit(SSA_OP, NOT_OP, {t1}));
+        case MonadicOperator::IntNegOp: return finish_exp(mon_exp, emit(SSA_OP, NEG_OP, {t1}));
+        case MonadicOperator::SizeOp: return finish_exp(mon_exp, emit(SSA_OP, SIZE_OP, {t1}));
+        case MonadicOperator::PrintOp: {
+            emit(SSA_OP, PRINT_OP, {t1});
+            return emit(SSA_UNDEF, NOP, {});
+        }
+    };
+
+    throw std::runtime_error("Unknown mon op");
+}
+
+int SSABuilder::build_bin(BinaryExpression* bin_exp) {
+    int t1 = build_exp(bin_exp->get_left());
+    int t2 = build_exp(bin_exp->get_right());
+    OPCode op = _gen.map_binexp_to_opcode(bin_exp->get_type());
+    return finish_exp(bin_exp, emit(SSA_OP, op, {t1, t2}));
+}
+
+void SSABuilder::build_if(IfExpression* if_exp) {
+    int cond = build_exp(if_exp->get_conditional());
+    int cond_block = curr_block;
+
+    int then_block = new_block();
+    int else_block = new_block();
+    _func.blocks[cond_block].term = TERM_BRANCH;
+    _func.blocks[cond_block].cond = cond;
+    add_edge(cond_block, then_block);
+    add_edge(cond_block, else_block);
+    seal_block(then_block);
+    seal_block(else_block);
+
+    set_block(then_block);
+    build_block(if_exp->get_if_exps());
+    int then_end = curr_block;
+
+    set_block(else_block);
+    build_block(if_exp->get_else_exps());
+    int else_end = curr_block;
+
+    if (then_end == -1 && else_end == -1) {
+        curr_block = -1; // both branches returned
+        return;
+    }
+
+    int join_block = new_block();
+    for (int end : {then_end, else_end}) {
+        if (end == -1) continue;
+        _func.blocks[end].term = TERM_JUMP;
+        add_edge(end, join_block);
+    }
+    seal_block(join_block);
+    set_block(join_block);
+}
+
+void SSABuilder::build_while(WhileExpression* while_exp) {
+    int header = new_block();
+    _func.blocks[curr_block].term = TERM_JUMP;
+    add_edge(curr_block, header);
+    set_block(header); // not sealed until the back edge exists
+
+    int cond = build_exp(while_exp->get_conditional());
+    int cond_end = curr_block;
+
+    int body_block = new_block();
+    int exit_block = new_block();
+    _func.blocks[cond_end].term = TERM_BRANCH;
+    _func.blocks[cond_end].cond = cond;
+    add_edge(cond_end, body_block);
+    add_edge(cond_end, exit_block);
+    seal_block(body_block);
+    seal_block(exit_block);
+
+    set_block(body_block);
+    build_block(while_exp->get_body_exps());
+    if (!terminated()) {
+        _func.blocks[curr_block].term = TERM_JUMP;
+        add_edge(curr_block, header);
+    }
+    seal_block(header);
+
+    set_block(exit_block);
+}
+
+int SSABuilder::build_call(FunctionCallExpression* call_exp) {
+    int nid = IRGenerator::resolve_native(call_exp);
+    if (nid >= 0) {
+        // natives run on the current frame, no argument frame to model
+        std::vector<int> args;
+        for (Expression* exp : call_exp->get_arg_exps()) {
+            int val = build_exp(exp);
+            if (val == -1) val = emit(SSA_UNDEF, NOP, {});
+            args.push_back(val);
+        }
+        return finish_exp(call_exp, emit(SSA_OP, CALL_NATIVE, args, nid));
+    }
+
+    int fid = _gen.resolve_function(call_exp->get_name());
+    FunctionAssignmentExpression* func_exp = _gen._func_table[fid].func_exp;
+
+    const std::vector<std::string>& arg_names = func_exp->get_arg_names();
+    const std::vector<Expression*>& arg_exps = call_exp->get_arg_exps();
+
+    // the args are evaluated and stored inside the pushed frame, which is
+    // discarded on RET, so their defs must not leak past the call
+    std::map<std::string, int> saved_defs;
+    std::set<std::string> undefined;
+    for (size_t i = 0; i < call_exp->get_args_length(); i++) {
+        auto& defs = current_def[arg_names[i]];
+        if (defs.find(curr_block) != defs.end()) saved_defs[arg_names[i]] = defs[curr_block];
+        else undefined.insert(arg_names[i]);
+    }
+
+    emit(SSA_OP, PUSH, {}, _gen.capture_id(call_exp));
+    call_depth += 1;
+    for (size_t i = 0; i < call_exp->get_args_length(); i++) {
+        int t1 = build_exp(arg_exps[i]);
+        _gen.declare_ident(arg_names[i]);
+        emit(SSA_OP, STORE_VAR_OP, {t1}, _gen.intern_ident(arg_names[i]));
+        write_variable(arg_names[i], curr_block, t1);
+    }
+    emit(SSA_OP, JUMPF, {}, fid);
+    call_depth -= 1;
+
+    for (auto& [var, val] : saved_defs) current_def[var][curr_block] = val;
+    for (const std::string& var : undefined) current_def[var].erase(curr_block);
+
+    return emit(SSA_CALL_RESULT, MOVE_OP, {});
+}
+
+int SSABuilder::build_list(ListExpression* list_exp) {
+    std::vector<int> elements;
+    for (Expression* exp : list_exp->get_elements()) {
+        elements.push_back(build_exp(exp));
+    }
+    return finish_exp(list_exp, emit(SSA_LIST, INIT_LIST, elements));
+}
+
+int SSABuilder::build_access(ListAccessExpression* access_exp) {
+    int t1 = build_exp(access_exp->get_arr_exp());
+    int t2 = build_exp(access_exp->get_idx_exp());
+    return finish_exp(access_exp, emit(SSA_OP, ACCESS, {t1, t2}));
+}
+
+int SSABuilder::build_modify(ListModifyExpression* modify_exp) {
+    int t1 = build_exp(modify_exp->get_ident_exp());
+    int t2 = build_exp(modify_exp->get_idx_exp());
+    int t3 = build_exp(modify_exp->get_exp());
+    return emit(SSA_MODIFY, MODIFY, {t1, t2, t3});
+}
+
+// Printing
+
+void SSAFunction::print(const SSAGenerator& gen) const {
+    auto val_string = [&](int v) { return v < 0 ? std::string("undef") : "%" + std::to_string(resolve(v)); };
+
+    std::cout << name << "\n";
+    for (int b : layout) {
+        const SSABlock& block = blocks[b];
+        std::cout << "  B" << b << ":";
+        if (!block.preds.empty()) {
+            std::cout << " ; preds";
+            for (int p : block.preds) std::cout << " B" << p;
+        }
+        std::cout << "\n";
+
+        for (int id : block.instrs) {
+            const SSAInstr& instr = values[id];
+            if (instr.dead) continue;
+
+            std::cout << "    ";
+            if (!has_side_effects(instr)) std::cout << "%" << id << " = ";
+            switch (instr.kind) {
+                case SSA_PHI: std::cout << "PHI"; break;
+                case SSA_LIST: std::cout << "LIST"; break;
+                case SSA_MODIFY: std::cout << "MODIFY"; break;
+                case SSA_CALL_RESULT: std::cout << "CALL_RESULT"; break;
+                case SSA_UNDEF: std::cout << "UNDEF"; break;
+                case SSA_LOAD_MEM: std::cout << "LOAD_MEM " << gen._ident_table[instr.imm]; break;
+                case SSA_OP: {
+                    std::cout << to_string(instr.op);
+                    if (instr.op == LOAD_CONST_OP) {
+                        std::cout << " ";
+                        gen._const_table[instr.imm].write_to(std::cout, true);
+                    }
+                    if (instr.op == LOAD_VAR_OP || instr.op == STORE_VAR_OP || updates_env_list(instr.op)) std::cout << " " << gen._ident_table[instr.imm];
+                    if (instr.op == JUMPF) std::cout << " " << gen._func_table[instr.imm].name;
+                    if (instr.op == CALL_NATIVE) std::cout << " " << builtin::natives()[instr.imm].name;
+                    break;
+                }
+            }
+            for (int arg : instr.args) std::cout << " " << val_string(arg);
+            std::cout << "\n";
+        }
+
+        switch (block.term) {
+            case TERM_JUMP: std::cout << "    JUMP B" << block.succs[0] << "\n"; break;
+            case TERM_BRANCH: std::cout << "    BRANCH " << val_string(block.cond) << " B" << block.succs[0] << " B" << block.succs[1] << "\n"; break;
+            case TERM_RET: std::cout << "    RET" << (block.ret_val >= 0 ? " " + val_string(block.ret_val) : "") << "\n"; break;
+            case TERM_END: std::cout << "    END\n"; break;
+            case TERM_NONE: break;
+        }
+    }
+}
@@ -0,0 +1,382 @@
+#include "ssa_generator.hpp"
+#include "ssa_optimizer.hpp"
+
+#include <iostream>
+#include <set>
+
+const int V0_REG = -2; // return reg id
+const int T0_REG = -3; // Temp0 reg id
+
+std::vector<Instruction>& SSAGenerator::generate_ir_code(const std::vector<Expression*>& _exps) {
+    // same traversal order as IRGenerator so fids and name resolution match
+    captures.resolve(_exps);
+    SSAFunction main_func;
+    main_func.name = "main";
+    SSABuilder(*this, main_func).build(_exps, true);
+    functions.push_back(main_func);
+
+    while (!func_assign_queue.empty()) {
+        int fid = func_assign_queue.front();
+        func_assign_queue.pop();
+
+        SSAFunction func;
+        func.name = _func_table[fid].name;
+        func.fid = fid;
+        SSABuilder(*this, func).build(_func_table[fid].func_exp->get_body_exps(), false);
+        functions.push_back(func);
+    }
+
+    for (SSAFunction& func : functions) {
+        SSAOptimizer(func, _const_table).run();
+    }
+
+    for (SSAFunction& func : functions) {
+        lower_function(func);
+    }
+
+    assemble();
+    return _instr;
+}
+
+int SSAGenerator::intern_const(const Value& val) {
+    std::string key = val.get_type() + ":" + val.to_string(true);
+    if (const_to_idx.find(key) == const_to_idx.end()) {
+        const_to_idx[key] = _const_table.size();
+        _const_table.push_back(val);
+    }
+    return const_to_idx[key];
+}
+
+void SSAGenerator::declare_ident(const std::string& name) {
+    declared_idents.insert(name);
+}
+
+bool SSAGenerator::is_declared(const std::string& name) const {
+    return declared_idents.find(name) != declared_idents.end();
+}
+
+int SSAGenerator::declare_function(FunctionAssignmentExpression* func_exp) {
+    store_func_assign_exp(func_exp);
+    return ident_to_fid[func_exp->get_name()];
+}
+
+int SSAGenerator::resolve_function(const std::string& name) {
+    return ident_to_fid[name];
+}
+
+// Lowering
+
+void SSAGenerator::lower_function(SSAFunction& func) {
+    const int start_addr = _instr.size();
+    if (func.fid >= 0) {
+        _func_table[func.fid].start_addr = start_addr;
+        addr_to_ident[start_addr] = func.name;
+    }
+
+    // every surviving value gets its own virtual register, frames are copied
+    // on PUSH so recursion never clobbers the caller's registers
+    std::vector<int> reg_of(func.values.size(), -1);
+    for (size_t id = 0; id < func.values.size(); id++) {
+        const SSAInstr& instr = func.values[id];
+        if (!instr.dead && !func.has_side_effects(instr)) reg_of[id] = curr_reg++;
+    }
+    auto reg = [&](int v) { return reg_of[func.resolve(v)]; };
+
+    Unboxing unboxing = plan_unboxing(func);
+    auto ireg = [&](int v) { return unboxing.ireg_of[func.resolve(v)]; };
+    auto box_op = [&](int id) { return func.types[id] == TYPE_BOOL ? BOX_BOOL : BOX_INT; };
+
+    // ACCESS / SIZE reuse the register of a list they are the only use of
+    // (in the same block, so the use runs once per def), otherwise the dead
+    // register keeps the list shared and the next in place STORE_INDEX has
+    // to copy it
+    std::vector<int> uses(func.values.size(), 0);
+    auto use = [&](int v) { if ((v = func.resolve(v)) >= 0) uses[v]++; };
+    for (const SSAInstr& instr : func.values) {
+        if (instr.dead) continue;
+        for (int arg : instr.args) use(arg);
+    }
+    for (const SSABlock& block : func.blocks) {
+        if (block.term == TERM_BRANCH) use(block.cond);
+        if (block.term == TERM_RET) use(block.ret_val);
+    }
+    for (int b : func.layout) {
+        for (int id : func.blocks[b].instrs) {
+            const SSAInstr& instr = func.values[id];
+            if (instr.dead || instr.kind != SSA_OP || (instr.op != ACCESS && instr.op != SIZE_OP)) continue;
+            int list = func.resolve(instr.args[0]);
+            const SSAInstr& def = func.values[list];
+            if (uses[list] == 1 && def.kind != SSA_PHI && def.block == instr.block) reg_of[id] = reg_of[list];
+        }
+    }
+
+    std::vector<int> block_addr(func.blocks.size(), -1);
+    std::vector<std::pair<size_t, int>> jump_fixups; // (instr idx, target block), patched into arg1
+    std::vector<std::pair<size_t, int>> branch_fixups; // patched into arg2
+
+    for (size_t i = 0; i < func.layout.size(); i++) {
+        int b = func.layout[i];
+        const SSABlock& block = func.blocks[b];
+        int next_block = (i + 1 < func.layout.size()) ? func.layout[i + 1] : -1;
+        block_addr[b] = _instr.size();
+
+        for (int id : block.instrs) {
+            const SSAInstr& instr = func.values[id];
+            if (instr.dead) continue;
+
+            int r = reg_of[id];
+            OPCode int_op = unboxing.int_op[id];
+            if (int_op != NOP) {
+                int ir = unboxing.ireg_of[id];
+                if (int_op == INT_LOAD_CONST) {
+                    _instr.push_back({ITYPE, INT_LOAD_CONST, ir, instr.imm, -1});
+                } else if (int_op == INT_NOT || int_op == INT_NEG) {
+                    _instr.push_back({RTYPE, int_op, ir, ireg(instr.args[0]), -1});
+                } else if (int_op != INT_MOVE) { // phis are written by the copies in their preds
+                    _instr.push_back({RTYPE, int_op, ir, ireg(instr.args[0]), ireg(instr.args[1])});
+                }
+                if (unboxing.needs_box[id]) _instr.push_back({RTYPE, box_op(id), r, ir, -1});
+                continue;
+            }
+
+            switch (instr.kind) {
+                case SSA_PHI: break;
+                case SSA_UNDEF: break; // never written, reads as the default Value
+                case SSA_LIST: {
+                    _instr.push_back({ITYPE, INIT_LIST, r, -1, -1});
+                    for (int arg : instr.args) _instr.push_back({RTYPE, APPEND, r, reg(arg), -1});
+                    break;
+                }
+                case SSA_MODIFY: {
+                    _instr.push_back({RTYPE, MODIFY, reg(instr.args[0]), reg(instr.args[1]), reg(instr.args[2])});
+                    _instr.push_back({RTYPE, MOVE_OP, r, T0_REG, -1});
+                    break;
+                }
+                case SSA_LOAD_MEM: _instr.push_back({RTYPE, LOAD_VAR_OP, r, instr.imm, -1}); break;
+                case SSA_CALL_RESULT: {
+                    _instr.push_back({RTYPE, MOVE_OP, r, V0_REG, -1});
+                    break;
+                }
+                case SSA_OP: {
+                    switch (instr.op) {
+                        case LOAD_CONST_OP: _instr.push_back({ITYPE, LOAD_CONST_OP, r, instr.imm, -1}); break;
+                        case LOAD_VAR_OP: _instr.push_back({RTYPE, LOAD_VAR_OP, r, instr.imm, -1}); break;
+                        case STORE_VAR_OP: _instr.push_back({RTYPE, STORE_VAR_OP, instr.imm, reg(instr.args[0]), -1}); break;
+                        case PRINT_OP: _instr.push_back({RTYPE, PRINT_OP, reg(instr.args[0]), -1, -1}); break;
+                        case PUSH: _instr.push_back({RTYPE, PUSH, instr.imm, 1, -1}); break; // args may reuse values computed before it
+                        case JUMPF: _instr.push_back({JTYPE, JUMPF, instr.imm, -1, -1}); break;
+                        case NOT_OP: case NEG_OP: case SIZE_OP: {
+                            _instr.push_back({RTYPE, instr.op, r, reg(instr.args[0]), -1});
+                            break;
+                        }
+                        case ACCESS: _instr.push_back({RTYPE, ACCESS, r, reg(instr.args[0]), reg(instr.args[1])}); break;
+                        case STORE_INDEX: lower_store_index(func, instr, reg_of); break;
+                        case CALL_NATIVE: {
+                            int base = consecutive_regs(func, instr.args, reg_of);
+                            _instr.push_back({RTYPE, CALL_NATIVE, r, instr.imm, base});
+                            break;
+                        }
+                        case APPEND_VAR: case INSERT_VAR: case REMOVE_VAR: case POP_VAR: {
+                            int r1 = instr.args.size() > 0 ? reg(instr.args[0]) : -1;
+                            int r2 = instr.args.size() > 1 ? reg(instr.args[1]) : -1;
+                            _instr.push_back({RTYPE, instr.op, instr.imm, r1, r2});
+                            break;
+                        }
+                        default: _instr.push_back({ITYPE, instr.op, r, reg(instr.args[0]), reg(instr.args[1])}); break;
+                    }
+                    break;
+                }
+            }
+            if (unboxing.needs_unbox[id]) _instr.push_back({RTYPE, UNBOX, unboxing.ireg_of[id], r, -1});
+        }
+
+        switch (block.term) {
+            case TERM_JUMP: {
+                int target = block.succs[0];
+                emit_phi_copies(func, b, target, reg_of, unboxing);
+                if (target != next_block) {
+                    jump_fixups.push_back({_instr.size(), target});
+                    _instr.push_back({JTYPE, JUMP, -1, -1, -1});
+                }
+                break;
+            }
+            case TERM_BRANCH: {
+                // branch targets have a single pred, so they never carry phis
+                branch_fixups.push_back({_instr.size(), block.succs[1]});
+                if (int_branch(func, unboxing, block.cond)) _instr.push_back({JTYPE, INT_JNT, ireg(block.cond), -1, -1});
+                else _instr.push_back({JTYPE, JNT, reg(block.cond), -1, -1});
+                if (block.succs[0] != next_block) {
+                    jump_fixups.push_back({_instr.size(), block.succs[0]});
+                    _instr.push_back({JTYPE, JUMP, -1, -1, -1});
+                }
+                break;
+            }
+            case TERM_RET: {
+                if (block.ret_val >= 0) _instr.push_back({RTYPE, MOVE_OP, V0_REG, reg(block.ret_val), -1});
+                _instr.push_back({JTYPE, RET, -1, -1, -1});
+                break;
+            }
+            case TERM_END: _instr.push_back({ITYPE, END, -1, -1, -1}); break;
+            case TERM_NONE: break;
+        }
+    }
+
+    for (auto& [idx, target] : jump_fixups) _instr[idx].arg1 = block_addr[target];
+    for (auto& [idx, target] : branch_fixups) _instr[idx].arg2 = block_addr[target];
+}
+
+// The unboxed op an SSA op lowers to when the inferred types of its operands
+// allow it, NOP otherwise
+OPCode SSAGenerator::unboxed_form(const SSAFunction& func, const SSAInstr& instr) const {
+    if (instr.kind != SSA_OP) return NOP;
+    auto type = [&](size_t i) { int v = func.resolve(instr.args[i]); return v < 0 ? TYPE_ANY : func.types[v]; };
+    auto both = [&](SSAType t) { return type(0) == t && type(1) == t; };
+
+    switch (instr.op) {
+        case LOAD_CONST_OP: {
+            const Value& val = _const_table[instr.imm];
+            return val.is_int() || val.is_bool() ? INT_LOAD_CONST : NOP;
+        }
+        case ADD_OP: return both(TYPE_INT) ? INT_ADD : NOP;
+        case SUB_OP: return both(TYPE_INT) ? INT_SUB : NOP;
+        case MUL_OP: return both(TYPE_INT) ? INT_MUL : NOP;
+        case DIV_OP: return both(TYPE_INT) ? INT_DIV : NOP;
+        case MOD_OP: return both(TYPE_INT) ? INT_MOD : NOP;
+        case LT_OP: return both(TYPE_INT) ? INT_LT : NOP;
+        case LTE_OP: return both(TYPE_INT) ? INT_LTE : NOP;
+        case GT_OP: return both(TYPE_INT) ? INT_GT : NOP;
+        case GTE_OP: return both(TYPE_INT) ? INT_GTE : NOP;
+        case EQ_OP: return both(TYPE_INT) || both(TYPE_BOOL) ? INT_EQ : NOP;
+        case NEQ_OP: return both(TYPE_INT) || both(TYPE_BOOL) ? INT_NEQ : NOP;
+        case AND_OP: return both(TYPE_BOOL) ? INT_AND : NOP;
+        case OR_OP: return both(TYPE_BOOL) ? INT_OR : NOP;
+        case NOT_OP: return type(0) == TYPE_BOOL ? INT_NOT : NOP;
+        case NEG_OP: return type(0) == TYPE_INT ? INT_NEG : NOP;
+        default: return NOP;
+    }
+}
+
+// JNT on a bool computed unboxed, anything else keeps the generic JNT and
+// its type error
+bool SSAGenerator::int_branch(const SSAFunction& func, const Unboxing& unboxing, int cond) {
+    cond = func.resolve(cond);
+    return cond >= 0 && unboxing.int_op[cond] != NOP && func.types[cond] == TYPE_BOOL;
+}
+
+// Values proven int or bool are computed in the int register bank when
+// their op has an unboxed form, and so are phis whose inputs all are. A
+// boxed input of an unboxed op is unboxed into a shadow register after its
+// def, an unboxed value read by anything else is boxed after its def.
+SSAGenerator::Unboxing SSAGenerator::plan_unboxing(const SSAFunction& func) {
+    size_t n = func.values.size();
+    Unboxing res = {std::vector<OPCode>(n, NOP), std::vector<int>(n, -1), std::vector<bool>(n, false), std::vector<bool>(n, false)};
+    auto type = [&](int v) { v = func.resolve(v); return v < 0 ? TYPE_ANY : func.types[v]; };
+    auto raw = [&](int v) { return type(v) == TYPE_INT || type(v) == TYPE_BOOL; };
+
+    for (size_t id = 0; id < n; id++) {
+        const SSAInstr& instr = func.values[id];
+        if (instr.dead || !unboxing) continue;
+        if (instr.kind == SSA_PHI) {
+            bool all_raw = raw(id) && !instr.args.empty();
+            for (int arg : instr.args) all_raw = all_raw && raw(arg);
+            if (all_raw) res.int_op[id] = INT_MOVE;
+        } else {
+            res.int_op[id] = unboxed_form(func, instr);
+        }
+    }
+
+    auto read = [&](int v, bool unboxed_reader) {
+        if (v < 0 || (v = func.resolve(v)) < 0) return;
+        bool unboxed = res.int_op[v] != NOP;
+        if (unboxed_reader && !unboxed) res.needs_unbox[v] = true;
+        if (!unboxed_reader && unboxed) res.needs_box[v] = true;
+    };
+    for (const SSAInstr& instr : func.values) {
+        if (instr.dead) continue;
+        bool unboxed_reader = res.int_op[&instr - func.values.data()] != NOP;
+        for (int arg : instr.args) read(arg, unboxed_reader);
+    }
+    for (const SSABlock& block : func.blocks) {
+        if (block.term == TERM_RET) read(block.ret_val, false);
+        if (block.term == TERM_BRANCH && !int_branch(func, res, block.cond)) read(block.cond, false);
+    }
+
+    for (size_t id = 0; id < n; id++) {
+        if (res.int_op[id] != NOP || res.needs_unbox[id]) res.ireg_of[id] = _int_reg_count++;
+    }
+    return res;
+}
+
+void SSAGenerator::lower_store_index(const SSAFunction& func, const SSAInstr& instr, const std::vector<int>& reg_of) {
+    auto reg = [&](int v) { return reg_of[func.resolve(v)]; };
+    int depth = instr.args.size() - 1;
+    if (depth == 1) {
+        _instr.push_back({RTYPE, STORE_INDEX, instr.imm, reg(instr.args[0]), reg(instr.args[1])});
+        return;
+    }
+
+    int base = consecutive_regs(func, instr.args, reg_of);
+    _instr.push_back({RTYPE, STORE_INDEX_PATH, instr.imm, base, depth});
+}
+
+// base of a run of registers holding vals in order, copies them into fresh
+// registers unless they already are one
+int SSAGenerator::consecutive_regs(const SSAFunction& func, const std::vector<int>& vals, const std::vector<int>& reg_of) {
+    auto reg = [&](int v) { return reg_of[func.resolve(v)]; };
+    if (vals.empty()) return -1;
+
+    bool in_place = true;
+    for (size_t i = 0; i < vals.size(); i++) in_place = in_place && reg(vals[i]) == reg(vals[0]) + static_cast<int>(i);
+    if (in_place) return reg(vals[0]);
+
+    int base = curr_reg;
+    curr_reg += vals.size();
+    for (size_t i = 0; i < vals.size(); i++) _instr.push_back({RTYPE, MOVE_OP, base + static_cast<int>(i), reg(vals[i]), -1});
+    return base;
+}
+
+void SSAGenerator::emit_phi_copies(const SSAFunction& func, int from, int to, const std::vector<int>& reg_of, const Unboxing& unboxing) {
+    const SSABlock& succ = func.blocks[to];
+    size_t pred_idx = 0;
+    while (succ.preds[pred_idx] != from) pred_idx++;
+
+    std::vector<std::pair<int, int>> copies, int_copies; // (dst, src)
+    for (int id : succ.instrs) {
+        const SSAInstr& instr = func.values[id];
+        if (instr.kind != SSA_PHI || instr.dead) continue;
+        int arg = func.resolve(instr.args[pred_idx]);
+        if (unboxing.int_op[id] != NOP) {
+            if (unboxing.ireg_of[arg] != unboxing.ireg_of[id]) int_copies.push_back({unboxing.ireg_of[id], unboxing.ireg_of[arg]});
+        } else if (reg_of[arg] != reg_of[id]) {
+            copies.push_back({reg_of[id], reg_of[arg]});
+        }
+    }
+    emit_parallel_copies(copies, MOVE_OP, curr_reg);
+    emit_parallel_copies(int_copies, INT_MOVE, _int_reg_count);
+}
+
+void SSAGenerator::emit_parallel_copies(const std::vector<std::pair<int, int>>& copies, OPCode move, int& next_reg) {
+    // the copies are parallel, go through temporaries if one reads another's dst
+    std::set<int> dsts;
+    for (auto& copy : copies) dsts.insert(copy.first);
+    bool overlap = false;
+    for (auto& copy : copies) overlap = overlap || dsts.count(copy.second);
+
+    if (!overlap) {
+        for (auto& [dst, src] : copies) _instr.push_back({RTYPE, move, dst, src, -1});
+        return;
+    }
+
+    std::vector<int> temps;
+    for (auto& copy : copies) {
+        temps.push_back(next_reg++);
+        _instr.push_back({RTYPE, move, temps.back(), copy.second, -1});
+    }
+    for (size_t i = 0; i < copies.size(); i++) {
+        _instr.push_back({RTYPE, move, copies[i].first, temps[i], -1});
+    }
+}
+
+void SSAGenerator::print_ssa() const {
+    for (const SSAFunction& func : functions) func.print(*this);
+}
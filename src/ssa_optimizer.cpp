@@ -0,0 +1,414 @@
+#include "ssa_optimizer.hpp"
+
+#include <set>
+#include <algorithm>
+
+void SSAOptimizer::run() {
+    compute_rpo();
+    compute_dominators();
+
+    simplify_phis();
+    available.clear();
+    value_number(0);
+    simplify_phis();
+
+    infer_types();
+    eliminate_dead_stores();
+    eliminate_dead_code();
+    _func.types = types;
+    _func.types.resize(_func.values.size(), TYPE_ANY);
+}
+
+// CFG helpers
+
+void SSAOptimizer::compute_rpo() {
+    std::vector<bool> visited(_func.blocks.size(), false);
+    std::vector<int> post;
+    std::vector<std::pair<int, size_t>> stack = {{0, 0}};
+    visited[0] = true;
+
+    while (!stack.empty()) {
+        auto& [b, next] = stack.back();
+        const std::vector<int>& succs = _func.blocks[b].succs;
+        if (next < succs.size()) {
+            int s = succs[next++];
+            if (!visited[s]) {
+                visited[s] = true;
+                stack.push_back({s, 0});
+            }
+        } else {
+            post.push_back(b);
+            stack.pop_back();
+        }
+    }
+
+    rpo.assign(post.rbegin(), post.rend());
+    for (size_t b = 0; b < _func.blocks.size(); b++) {
+        _func.blocks[b].reachable = visited[b];
+    }
+}
+
+void SSAOptimizer::compute_dominators() {
+    std::vector<int> order(_func.blocks.size(), -1);
+    for (size_t i = 0; i < rpo.size(); i++) order[rpo[i]] = i;
+
+    idom.assign(_func.blocks.size(), -1);
+    idom[0] = 0;
+
+    auto intersect = [&](int b1, int b2) {
+        while (b1 != b2) {
+            while (order[b1] > order[b2]) b1 = idom[b1];
+            while (order[b2] > order[b1]) b2 = idom[b2];
+        }
+        return b1;
+    };
+
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (int b : rpo) {
+            if (b == 0) continue;
+            int new_idom = -1;
+            for (int p : _func.blocks[b].preds) {
+                if (idom[p] == -1) continue;
+                new_idom = (new_idom == -1) ? p : intersect(p, new_idom);
+            }
+            if (new_idom != idom[b]) {
+                idom[b] = new_idom;
+                changed = true;
+            }
+        }
+    }
+
+    dom_children.assign(_func.blocks.size(), {});
+    for (int b : rpo) {
+        if (b != 0 && idom[b] != -1) dom_children[idom[b]].push_back(b);
+    }
+}
+
+// Copy propagation: a phi whose operands are all the same value (or the phi
+// itself) is just a copy of that value
+
+bool SSAOptimizer::simplify_phis() {
+    bool any_change = false;
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (size_t id = 0; id < _func.values.size(); id++) {
+            SSAInstr& instr = _func.values[id];
+            if (instr.kind != SSA_PHI || instr.dead) continue;
+
+            int same = -1;
+            bool trivial = true;
+            for (int arg : instr.args) {
+                int v = _func.resolve(arg);
+                if (v == static_cast<int>(id) || v == same) continue;
+                if (same != -1) {
+                    trivial = false;
+                    break;
+                }
+                same = v;
+            }
+            if (!trivial) continue;
+
+            if (same == -1) {
+                instr.kind = SSA_UNDEF; // only reachable through itself
+                instr.args.clear();
+            } else {
+                _func.replaced_by[id] = same;
+                instr.dead = true;
+            }
+            changed = true;
+            any_change = true;
+        }
+    }
+    return any_change;
+}
+
+// Global value numbering over the dominator tree. Values computed inside a
+// call's argument frame die with that frame, so they are only available
+// until the matching JUMPF.
+
+bool SSAOptimizer::is_pure(const SSAInstr& instr) const {
+    if (instr.kind == SSA_MODIFY) return true;
+    if (instr.kind != SSA_OP) return false;
+
+    switch (instr.op) {
+        case ADD_OP: case SUB_OP: case MUL_OP: case DIV_OP: case MOD_OP: case POW_OP:
+        case GT_OP: case GTE_OP: case LT_OP: case LTE_OP: case EQ_OP: case NEQ_OP:
+        case AND_OP: case OR_OP: case NOT_OP: case NEG_OP: case SIZE_OP:
+        case ACCESS: case LOAD_CONST_OP: case LOAD_VAR_OP:
+            return true;
+        default:
+            return false;
+    }
+}
+
+void SSAOptimizer::value_number(int b) {
+    std::vector<ValueKey> added;
+    std::vector<size_t> region_marks;
+
+    for (int id : _func.blocks[b].instrs) {
+        SSAInstr& instr = _func.values[id];
+        if (instr.dead) continue;
+
+        if (instr.kind == SSA_OP && instr.op == PUSH) {
+            region_marks.push_back(added.size());
+            continue;
+        }
+        if (instr.kind == SSA_OP && instr.op == JUMPF) {
+            size_t mark = region_marks.back();
+            region_marks.pop_back();
+            while (added.size() > mark) {
+                available.erase(added.back());
+                added.pop_back();
+            }
+            continue;
+        }
+        if (!is_pure(instr)) continue;
+
+        std::vector<int> args;
+        for (int arg : instr.args) args.push_back(_func.resolve(arg));
+        ValueKey key = {instr.kind, instr.op, instr.imm, args};
+
+        auto it = available.find(key);
+        if (it != available.end()) {
+            _func.replaced_by[id] = it->second;
+            instr.dead = true;
+        } else {
+            available[key] = id;
+            added.push_back(key);
+        }
+    }
+
+    for (int child : dom_children[b]) value_number(child);
+
+    for (const ValueKey& key : added) available.erase(key);
+}
+
+// Type inference, used to prove that an unused op cannot throw and, by the
+// lowering, to keep ints and bools unboxed
+
+static SSAType join(SSAType a, SSAType b) {
+    if (a == TYPE_TOP) return b;
+    if (b == TYPE_TOP || a == b) return a;
+    return TYPE_ANY;
+}
+
+static SSAType type_of_value(const Value& v) {
+    if (v.is_int()) return TYPE_INT;
+    if (v.is_bool()) return TYPE_BOOL;
+    if (v.is_string()) return TYPE_STRING;
+    if (v.is_list()) return TYPE_LIST;
+    return TYPE_ANY;
+}
+
+SSAType SSAOptimizer::result_type(const SSAInstr& instr) const {
+    auto arg_type = [&](size_t i) { return types[_func.resolve(instr.args[i])]; };
+
+    switch (instr.kind) {
+        case SSA_PHI: {
+            SSAType t = TYPE_TOP;
+            for (size_t i = 0; i < instr.args.size(); i++) t = join(t, arg_type(i));
+            return t;
+        }
+        case SSA_LIST: return TYPE_LIST;
+        case SSA_MODIFY: {
+            SSAType t = arg_type(0);
+            return (t == TYPE_TOP || t == TYPE_STRING || t == TYPE_LIST) ? t : TYPE_ANY;
+        }
+        case SSA_CALL_RESULT: return TYPE_ANY;
+        case SSA_UNDEF: return TYPE_ANY;
+        case SSA_LOAD_MEM: return TYPE_ANY;
+        case SSA_OP: break;
+    }
+
+    switch (instr.op) {
+        case LOAD_CONST_OP: return type_of_value(_const_table[instr.imm]);
+        case GT_OP: case GTE_OP: case LT_OP: case LTE_OP: case EQ_OP: case NEQ_OP:
+        case AND_OP: case OR_OP: case NOT_OP:
+            return TYPE_BOOL;
+        case NEG_OP: case SIZE_OP: return TYPE_INT;
+        case ACCESS: {
+            SSAType t = arg_type(0);
+            return (t == TYPE_TOP || t == TYPE_STRING) ? t : TYPE_ANY;
+        }
+        case ADD_OP: case SUB_OP: case MUL_OP: case DIV_OP: case MOD_OP: case POW_OP: {
+            SSAType t1 = arg_type(0), t2 = arg_type(1);
+            if (t1 == TYPE_TOP || t2 == TYPE_TOP) return TYPE_TOP;
+            if (t1 == TYPE_INT && t2 == TYPE_INT) return TYPE_INT;
+            if (instr.op == ADD_OP && t1 == t2 && (t1 == TYPE_STRING || t1 == TYPE_LIST)) return t1;
+            if (instr.op == MUL_OP && t2 == TYPE_INT && (t1 == TYPE_STRING || t1 == TYPE_LIST)) return t1;
+            return TYPE_ANY;
+        }
+        default: return TYPE_ANY;
+    }
+}
+
+void SSAOptimizer::infer_types() {
+    types.assign(_func.values.size(), TYPE_TOP);
+
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (size_t id = 0; id < _func.values.size(); id++) {
+            const SSAInstr& instr = _func.values[id];
+            if (instr.dead) continue;
+            SSAType t = join(types[id], result_type(instr));
+            if (t != types[id]) {
+                types[id] = t;
+                changed = true;
+            }
+        }
+    }
+}
+
+bool SSAOptimizer::const_int_is(int v, int c) const {
+    const SSAInstr& instr = _func.values[_func.resolve(v)];
+    if (instr.kind != SSA_OP || instr.op != LOAD_CONST_OP) return false;
+    const Value& val = _const_table[instr.imm];
+    return val.is_int() && val.as_int() == c;
+}
+
+bool SSAOptimizer::may_trap(const SSAInstr& instr) const {
+    if (instr.kind == SSA_MODIFY) return true;
+    if (instr.kind != SSA_OP) return false;
+
+    auto arg_type = [&](size_t i) { return types[_func.resolve(instr.args[i])]; };
+    auto both = [&](SSAType t1, SSAType t2) { return arg_type(0) == t1 && arg_type(1) == t2; };
+
+    switch (instr.op) {
+        case LOAD_CONST_OP: case LOAD_VAR_OP: return false;
+        case ADD_OP: return !(both(TYPE_INT, TYPE_INT) || both(TYPE_STRING, TYPE_STRING) || both(TYPE_LIST, TYPE_LIST));
+        case MUL_OP: return !(both(TYPE_INT, TYPE_INT) || both(TYPE_STRING, TYPE_INT) || both(TYPE_LIST, TYPE_INT));
+        case SUB_OP: case POW_OP:
+        case GT_OP: case GTE_OP: case LT_OP: case LTE_OP:
+            return !both(TYPE_INT, TYPE_INT);
+        case DIV_OP: case MOD_OP: {
+            bool const_divisor = false;
+            const SSAInstr& divisor = _func.values[_func.resolve(instr.args[1])];
+            if (divisor.kind == SSA_OP && divisor.op == LOAD_CONST_OP) {
+                const_divisor = !const_int_is(instr.args[1], 0) && !const_int_is(instr.args[1], -1);
+            }
+            return !(both(TYPE_INT, TYPE_INT) && const_divisor);
+        }
+        case EQ_OP: case NEQ_OP: {
+            SSAType t = arg_type(0);
+            return !(t == arg_type(1) && (t == TYPE_INT || t == TYPE_BOOL || t == TYPE_STRING));
+        }
+        case AND_OP: case OR_OP: return !both(TYPE_BOOL, TYPE_BOOL);
+        case NOT_OP: return arg_type(0) != TYPE_BOOL;
+        case NEG_OP: return arg_type(0) != TYPE_INT;
+        case SIZE_OP: return !(arg_type(0) == TYPE_STRING || arg_type(0) == TYPE_LIST);
+        default: return true;
+    }
+}
+
+// Dead store elimination. Env variables can only be observed by the callee of
+// a later user function call (it runs on a copy of the frame) or read back by
+// an env resident variable's LOAD_MEM / in place update, a RET or END drops them.
+// Stores into a call's argument frame are always kept.
+
+struct EnvLiveness {
+    bool all = false;
+    std::set<int> idents; // live idents, or the dead ones when `all` is set
+
+    bool contains(int ident) const { return all ? !idents.count(ident) : idents.count(ident) > 0; }
+    void kill(int ident) { if (all) idents.insert(ident); else idents.erase(ident); }
+    void set_all() { all = true; idents.clear(); }
+
+    void merge(const EnvLiveness& other) {
+        std::set<int> res;
+        if (!all && !other.all) {
+            std::set_union(idents.begin(), idents.end(), other.idents.begin(), other.idents.end(), std::inserter(res, res.end()));
+        } else if (all && other.all) {
+            std::set_intersection(idents.begin(), idents.end(), other.idents.begin(), other.idents.end(), std::inserter(res, res.end()));
+        } else {
+            const std::set<int>& excluded = all ? idents : other.idents;
+            const std::set<int>& included = all ? other.idents : idents;
+            std::set_difference(excluded.begin(), excluded.end(), included.begin(), included.end(), std::inserter(res, res.end()));
+            all = true;
+        }
+        idents = res;
+    }
+
+    bool operator==(const EnvLiveness& other) const { return all == other.all && idents == other.idents; }
+};
+
+void SSAOptimizer::eliminate_dead_stores() {
+    std::vector<EnvLiveness> live_in(_func.blocks.size());
+
+    auto transfer = [&](int b, bool remove_stores) {
+        EnvLiveness live;
+        for (int s : _func.blocks[b].succs) live.merge(live_in[s]);
+
+        const std::vector<int>& instrs = _func.blocks[b].instrs;
+        for (auto it = instrs.rbegin(); it != instrs.rend(); ++it) {
+            SSAInstr& instr = _func.values[*it];
+            if (instr.dead || (instr.kind != SSA_OP && instr.kind != SSA_LOAD_MEM)) continue;
+
+            if (instr.op == JUMPF && instr.imm >= 0) {
+                live.set_all();
+            } else if (instr.op == LOAD_VAR_OP || SSAFunction::updates_env_list(instr.op)) {
+                // an in place update reads the stored list
+                if (live.all) live.idents.erase(instr.imm);
+                else live.idents.insert(instr.imm);
+            } else if (instr.op == STORE_VAR_OP && instr.call_depth == 0) {
+                if (!live.contains(instr.imm)) {
+                    if (remove_stores) instr.dead = true;
+                } else {
+                    live.kill(instr.imm);
+                }
+            }
+        }
+        return live;
+    };
+
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (auto it = rpo.rbegin(); it != rpo.rend(); ++it) {
+            EnvLiveness live = transfer(*it, false);
+            if (!(live == live_in[*it])) {
+                live_in[*it] = live;
+                changed = true;
+            }
+        }
+    }
+
+    for (int b : rpo) transfer(b, true);
+}
+
+void SSAOptimizer::eliminate_dead_code() {
+    std::vector<bool> live(_func.values.size(), false);
+    std::vector<int> worklist;
+
+    auto mark = [&](int v) {
+        v = _func.resolve(v);
+        if (v >= 0 && !live[v]) {
+            live[v] = true;
+            worklist.push_back(v);
+        }
+    };
+
+    for (int b : rpo) {
+        const SSABlock& block = _func.blocks[b];
+        for (int id : block.instrs) {
+            const SSAInstr& instr = _func.values[id];
+            if (instr.dead) continue;
+            if (_func.has_side_effects(instr) || may_trap(instr)) mark(id);
+        }
+        if (block.term == TERM_BRANCH) mark(block.cond);
+        if (block.term == TERM_RET && block.ret_val >= 0) mark(block.ret_val);
+    }
+
+    while (!worklist.empty()) {
+        int v = worklist.back();
+        worklist.pop_back();
+        for (int arg : _func.values[v].args) mark(arg);
+    }
+
+    for (size_t id = 0; id < _func.values.size(); id++) {
+        if (!live[id]) _func.values[id].dead = true;
+    }
+}
@@ -0,0 +1,95 @@
+#include "tiering.hpp"
+#include "builtins.hpp"
+
+#include <map>
+#include <stdexcept>
+
+// declares names before generating, the constructor's vm reads the code.
+// Everything compiles up front, so a body the generator rejects keeps the
+// function in the tree evaluator instead of failing on its first call
+static IRGenerator& generated(IRGenerator& gen, const std::vector<Expression*>& functions, const std::set<std::string>& names) {
+    for (const std::string& name : names) gen.declare_variable(name);
+    gen.set_lazy(false);
+    gen.generate_ir_code(functions);
+    return gen;
+}
+
+CompiledFunction::CompiledFunction(const std::vector<Expression*>& functions, const std::set<std::string>& names, OutputWriter& output):
+    vm(generated(gen, functions, names))
+{
+    vm.share_output(output);
+}
+
+namespace {
+
+// What the functions of a compiled program need: the functions their calls
+// reach (resolved the way the tree evaluator resolves them now) and every
+// variable they mention, which the program declares up front
+struct Unit {
+    const FunctionEnvironment& func_env;
+    std::vector<Expression*> functions;                         // the program, the hot one first
+    std::vector<FunctionAssignmentExpression*> bodies;          // to scan, nested declarations included
+    std::map<std::string, FunctionAssignmentExpression*> by_name;
+    std::set<std::string> names;
+
+    bool add(FunctionAssignmentExpression* func_exp, bool nested) {
+        auto [it, added] = by_name.emplace(func_exp->get_name(), func_exp);
+        if (!added) return it->second == func_exp; // two functions of one name
+        if (!nested) functions.push_back(func_exp);
+        bodies.push_back(func_exp);
+        names.insert(func_exp->get_arg_names().begin(), func_exp->get_arg_names().end());
+        return true;
+    }
+
+    bool scan(Expression* exp) {
+        switch (exp->get_signature()) {
+            case ExpressionType::VAR_EXP:
+                names.insert(dynamic_cast<VarExp*>(exp)->get_var_name());
+                break;
+            case ExpressionType::LET_EXP:
+                names.insert(dynamic_cast<AssignmentExpression*>(exp)->get_id());
+                break;
+            case ExpressionType::FUNC_ASSIGN_EXP:
+                return add(dynamic_cast<FunctionAssignmentExpression*>(exp), true);
+            case ExpressionType::FUNC_CALL_EXP: {
+                FunctionCallExpression* call_exp = dynamic_cast<FunctionCallExpression*>(exp);
+                if (!call_exp->calls_user_function() && builtin::find_native(call_exp->get_name()) >= 0) break;
+                FunctionAssignmentExpression* callee = nullptr;
+                auto it = by_name.find(call_exp->get_name());
+                if (it != by_name.end()) {
+                    callee = it->second;
+                } else {
+                    auto defined = func_env.find(call_exp->get_name());
+                    if (defined == func_env.end() || !add(defined->second, false)) return false;
+                    callee = defined->second;
+                }
+                if (callee->get_args_length() != call_exp->get_args_length()) return false;
+                break;
+            }
+            default:
+                break;
+        }
+        for (Expression* sub_exp : IRGenerator::sub_expressions(exp)) {
+            if (!scan(sub_exp)) return false;
+        }
+        return true;
+    }
+};
+
+} // namespace
+
+std::unique_ptr<CompiledFunction> CompiledFunction::compile(FunctionAssignmentExpression* func_exp, const FunctionEnvironment& func_env, OutputWriter& output) {
+    Unit unit{func_env, {}, {}, {}, {}};
+    unit.add(func_exp, false);
+    for (size_t i = 0; i < unit.bodies.size(); i++) {
+        for (Expression* exp : unit.bodies[i]->get_body_exps()) {
+            if (!unit.scan(exp)) return nullptr;
+        }
+    }
+
+    try {
+        return std::unique_ptr<CompiledFunction>(new CompiledFunction(unit.functions, unit.names, output));
+    } catch (const std::runtime_error&) {
+        return nullptr;
+    }
+}
@@ -0,0 +1,449 @@
+#include "trace_jit.hpp"
+#include "bytecode.hpp"
+#include "value_ops.hpp"
+
+#include <cmath>
+#include <cstring>
+
+using namespace x86;
+
+static const size_t CODE_BYTES = 4 << 20;
+
+static bool has_type(const Value& val, TraceType type) {
+    switch (type) {
+        case TraceType::Int: return val.is_int();
+        case TraceType::Bool: return val.is_bool();
+        case TraceType::List: return val.is_list();
+        default: return true;
+    }
+}
+
+// called from traces, list points at a VM Value holding a list
+static int list_size(const Value* list) {
+    return static_cast<int>(list->as_list().size());
+}
+
+// the element zero extended, -1 when idx is out of bounds or the element
+// does not have the tag the trace was recorded with
+static int64_t list_get(const Value* list, int idx, int tag) {
+    const std::vector<Value>& items = list->as_list();
+    if (idx < 0 || idx >= static_cast<int>(items.size()) || items[idx].tag() != tag) return -1;
+    const Value& item = items[idx];
+    return static_cast<uint32_t>(item.is_bool() ? item.as_bool() : item.as_int());
+}
+
+// what the VM computes for op on two ints or bools, false where it would
+// not produce one (or would throw)
+static bool apply(OPCode op, int x, int y, int& out) {
+    switch (op) {
+        case ADD_OP: case INT_ADD: out = x + y; break;
+        case SUB_OP: case INT_SUB: out = x - y; break;
+        case MUL_OP: case INT_MUL: out = x * y; break;
+        case DIV_OP: case INT_DIV: case MOD_OP: case INT_MOD:
+            if (y == 0) return false;
+            out = op == DIV_OP || op == INT_DIV ? value_ops::int_div(x, y) : value_ops::int_mod(x, y);
+            break;
+        case POW_OP: out = static_cast<int>(std::pow(x, y)); break;
+        case LT_OP: case INT_LT: out = x < y; break;
+        case LTE_OP: case INT_LTE: out = x <= y; break;
+        case GT_OP: case INT_GT: out = x > y; break;
+        case GTE_OP: case INT_GTE: out = x >= y; break;
+        case EQ_OP: case INT_EQ: out = x == y; break;
+        case NEQ_OP: case INT_NEQ: out = x != y; break;
+        case AND_OP: case INT_AND: out = x && y; break;
+        case OR_OP: case INT_OR: out = x || y; break;
+        default: return false;
+    }
+    return true;
+}
+
+static int raw(const Value& val) {
+    return val.is_bool() ? val.as_bool() : val.as_int();
+}
+
+TraceJit::TraceJit(IRGenerator& gen):
+    _code(gen._code),
+    _ident_table(gen._ident_table),
+    _const_table(gen._const_table)
+{}
+
+bool TraceJit::supported() {
+#ifdef RV_JIT
+    return true;
+#else
+    return false;
+#endif
+}
+
+int TraceJit::compiled_count() const {
+    int count = 0;
+    for (const auto& [header, loop] : loops) count += loop.entry != nullptr;
+    return count;
+}
+
+// Interprets from pc to the back-edge on copies of what the VM holds,
+// appending the path to loop. from_exit is the exit the path continues,
+// -1 for the root. Fails on ops without a template, on leaving the loop or
+// entering an inner one, and when a slot's type at the back-edge differs
+// from its type on entry.
+bool TraceJit::record(TraceLoop& loop, int header, int pc, int from_exit, const std::map<int, Value>& regs,
+                      const std::vector<int>& iregs, const Environment& env) {
+    std::vector<TraceType> types = loop.entry_types;
+    if (from_exit >= 0) {
+        for (const auto& [slot, type] : loop.exits[from_exit].types) types[slot] = type;
+    }
+    std::map<int, Value> vals; // by slot, what this path has read or written
+
+    auto slot = [&](char kind, int index, int& out) {
+        Value val;
+        if (kind == 'i') {
+            if (index < 0 || index >= static_cast<int>(iregs.size())) return false;
+            val = iregs[index];
+        } else {
+            const Value* found = nullptr;
+            if (kind == 'r') {
+                auto it = regs.find(index);
+                if (it != regs.end()) found = &it->second;
+            } else {
+                auto it = env.find(_ident_table[index]);
+                if (it != env.end()) found = &it->second;
+            }
+            if (!found) return false;
+            val = *found;
+        }
+        auto it = loop.slot_of.find({kind, index});
+        if (it == loop.slot_of.end()) {
+            TraceType type = TraceType::IntReg;
+            if (kind != 'i') {
+                if (val.is_int()) type = TraceType::Int;
+                else if (val.is_bool()) type = TraceType::Bool;
+                else if (val.is_list()) type = TraceType::List;
+                else return false;
+            }
+            out = loop.slots.size();
+            loop.slots.push_back({kind, index});
+            loop.slot_of[{kind, index}] = out;
+            loop.entry_types.push_back(type);
+            types.push_back(type);
+        } else {
+            out = it->second;
+        }
+        if (!vals.count(out)) {
+            if (!has_type(val, types[out])) return false;
+            vals[out] = val;
+        }
+        return true;
+    };
+    auto add_exit = [&](int exit_pc) {
+        TraceExit exit;
+        exit.pc = exit_pc;
+        for (size_t s = 0; s < types.size(); s++) exit.types[s] = types[s];
+        exit.final = exit_pc < header || exit_pc > loop.back_edge;
+        loop.exits.push_back(exit);
+        return static_cast<int>(loop.exits.size()) - 1;
+    };
+
+    std::vector<TraceStep> path;
+    for (int count = 0;; count++) {
+        if (pc < header || pc > loop.back_edge || count > MAX_STEPS) return false;
+        size_t len;
+        Instruction instr = bytecode::decode(_code, pc, len);
+        int next = pc + static_cast<int>(len);
+        TraceStep step;
+        step.op = bytecode::generic(instr.op);
+
+        switch (step.op) {
+            case NOP:
+                pc = next;
+                continue;
+            case JUMP:
+                if (instr.arg1 == header) {
+                    for (size_t s = 0; s < types.size(); s++) {
+                        if (types[s] != loop.entry_types[s]) return false;
+                    }
+                    if (from_exit >= 0) loop.exits[from_exit].branch = loop.paths.size();
+                    loop.paths.push_back(std::move(path));
+                    return true;
+                }
+                if (instr.arg1 <= pc) return false; // an inner loop
+                pc = instr.arg1;
+                continue;
+            case JNT: case INT_JNT: {
+                bool is_int = step.op == INT_JNT;
+                if (!slot(is_int ? 'i' : 'r', instr.arg1, step.x)) return false;
+                if (types[step.x] != (is_int ? TraceType::IntReg : TraceType::Bool)) return false;
+                bool holds = raw(vals[step.x]) != 0;
+                step.exit = add_exit(holds ? instr.arg2 : next);
+                step.exit_if_zero = holds;
+                path.push_back(step);
+                pc = holds ? next : instr.arg2;
+                continue;
+            }
+            case LOAD_CONST_OP: case INT_LOAD_CONST: {
+                const Value& k = _const_table[instr.arg2];
+                if (!k.is_int() && !k.is_bool()) return false;
+                bool is_int = step.op == INT_LOAD_CONST;
+                if (!slot(is_int ? 'i' : 'r', instr.arg1, step.d)) return false;
+                step.imm = raw(k);
+                types[step.d] = is_int ? TraceType::IntReg : k.is_bool() ? TraceType::Bool : TraceType::Int;
+                vals[step.d] = is_int ? Value(step.imm) : k;
+                break;
+            }
+            case MOVE_OP: case LOAD_VAR_OP: case STORE_VAR_OP: case INT_MOVE: {
+                if (instr.arg1 < 0 || instr.arg2 < 0) return false; // v0 and t0
+                char dst = step.op == STORE_VAR_OP ? 'v' : step.op == INT_MOVE ? 'i' : 'r';
+                char src = step.op == LOAD_VAR_OP ? 'v' : step.op == INT_MOVE ? 'i' : 'r';
+                if (!slot(src, instr.arg2, step.x) || !slot(dst, instr.arg1, step.d)) return false;
+                types[step.d] = types[step.x];
+                vals[step.d] = vals[step.x];
+                break;
+            }
+            case BOX_INT: case BOX_BOOL:
+                if (!slot('i', instr.arg2, step.x) || !slot('r', instr.arg1, step.d)) return false;
+                types[step.d] = step.op == BOX_INT ? TraceType::Int : TraceType::Bool;
+                vals[step.d] = step.op == BOX_INT ? Value(raw(vals[step.x])) : Value(raw(vals[step.x]) != 0);
+                break;
+            case UNBOX:
+                if (!slot('r', instr.arg2, step.x) || !slot('i', instr.arg1, step.d)) return false;
+                if (types[step.x] != TraceType::Int && types[step.x] != TraceType::Bool) return false;
+                types[step.d] = TraceType::IntReg;
+                vals[step.d] = Value(raw(vals[step.x]));
+                break;
+            case SIZE_OP:
+                if (!slot('r', instr.arg2, step.x) || !slot('r', instr.arg1, step.d)) return false;
+                if (types[step.x] != TraceType::List) return false;
+                types[step.d] = TraceType::Int;
+                vals[step.d] = Value(static_cast<int>(vals[step.x].as_list().size()));
+                break;
+            case ACCESS: {
+                if (!slot('r', instr.arg2, step.x) || !slot('r', instr.arg3, step.y) || !slot('r', instr.arg1, step.d)) return false;
+                if (types[step.x] != TraceType::List || types[step.y] != TraceType::Int) return false;
+                const std::vector<Value>& items = vals[step.x].as_list();
+                int idx = vals[step.y].as_int();
+                if (idx < 0 || idx >= static_cast<int>(items.size())) return false;
+                Value item = items[idx];
+                if (!item.is_int() && !item.is_bool()) return false;
+                step.exit = add_exit(pc); // the VM runs the ACCESS again
+                step.imm = item.tag();
+                types[step.d] = item.is_int() ? TraceType::Int : TraceType::Bool;
+                vals[step.d] = item;
+                break;
+            }
+            case NOT_OP: case NEG_OP: case INT_NOT: case INT_NEG: {
+                bool is_int = step.op == INT_NOT || step.op == INT_NEG;
+                char kind = is_int ? 'i' : 'r';
+                if (!slot(kind, instr.arg2, step.x) || !slot(kind, instr.arg1, step.d)) return false;
+                TraceType want = is_int ? TraceType::IntReg : step.op == NOT_OP ? TraceType::Bool : TraceType::Int;
+                if (types[step.x] != want) return false;
+                int x = raw(vals[step.x]);
+                bool negate = step.op == NEG_OP || step.op == INT_NEG;
+                types[step.d] = want;
+                vals[step.d] = want == TraceType::Bool ? Value(!x) : Value(negate ? -x : !x);
+                break;
+            }
+            case INT_ADD: case INT_SUB: case INT_MUL: case INT_DIV: case INT_MOD: case INT_LT: case INT_LTE:
+            case INT_GT: case INT_GTE: case INT_EQ: case INT_NEQ: case INT_AND: case INT_OR: {
+                if (!slot('i', instr.arg2, step.x) || !slot('i', instr.arg3, step.y) || !slot('i', instr.arg1, step.d)) return false;
+                int out;
+                if (!apply(step.op, raw(vals[step.x]), raw(vals[step.y]), out)) return false;
+                if (divides(step.op)) step.exit = add_exit(pc); // the VM runs it with a zero divisor
+                types[step.d] = TraceType::IntReg;
+                vals[step.d] = Value(out);
+                break;
+            }
+            case ADD_OP: case SUB_OP: case MUL_OP: case DIV_OP: case MOD_OP: case POW_OP: case LT_OP: case LTE_OP:
+            case GT_OP: case GTE_OP: case EQ_OP: case NEQ_OP: case AND_OP: case OR_OP: {
+                if (!slot('r', instr.arg2, step.x) || !slot('r', instr.arg3, step.y) || !slot('r', instr.arg1, step.d)) return false;
+                TraceType x = types[step.x], y = types[step.y];
+                bool logic = step.op == AND_OP || step.op == OR_OP;
+                bool equality = step.op == EQ_OP || step.op == NEQ_OP;
+                if (x != y) return false;
+                if (logic ? x != TraceType::Bool : equality ? x == TraceType::List : x != TraceType::Int) return false;
+                int out;
+                if (!apply(step.op, raw(vals[step.x]), raw(vals[step.y]), out)) return false;
+                if (divides(step.op)) step.exit = add_exit(pc);
+                bool arith = step.op == ADD_OP || step.op == SUB_OP || step.op == MUL_OP || step.op == DIV_OP
+                    || step.op == MOD_OP || step.op == POW_OP;
+                types[step.d] = arith ? TraceType::Int : TraceType::Bool;
+                vals[step.d] = arith ? Value(out) : Value(out != 0);
+                break;
+            }
+            default:
+                return false;
+        }
+        path.push_back(step);
+        pc = next;
+    }
+}
+
+// One function for the whole tree, int trace(int64_t* slots), rbx holding
+// slots. The root path starts at the top and every path jumps back there at
+// its back-edge, a guard jumps to the branch recorded from its exit or to a
+// stub returning the exit's number.
+bool TraceJit::compile(TraceLoop& loop) {
+#ifdef RV_JIT
+    Assembler as;
+    as.frame = EBX;
+    as.base = arena.next();
+    as.emit({0x53});                 // push rbx
+    as.emit({0x48, 0x89, 0xFB});     // mov rbx, rdi
+    const uint8_t* top = as.here();
+
+    std::vector<size_t> starts;
+    std::vector<std::pair<size_t, int>> guards; // rel32 position, exit
+    for (const std::vector<TraceStep>& path : loop.paths) {
+        starts.push_back(as.buf.size());
+        for (const TraceStep& step : path) {
+            switch (step.op) {
+                case LOAD_CONST_OP: case INT_LOAD_CONST:
+                    as.mem({0xC7}, 0, step.d); // mov dword [d], imm32
+                    as.u32(step.imm);
+                    break;
+                case MOVE_OP: case LOAD_VAR_OP: case STORE_VAR_OP: case INT_MOVE:
+                    as.copy(step.d, step.x, true); // lists are pointers
+                    break;
+                case BOX_INT: case UNBOX:
+                    as.copy(step.d, step.x);
+                    break;
+                case JNT: case INT_JNT:
+                    as.is_zero(step.x);
+                    as.emit({0x0F, step.exit_if_zero ? 0x84 : 0x85}); // je / jne exit
+                    guards.push_back({as.buf.size(), step.exit});
+                    as.u32(0);
+                    break;
+                case SIZE_OP:
+                    as.load(EDI, step.x, true);
+                    as.call(reinterpret_cast<const void*>(&list_size));
+                    as.store(step.d, EAX);
+                    break;
+                case ACCESS:
+                    as.load(EDI, step.x, true);
+                    as.load(ESI, step.y);
+                    as.emit({0xBA});         // mov edx, tag
+                    as.u32(step.imm);
+                    as.call(reinterpret_cast<const void*>(&list_get));
+                    as.emit({0x48, 0x83, 0xF8, 0xFF}); // cmp rax, -1
+                    as.emit({0x0F, 0x84});   // je exit
+                    guards.push_back({as.buf.size(), step.exit});
+                    as.u32(0);
+                    as.store(step.d, EAX);
+                    break;
+                default:
+                    if (divides(step.op)) {
+                        as.is_zero(step.y);
+                        as.emit({0x0F, 0x84}); // je exit
+                        guards.push_back({as.buf.size(), step.exit});
+                        as.u32(0);
+                    }
+                    if (!int_op(as, step.op, step.d, step.x, step.y)) return false;
+                    break;
+            }
+        }
+        as.emit({0xE9});                 // jmp top
+        as.rel32(top);
+    }
+
+    std::vector<size_t> stubs;
+    for (size_t e = 0; e < loop.exits.size(); e++) {
+        stubs.push_back(as.buf.size());
+        as.emit({0xB8});                 // mov eax, e
+        as.u32(e);
+        as.emit({0x5B, 0xC3});           // pop rbx, ret
+    }
+    for (auto [at, e] : guards) {
+        int branch = loop.exits[e].branch;
+        as.patch(at, as.base + (branch >= 0 ? starts[branch] : stubs[e]));
+    }
+
+    loop.entry = arena.add(as.buf);
+    return loop.entry != nullptr;
+#else
+    (void)loop;
+    return false;
+#endif
+}
+
+// Loads the slots from the frame (nothing runs when one of them has changed
+// type since the recording), runs the tree and writes the slots back with
+// their types at the exit taken. A side exit that gets hot is recorded from
+// there and the tree recompiled with it.
+int TraceJit::run(TraceLoop& loop, int header, std::map<int, Value>& regs, std::vector<int>& iregs, Environment& env) {
+    size_t n = loop.slots.size();
+    std::vector<int64_t> slots(n);
+    std::vector<Value*> where(n, nullptr);
+    for (size_t s = 0; s < n; s++) {
+        const TraceSlot& slot = loop.slots[s];
+        if (slot.kind == 'i') {
+            if (slot.index >= static_cast<int>(iregs.size())) return header;
+            slots[s] = iregs[slot.index];
+            continue;
+        }
+        if (slot.kind == 'r') {
+            auto it = regs.find(slot.index);
+            if (it == regs.end()) return header;
+            where[s] = &it->second;
+        } else {
+            auto it = env.find(_ident_table[slot.index]);
+            if (it == env.end()) return header;
+            where[s] = &it->second;
+        }
+        const Value& val = *where[s];
+        if (!has_type(val, loop.entry_types[s])) return header;
+        if (val.is_list()) slots[s] = reinterpret_cast<intptr_t>(where[s]);
+        else slots[s] = raw(val);
+    }
+
+    using Trace = int (*)(int64_t* slots);
+    Trace trace;
+    std::memcpy(&trace, &loop.entry, sizeof(trace));
+    int e = trace(slots.data());
+
+    // lists are copied out before anything is written, a slot may point at
+    // a Value another slot overwrites
+    const TraceExit& exit = loop.exits[e];
+    std::vector<std::pair<Value*, Value>> lists;
+    for (size_t s = 0; s < n; s++) {
+        auto it = exit.types.find(s);
+        TraceType type = it == exit.types.end() ? loop.entry_types[s] : it->second;
+        const Value* list = reinterpret_cast<const Value*>(slots[s]);
+        if (type == TraceType::List && list != where[s]) lists.push_back({where[s], *list});
+    }
+    for (size_t s = 0; s < n; s++) {
+        auto it = exit.types.find(s);
+        TraceType type = it == exit.types.end() ? loop.entry_types[s] : it->second;
+        int word = static_cast<int32_t>(slots[s]);
+        if (type == TraceType::IntReg) iregs[loop.slots[s].index] = word;
+        else if (type == TraceType::Int) *where[s] = word;
+        else if (type == TraceType::Bool) *where[s] = word != 0;
+    }
+    for (auto& [dst, val] : lists) *dst = std::move(val);
+
+    int exit_pc = exit.pc;
+    TraceExit& hot = loop.exits[e];
+    if (!hot.final && hot.branch < 0 && ++hot.hits >= threshold) {
+        TraceLoop grown = loop;
+        bool grew = static_cast<int>(loop.paths.size()) < MAX_PATHS
+            && record(grown, header, exit_pc, e, regs, iregs, env) && compile(grown);
+        if (grew) loop = std::move(grown);
+        else hot.final = true;
+    }
+    return exit_pc;
+}
+
+int TraceJit::loop(int pc, int header, std::map<int, Value>& regs, std::vector<int>& iregs, Environment& env) {
+    TraceLoop& loop = loops[header];
+    if (loop.back_edge < 0) loop.back_edge = pc;
+    if (pc != loop.back_edge) return header; // a loop has one back-edge
+    if (loop.entry) return run(loop, header, regs, iregs, env);
+    if (loop.failures >= MAX_FAILURES || ++loop.hits < threshold) return header;
+
+    loop.hits = 0;
+    TraceLoop fresh;
+    fresh.back_edge = pc;
+    if (!arena.map(CODE_BYTES) || !record(fresh, header, header, -1, regs, iregs, env) || !compile(fresh)) {
+        loop.failures++;
+        return header;
+    }
+    loop = std::move(fresh);
+    return run(loop, header, regs, iregs, env);
+}
@@ -1,10 +1,31 @@
 #include "tree_evaluator.hpp"
 #include "utils.hpp"
 #include "builtins.hpp"
+#include "value_ops.hpp"
 
 #include <cmath>
 #include <sstream>
 
+value_ops::BinOp TreeEvaluator::binop_of(BinaryOperator op) {
+    switch (op) {
+        case BinaryOperator::IntPlusOp: return value_ops::BinOp::Add;
+        case BinaryOperator::IntMinusOp: return value_ops::BinOp::Sub;
+        case BinaryOperator::IntTimesOp: return value_ops::BinOp::Mul;
+        case BinaryOperator::IntDivOp: return value_ops::BinOp::Div;
+        case BinaryOperator::IntPowOp: return value_ops::BinOp::Pow;
+        case BinaryOperator::ModOp: return value_ops::BinOp::Mod;
+        case BinaryOperator::GtOp: return value_ops::BinOp::Gt;
+        case BinaryOperator::GteOp: return value_ops::BinOp::Gte;
+        case BinaryOperator::LtOp: return value_ops::BinOp::Lt;
+        case BinaryOperator::LteOp: return value_ops::BinOp::Lte;
+        case BinaryOperator::EqualityOp: return value_ops::BinOp::Eq;
+        case BinaryOperator::NotEqualsOp: return value_ops::BinOp::Neq;
+        case BinaryOperator::AndOp: return value_ops::BinOp::And;
+        case BinaryOperator::OrOp: return value_ops::BinOp::Or;
+        default: throw std::runtime_error("Incorrect BinOp (int): " + std::to_string(int(op)));
+    }
+}
+
 void TreeEvaluator::push_env() {
     Environment env_copy = *curr_env; // make a copy of the topmost frame
     env_stack.push(env_copy);
@@ -15,13 +36,28 @@ void TreeEvaluator::pop_env() {
     curr_env = &env_stack.top();
 }
 
+CompiledFunction* TreeEvaluator::tier_up(FunctionAssignmentExpression* func_exp) {
+    if (tier_threshold <= 0) return nullptr;
+    auto it = compiled.find(func_exp);
+    if (it != compiled.end()) return it->second.get();
+    if (++call_counts[func_exp] < tier_threshold) return nullptr;
+    return (compiled[func_exp] = CompiledFunction::compile(func_exp, func_env, output)).get();
+}
+
+int TreeEvaluator::tiered_count() const {
+    int count = 0;
+    for (const auto& [func_exp, fn] : compiled) count += fn != nullptr;
+    return count;
+}
+
 std::string TreeEvaluator::string_of_env() {
     std::ostringstream oss;
     oss << "{";
     bool first = true;
     for (const auto& pair : *curr_env) {
         if (!first) oss << ", ";
-        oss << pair.first << ": " << pair.second.to_string(false);
+        oss << pair.first << ": ";
+        pair.second.write_to(oss, false);
         first = false;
     }
     oss << "}";
@@ -60,26 +96,11 @@ std::pair<Value, bool> TreeEvaluator::evaluate_expression(Expression * exp) {
             BinaryExpression * bin_exp = dynamic_cast<BinaryExpression*>(exp);
             Value va1 = evaluate_expression(bin_exp->get_left()).first;
             Value va2 = evaluate_expression(bin_exp->get_right()).first;
-            Value res;
-            switch (bin_exp->get_type()) {
-                case BinaryOperator::IntPlusOp: res = va1 + va2; break;
-                case BinaryOperator::IntMinusOp: res = va1 - va2; break;
-                case BinaryOperator::IntTimesOp: res = va1 * va2; break;
-                case BinaryOperator::IntDivOp: res = va1 / va2; break;
-                case BinaryOperator::IntPowOp: res = va1.pow(va2); break;
-                case BinaryOperator::ModOp: res = va1 % va2; break;
-                case BinaryOperator::GtOp: res = va1 > va2; break;
-                case BinaryOperator::GteOp: res = va1 >= va2; break;
-                case BinaryOperator::LtOp: res = va1 < va2; break;
-                case BinaryOperator::LteOp: res = va1 <= va2; break;
-                case BinaryOperator::EqualityOp: res = va1 == va2; break;
-                case BinaryOperator::NotEqualsOp: res = va1 != va2; break;
-                case BinaryOperator::AndOp: res = va1 && va2; break;
-                case BinaryOperator::OrOp: res = va1 || va2; break;
-                default: throw std::runtime_error("Incorrect BinOp (int): " + std::to_string(int(bin_exp->get_type())));
-            };
+            value_ops::BinOp op = binop_of(bin_exp->get_type());
+            // an unshared list on the left is appended to in place
+            Value res = op == value_ops::BinOp::Add ? std::move(va1) + va2 : value_ops::binary(op, va1, va2);
 
-            return {res, returnable};
+            return {std::move(res), returnable};
         }
         case ExpressionType::MON_EXP: {
             // std::cout << "mon" << std::endl;
@@ -89,7 +110,7 @@ std::pair<Value, bool> TreeEvaluator::evaluate_expression(Expression * exp) {
             switch (mon_exp->get_type()) {
                 case MonadicOperator::IntNegOp: return {-val, returnable};
                 case MonadicOperator::NotOp: return {!val, returnable};
-                case MonadicOperator::PrintOp: std::cout << val.to_string(false) << "\n"; return {Value(), false}; // cannot return print statement
+                case MonadicOperator::PrintOp: output.write_line(val); return {Value(), false}; // cannot return print statement
                 case MonadicOperator::SizeOp: return {val.size(), returnable};
                 default: throw std::runtime_error("Incorrect MonOp (int): " + std::to_string(int(mon_exp->get_type())));
             };
@@ -107,8 +128,8 @@ std::pair<Value, bool> TreeEvaluator::evaluate_expression(Expression * exp) {
             IfExpression * if_statement = dynamic_cast<IfExpression*>(exp);
             Value cond_val = evaluate_expression(if_statement->get_conditional()).first;
 
-            if (std::holds_alternative<bool>(cond_val.data)) {
-                bool b = std::get<bool>(cond_val.data);
+            if (cond_val.is_bool()) {
+                bool b = cond_val.as_bool();
                 std::vector<Expression*> branch =
                     b ? if_statement->get_if_exps() : if_statement->get_else_exps();
 
@@ -129,9 +150,9 @@ std::pair<Value, bool> TreeEvaluator::evaluate_expression(Expression * exp) {
             Value last_result;
             while (true) {
                 Value cond_val = evaluate_expression(while_statment->get_conditional()).first;
-                if (!std::holds_alternative<bool>(cond_val.data)) { throw std::runtime_error("While loop condition does not evaluate to bool"); }
+                if (!cond_val.is_bool()) { throw std::runtime_error("While loop condition does not evaluate to bool"); }
 
-                bool b = std::get<bool>(cond_val.data);
+                bool b = cond_val.as_bool();
                 if (!b) break;
 
                 Value last_result; // default fallback
@@ -159,12 +180,13 @@ std::pair<Value, bool> TreeEvaluator::evaluate_expression(Expression * exp) {
                 evaluated_args.push_back(evaluate_expression(arg_exp).first);
             }
 
-            if (builtin::is_builtin_func(func_name)) {
-                if (func_name == "append") return {builtin::append(evaluated_args[0], evaluated_args[1]), returnable};
-                if (func_name == "remove") return {builtin::remove(evaluated_args[0], evaluated_args[1]), returnable};
-                if (func_name == "type") return {builtin::type(evaluated_args[0]), returnable};
-                if (func_name == "string") return {builtin::string(evaluated_args[0]), returnable};
-                throw std::runtime_error("unknown builtin");
+            int nid = func_call_exp->calls_user_function() ? -1 : builtin::find_native(func_name);
+            if (nid >= 0) {
+                const builtin::NativeFunction& native = builtin::natives()[nid];
+                if (static_cast<int>(evaluated_args.size()) != native.arity()) {
+                    throw std::runtime_error("function call does not match " + native.signature());
+                }
+                return {native.fn(evaluated_args.data()), returnable};
             } else if (func_env.find(func_name) == func_env.end()) {
                 throw std::runtime_error("function does not exist");
             }
@@ -177,16 +199,21 @@ std::pair<Value, bool> TreeEvaluator::evaluate_expression(Expression * exp) {
 
             // execute the function by adding to env, and then removing
             size_t arg_count = func_call_exp->get_args_length();
-            std::vector<std::string> arg_names = func_exp->get_arg_names();
+            const std::vector<std::string>& arg_names = func_exp->get_arg_names();
+
+            if (CompiledFunction* fn = tier_up(func_exp)) {
+                // the VM runs on the frame push_env would make
+                Environment env = *curr_env;
+                for (size_t i = 0; i < arg_count; i++) env[arg_names[i]] = std::move(evaluated_args[i]);
+                return {fn->call(std::move(env)), returnable};
+            }
 
             push_env();
             Environment& env = *curr_env;
 
             // add to environment
             for (size_t i = 0; i < arg_count; i++) {
-                std::string arg_name = arg_names[i];
-                Value arg_val = evaluated_args[i];
-                env[arg_name] = arg_val;
+                env[arg_names[i]] = std::move(evaluated_args[i]);
             }
 
             // std::cout << "added new env " << string_of_env() << "\n";
@@ -194,24 +221,23 @@ std::pair<Value, bool> TreeEvaluator::evaluate_expression(Expression * exp) {
             for (Expression* inner_exp : func_exp->get_body_exps()) {
                 // std::cout << utils::string_of_expression(inner_exp) << std::endl;
                 auto [inner_val, inner_returnable] = evaluate_expression(inner_exp);
-                return_val = inner_val;
+                return_val = std::move(inner_val);
                 if (inner_returnable) break;
             }
 
             pop_env();
 
-            return {return_val, returnable};
+            return {std::move(return_val), returnable};
         }
         case ExpressionType::LIST_EXP: {
             ListExpression * list_statement = dynamic_cast<ListExpression*>(exp);
             std::vector<Value> elements;
 
             for (Expression * elem_exp : list_statement->get_elements()) {
-                Value res = evaluate_expression(elem_exp).first;
-                elements.push_back(res);
+                elements.push_back(evaluate_expression(elem_exp).first);
             }
 
-            return {Value(elements), returnable};
+            return {Value(std::move(elements)), returnable};
         }
         case ExpressionType::LIST_ACCESS_EXP: {
             ListAccessExpression * access_exp = dynamic_cast<ListAccessExpression*>(exp);
@@ -226,16 +252,16 @@ std::pair<Value, bool> TreeEvaluator::evaluate_expression(Expression * exp) {
             Value va1 = evaluate_expression(access_exp->get_idx_exp()).first;
             Value va2 = evaluate_expression(access_exp->get_exp()).first;
             
-            if (std::holds_alternative<std::vector<Value>>(va_list.data) && std::holds_alternative<int>(va1.data)) {
-                std::vector<Value>& arr = std::get<std::vector<Value>>(va_list.data);
-                int idx = std::get<int>(va1.data);
+            if (va_list.is_list() && va1.is_int()) {
+                std::vector<Value>& arr = va_list.list_ref();
+                int idx = va1.as_int();
 
                 if (idx < 0 || static_cast<size_t>(idx) >= arr.size()) {
                     throw std::runtime_error("Index out of bounds");
                 }
                 
-                arr[idx] = va2;
-                return {Value(arr), false};
+                arr[idx] = std::move(va2);
+                return {std::move(va_list), false};
             }
         }
     };
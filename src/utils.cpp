@@ -71,16 +71,16 @@ std::string utils::string_of_expression(Expression* exp) {
             
             switch (const_exp->get_type()) {
                 case ConstType::BoolConst: {
-                    std::string bool_str = std::get<bool>(const_exp->value.data) ? "true" : "false";
+                    std::string bool_str = const_exp->value.as_bool() ? "true" : "false";
                     res = res + "BoolConst " + bool_str + ')';
                     break;
                 }
                 case ConstType::IntConst: {
-                    res = res + "IntConst " + std::to_string(std::get<int>(const_exp->value.data)) + ')';
+                    res = res + "IntConst " + std::to_string(const_exp->value.as_int()) + ')';
                     break;
                 }
                 case ConstType::StringConst: {
-                    std::string s = std::get<std::string>(const_exp->value.data);
+                    std::string s = const_exp->value.as_string();
                     res = res + "StringConst \"" + s + "\")";
                     break;
                 }
@@ -278,18 +278,18 @@ void utils::print_evaluated_list(std::vector<Value> arr) {
     bool first = true;
     for (Value v : arr) {
         if (!first) std::cout << ", ";
-        if (std::holds_alternative<int>(v.data)) {
-            int i = std::get<int>(v.data);
+        if (v.is_int()) {
+            int i = v.as_int();
             std::cout << i;
-        } else if (std::holds_alternative<bool>(v.data)) {
-            bool b = std::get<bool>(v.data);
+        } else if (v.is_bool()) {
+            bool b = v.as_bool();
             std::string bool_str = b ? "true" : "false";
             std::cout << bool_str;
-        } else if (std::holds_alternative<std::string>(v.data)) {
-            std::string s = std::get<std::string>(v.data);
+        } else if (v.is_string()) {
+            const std::string& s = v.as_string();
             std::cout << s;
         } else {
-            std::vector<Value> sub_arr = std::get<std::vector<Value>>(v.data);
+            const std::vector<Value>& sub_arr = v.as_list();
             print_evaluated_list(sub_arr);
         }
         first = false;
@@ -297,25 +297,6 @@ void utils::print_evaluated_list(std::vector<Value> arr) {
     std::cout << "]";
 }
 
-std::string utils::multiply(std::string str, int m) {
-    std::string res = "";
-    while (m > 0) {
-        res += str;
-        m -= 1;
-    }
-    return res;
-}
-
-std::vector<Value> utils::multiply(std::vector<Value> arr, int m) {
-    std::vector<Value> res;
-
-    while (m > 0) {
-        res.insert(res.end(), arr.begin(), arr.end());
-        m -= 1;
-    }
-    return res;
-}
-
 void utils::cleanup_expressions(std::vector<Expression*> expressions) {
     for (auto e : expressions) delete e;
 }
\ No newline at end of file
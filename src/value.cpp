@@ -1,40 +1,115 @@
 #include "value.hpp"
-#include "utils.hpp"
-
-#include <cmath>
-
-std::string Value::string_of_list(std::vector<Value> arr, bool string_quotes) const {
-    std::ostringstream oss;
-    oss << "[";
-    bool first = true;
-    for (Value v : arr) {
-        if (!first) oss << ", ";
-        oss << v.to_string(string_quotes);
-        first = false;
+#include "value_ops.hpp"
+
+#include <charconv>
+#include <ostream>
+
+Value::Value(const char* s): Value(std::string(s)) {}
+
+Value::Value(std::string s): bits(reinterpret_cast<uint64_t>(new StringObject(std::move(s))) | STRING_TAG) {
+    heap::track_string(heap());
+}
+
+Value::Value(std::vector<Value> arr): bits(reinterpret_cast<uint64_t>(new ListObject(std::move(arr))) | LIST_TAG) {
+    heap::track_list(heap());
+}
+
+Value::Value(StringObject* obj): bits(reinterpret_cast<uint64_t>(obj) | STRING_TAG) {
+    heap::track_string(heap());
+}
+
+void Value::destroy() {
+    if (is_string()) {
+        heap::untrack_string(heap());
+        delete static_cast<StringObject*>(heap());
+    } else {
+        heap::untrack_list(heap());
+        delete static_cast<ListObject*>(heap());
     }
-    oss << "]";
-    return oss.str();
 }
 
+const std::string& StringObject::flatten() {
+    if (buf->refs == 1) {
+        buf->data.resize(len); // nothing else sees the tail
+        return buf->data;
+    }
+    str = buf->data.substr(0, len);
+    buf->refs--;
+    buf = nullptr;
+    return str;
+}
 
-std::string Value::to_string(bool string_quotes) const {
-    if (std::holds_alternative<int>(data)) {
-        int i = std::get<int>(data);
-        return std::to_string(i);
-    } else if (std::holds_alternative<bool>(data)) {
-        bool b = std::get<bool>(data);
-        return b ? "true" : "false";
-    } else if (std::holds_alternative<std::string>(data)) {
-        std::string s = std::get<std::string>(data);
-        return string_quotes ? "\"" + s + "\"" : s;
-    } else if ((std::holds_alternative<std::vector<Value>>(data))) {
-        std::vector<Value> v = std::get<std::vector<Value>>(data);
-        return string_of_list(v, string_quotes);
+std::string& StringObject::own() {
+    if (buf) {
+        if (buf->refs == 1) {
+            str = std::move(buf->data);
+            str.resize(len);
+            delete buf;
+        } else {
+            str = buf->data.substr(0, len);
+            buf->refs--;
+        }
+        buf = nullptr;
+    }
+    return str;
+}
 
+StringBuffer* StringObject::buffer() {
+    if (!buf) {
+        buf = new StringBuffer{1, std::move(str)};
+        len = buf->data.size();
+        str = std::string();
     }
+    return buf;
+}
+
+void Value::unshare() {
+    Value copy = is_string() ? Value(as_string()) : Value(as_list());
+    *this = std::move(copy);
+}
+
+static void put(std::string& out, const char* s, size_t n) { out.append(s, n); }
+static void put(std::ostream& out, const char* s, size_t n) { out.write(s, n); }
+
+template <typename Out>
+static void write_value(Out& out, const Value& v, bool string_quotes) {
+    if (v.is_int()) {
+        char digits[12];
+        char* end = std::to_chars(digits, digits + sizeof(digits), v.as_int()).ptr;
+        put(out, digits, end - digits);
+    } else if (v.is_bool()) {
+        if (v.as_bool()) put(out, "true", 4);
+        else put(out, "false", 5);
+    } else if (v.is_string()) {
+        const std::string& s = v.as_string();
+        if (string_quotes) put(out, "\"", 1);
+        put(out, s.data(), s.size());
+        if (string_quotes) put(out, "\"", 1);
+    } else {
+        put(out, "[", 1);
+        bool first = true;
+        for (const Value& item : v.as_list()) {
+            if (!first) put(out, ", ", 2);
+            write_value(out, item, string_quotes);
+            first = false;
+        }
+        put(out, "]", 1);
+    }
+}
 
-    return "UNKOWN VALUE";
-};
+void Value::write_to(std::string& out, bool string_quotes) const {
+    write_value(out, *this, string_quotes);
+}
+
+void Value::write_to(std::ostream& out, bool string_quotes) const {
+    write_value(out, *this, string_quotes);
+}
+
+std::string Value::to_string(bool string_quotes) const {
+    std::string res;
+    write_to(res, string_quotes);
+    return res;
+}
 
 std::string Value::get_type() const {
     if (is_int()) return "int";
@@ -45,174 +120,99 @@ std::string Value::get_type() const {
     return "UNKOWN TYPE";
 }
 
-Value Value::operator+(const Value& rhs) const {
-    if (is_int() && rhs.is_int()) {
-        int val1 = std::get<int>(data);
-        int val2 = std::get<int>(rhs.data);
-        return Value(val1 + val2);
-    } else if (is_string() && rhs.is_string()) {
-        std::string s1 = std::get<std::string>(data);
-        std::string s2 = std::get<std::string>(rhs.data);
-        return Value(s1 + s2);
-    } else if (is_list() && rhs.is_list()) {
-        std::vector<Value> v1 = std::get<std::vector<Value>>(data);
-        std::vector<Value> v2 = std::get<std::vector<Value>>(rhs.data);
-        std::vector<Value> res(v1); 
+Value Value::operator+(const Value& rhs) const& {
+    return value_ops::binary(value_ops::BinOp::Add, *this, rhs);
+}
 
+// a temporary list nobody else holds takes the right operand's items itself
+Value Value::operator+(const Value& rhs) && {
+    if (is_list() && rhs.is_list() && heap()->refs == 1 && &rhs != this) {
+        const std::vector<Value>& v2 = rhs.as_list();
+        std::vector<Value>& res = static_cast<ListObject*>(heap())->items;
         res.insert(res.end(), v2.begin(), v2.end());
-        return Value(res);
+        return std::move(*this);
     }
-    throw std::runtime_error("incorrect types for + operator");
+    return static_cast<const Value&>(*this) + rhs;
+}
+
+// s + t appends t to the buffer s ends, and the result shares it with s, so
+// building a string in a loop (s = s + c) is amortised linear. Only the
+// value at the end of a buffer can append, an older prefix copies.
+Value Value::concat(const Value& rhs) const {
+    const size_t MIN_BUFFERED = 32; // shorter strings are cheaper to copy
+    StringObject* obj = static_cast<StringObject*>(heap());
+    if (obj->size() < MIN_BUFFERED) return Value(obj->chars() + rhs.as_string());
+
+    StringBuffer* buf = obj->buffer();
+    if (buf->data.size() != obj->len) return Value(obj->chars() + rhs.as_string());
+
+    buf->data += rhs.as_string(); // after buffer(), for s + s
+    return Value(new StringObject(buf, buf->data.size()));
 }
 
 Value Value::operator-(const Value& rhs) const {
-    if (is_int() && rhs.is_int()) {
-        int val1 = std::get<int>(data);
-        int val2 = std::get<int>(rhs.data);
-        return Value(val1 - val2);
-    }
-    throw std::runtime_error("incorrect types for - operator");
+    return value_ops::binary(value_ops::BinOp::Sub, *this, rhs);
 }
 
 Value Value::operator*(const Value& rhs) const {
-    if (is_int() && rhs.is_int()) {
-        int val1 = std::get<int>(data);
-        int val2 = std::get<int>(rhs.data);
-        return Value(val1 * val2);
-    } else if (is_string() && rhs.is_int()) {
-        std::string str = std::get<std::string>(data);
-        int multiplier = std::get<int>(rhs.data);
-        return Value(utils::multiply(str, multiplier));
-    } else if (is_list() && rhs.is_int()) {
-        std::vector<Value> v1 = std::get<std::vector<Value>>(data);
-        int multiplier = std::get<int>(rhs.data);
-        return Value(utils::multiply(v1, multiplier));
-    }
-    throw std::runtime_error("incorrect types for * operator " + get_type() + " " + rhs.get_type());
+    return value_ops::binary(value_ops::BinOp::Mul, *this, rhs);
 }
 
 Value Value::operator/(const Value& rhs) const {
-    if (is_int() && rhs.is_int()) {
-        int val1 = std::get<int>(data);
-        int val2 = std::get<int>(rhs.data);
-        return Value(val1 / val2);
-    }
-    throw std::runtime_error("incorrect types for / operator");
+    return value_ops::binary(value_ops::BinOp::Div, *this, rhs);
 }
 
 Value Value::pow(const Value& exp) const {
-    if (is_int() && exp.is_int()) {
-        int val1 = std::get<int>(data);
-        int val2 = std::get<int>(exp.data);
-        int res = static_cast<int>(std::pow(val1, val2));
-        return Value(res);
-    }
-    throw std::runtime_error("incorrect types for ^ operator");
+    return value_ops::binary(value_ops::BinOp::Pow, *this, exp);
 }
 
 Value Value::operator%(const Value& rhs) const {
-    if (is_int() && rhs.is_int()) {
-        int val1 = std::get<int>(data);
-        int val2 = std::get<int>(rhs.data);
-        return Value(val1 % val2);
-    }
-    throw std::runtime_error("incorrect types for mod operator");  
+    return value_ops::binary(value_ops::BinOp::Mod, *this, rhs);
 }
 
 Value Value::operator>(const Value& rhs) const {
-    if (is_int() && rhs.is_int()) {
-        int val1 = std::get<int>(data);
-        int val2 = std::get<int>(rhs.data);
-        return Value(val1 > val2);
-    }
-    throw std::runtime_error("incorrect types for > operator");  
+    return value_ops::binary(value_ops::BinOp::Gt, *this, rhs);
 }
 
 Value Value::operator>=(const Value& rhs) const {
-    if (is_int() && rhs.is_int()) {
-        int val1 = std::get<int>(data);
-        int val2 = std::get<int>(rhs.data);
-        return Value(val1 >= val2);
-    }
-    throw std::runtime_error("incorrect types for >= operator");  
+    return value_ops::binary(value_ops::BinOp::Gte, *this, rhs);
 }
 
 Value Value::operator<(const Value& rhs) const {
-    if (is_int() && rhs.is_int()) {
-        int val1 = std::get<int>(data);
-        int val2 = std::get<int>(rhs.data);
-        return Value(val1 < val2);
-    }
-    throw std::runtime_error("incorrect types for < operator");  
+    return value_ops::binary(value_ops::BinOp::Lt, *this, rhs);
 }
 
 Value Value::operator<=(const Value& rhs) const {
-    if (is_int() && rhs.is_int()) {
-        int val1 = std::get<int>(data);
-        int val2 = std::get<int>(rhs.data);
-        return Value(val1 <= val2);
-    }
-    throw std::runtime_error("incorrect types for <= operator");  
+    return value_ops::binary(value_ops::BinOp::Lte, *this, rhs);
 }
 
 bool Value::equals(const Value& rhs) const {
-    if (is_int() && rhs.is_int()) {
-        int val1 = std::get<int>(data);
-        int val2 = std::get<int>(rhs.data);
-        return val1 == val2;
-    } else if (is_string() && rhs.is_string()) {
-        std::string s1 = std::get<std::string>(data);
-        std::string s2 = std::get<std::string>(rhs.data);
-        return s1 == s2;
-    } else if (is_bool() && rhs.is_bool()) {
-        bool b1 = std::get<bool>(data);
-        bool b2 = std::get<bool>(rhs.data);
-        return b1 == b2;
-    } if (is_list() && rhs.is_list()) {
-        std::vector<Value> v1 = std::get<std::vector<Value>>(data);
-        std::vector<Value> v2 = std::get<std::vector<Value>>(rhs.data);
-
-        if (v1.size() != v2.size()) return false;
-        for (size_t i = 0; i < v1.size(); i++) {
-            if (v1[1].not_equals(v2[i])) return false;
-        }
-        return true;
-    }
-    throw std::runtime_error("incorrect types for ==/!= operators"); 
+    return value_ops::binary(value_ops::BinOp::Eq, *this, rhs).as_bool();
 }
+
 bool Value::not_equals(const Value& rhs) const {
     return !this->equals(rhs);
 }
 
 Value Value::operator==(const Value& rhs) const {
-    return Value(this->equals(rhs));
+    return value_ops::binary(value_ops::BinOp::Eq, *this, rhs);
 }
 
 Value Value::operator!=(const Value& rhs) const {
-    return Value(this->not_equals(rhs));
+    return value_ops::binary(value_ops::BinOp::Neq, *this, rhs);
 }
 
 Value Value::operator&&(const Value& rhs) const {
-    if (is_bool() && rhs.is_bool()) {
-        bool val1 = std::get<bool>(data);
-        bool val2 = std::get<bool>(rhs.data);
-        return Value(val1 && val2);
-    }
-    throw std::runtime_error("incorrect types for && operator");
+    return value_ops::binary(value_ops::BinOp::And, *this, rhs);
 }
 
 Value Value::operator||(const Value& rhs) const {
-    if (is_bool() && rhs.is_bool()) {
-        bool val1 = std::get<bool>(data);
-        bool val2 = std::get<bool>(rhs.data);
-        return Value(val1 || val2);
-    }
-    throw std::runtime_error("incorrect types for || operator");
+    return value_ops::binary(value_ops::BinOp::Or, *this, rhs);
 }
 
 Value Value::operator-() const {
     if (is_int()) {
-        int val1 = std::get<int>(data);
+        int val1 = as_int();
         return Value(-1 * val1);
     }
     throw std::runtime_error("incorrect type for - operator");
@@ -220,7 +220,7 @@ Value Value::operator-() const {
 
 Value Value::operator!() const {
     if (is_bool()) {
-        bool b = std::get<bool>(data);
+        bool b = as_bool();
         return Value(!b);
     }
     throw std::runtime_error("incorrect type for ! operator");    
@@ -228,16 +228,16 @@ Value Value::operator!() const {
 
 Value Value::operator[](const Value& idx_val) const {
     if (!idx_val.is_int()) throw std::runtime_error("index for [] is not an int");
-    int idx = std::get<int>(idx_val.data);
+    int idx = idx_val.as_int();
 
     if (is_string()) {
-        std::string s = std::get<std::string>(data);
+        const std::string& s = as_string();
         if (idx < 0 || idx >= static_cast<int>(s.size())) throw std::runtime_error("idx out of bounds for string[]");
         return Value(std::string(1, s[idx]));
     } else if (is_list()) {
-        std::vector<Value> arr = std::get<std::vector<Value>>(data);
+        const std::vector<Value>& arr = as_list();
         if (idx < 0 || idx >= static_cast<int>(arr.size())) throw std::runtime_error("idx out of bounds for list[]");
-        return Value(arr[idx]);
+        return arr[idx];
     }
 
     throw std::runtime_error("incorrect type for [] operator");  
@@ -245,33 +245,59 @@ Value Value::operator[](const Value& idx_val) const {
 
 Value Value::modify_arr(const Value& idx_val, Value replace_val) {
     if (!idx_val.is_int()) throw std::runtime_error("index for arr[] = ... is not an int");
-    int idx = std::get<int>(idx_val.data);
+    int idx = idx_val.as_int();
 
     if (is_string() && replace_val.is_string()) {
-        std::string s(std::get<std::string>(data));
-        std::string c = (std::get<std::string>(replace_val.data));
+        std::string s(as_string());
+        const std::string& c = replace_val.as_string();
         if (idx < 0 || idx >= static_cast<int>(s.size())) throw std::runtime_error("idx out of bounds for string[]");
         if (c.size() != 1) throw std::runtime_error("value for string[i] = x is not a single char");
 
         s[idx] = c[0];
-        return Value(s);
+        return Value(std::move(s));
     } else if (is_list()) {
-        std::vector<Value> arr(std::get<std::vector<Value>>(data));
+        std::vector<Value> arr(as_list());
         if (idx < 0 || idx >= static_cast<int>(arr.size())) throw std::runtime_error("idx out of bounds for list[]");
 
-        arr[idx] = replace_val;
-        return Value(arr);
+        arr[idx] = std::move(replace_val);
+        return Value(std::move(arr));
     }
 
     throw std::runtime_error("incorrect type for [] = ... operator"); 
 }
 
+Value& Value::index_ref(const Value& idx_val) {
+    if (!idx_val.is_int()) throw std::runtime_error("index for arr[] = ... is not an int");
+    if (!is_list()) throw std::runtime_error("incorrect type for [] = ... operator");
+    int idx = idx_val.as_int();
+
+    std::vector<Value>& arr = list_ref();
+    if (idx < 0 || idx >= static_cast<int>(arr.size())) throw std::runtime_error("idx out of bounds for list[]");
+    return arr[idx];
+}
+
+void Value::store_index(const Value& idx_val, Value replace_val) {
+    if (!idx_val.is_int()) throw std::runtime_error("index for arr[] = ... is not an int");
+    int idx = idx_val.as_int();
+
+    if (is_string() && replace_val.is_string()) {
+        const std::string& c = replace_val.as_string();
+        if (idx < 0 || idx >= static_cast<int>(as_string().size())) throw std::runtime_error("idx out of bounds for string[]");
+        if (c.size() != 1) throw std::runtime_error("value for string[i] = x is not a single char");
+
+        if (heap()->refs > 1) unshare();
+        static_cast<StringObject*>(heap())->own()[idx] = c[0];
+        return;
+    }
+
+    index_ref(idx_val) = std::move(replace_val);
+}
+
 Value Value::size() const {
     if (is_string()) {
-        std::string s = std::get<std::string>(data);
-        return Value(static_cast<int>(s.size()));
+        return Value(static_cast<int>(static_cast<const StringObject*>(heap())->size()));
     } else if (is_list()) {
-        std::vector<Value> arr = std::get<std::vector<Value>>(data);
+        const std::vector<Value>& arr = as_list();
         return Value(static_cast<int>(arr.size()));
     }
 
@@ -280,8 +306,7 @@ Value Value::size() const {
 
 void Value::append_ref(Value e) {
     if (is_list()) {
-        std::vector<Value>& arr = std::get<std::vector<Value>>(data);
-        arr.push_back(e);
+        list_ref().push_back(std::move(e));
         return;
     }
 
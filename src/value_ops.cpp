@@ -0,0 +1,142 @@
+#include "value_ops.hpp"
+
+#include <cmath>
+#include <stdexcept>
+#include <utility>
+
+using value_ops::BinOp;
+
+static Value concat_lists(const Value& a, const Value& b) {
+    const std::vector<Value>& v1 = a.as_list();
+    const std::vector<Value>& v2 = b.as_list();
+    std::vector<Value> res;
+    res.reserve(v1.size() + v2.size());
+    res.insert(res.end(), v1.begin(), v1.end());
+    res.insert(res.end(), v2.begin(), v2.end());
+    return Value(std::move(res));
+}
+
+static std::string multiply(const std::string& str, int m) {
+    std::string res = "";
+    if (m <= 0 || str.empty()) return res;
+
+    // doubling, so m copies take log m appends
+    res.reserve(str.size() * m);
+    res += str;
+    while (res.size() * 2 <= str.size() * m) res += res;
+    res.append(res, 0, str.size() * m - res.size());
+    return res;
+}
+
+static std::vector<Value> multiply(const std::vector<Value>& arr, int m) {
+    std::vector<Value> res;
+    if (m > 0) res.reserve(arr.size() * m);
+
+    while (m > 0) {
+        res.insert(res.end(), arr.begin(), arr.end());
+        m -= 1;
+    }
+    return res;
+}
+
+static bool lists_equal(const Value& a, const Value& b) {
+    const std::vector<Value>& v1 = a.as_list();
+    const std::vector<Value>& v2 = b.as_list();
+    if (v1.size() != v2.size()) return false;
+    for (size_t i = 0; i < v1.size(); i++) {
+        if (v1[i].not_equals(v2[i])) return false;
+    }
+    return true;
+}
+
+[[noreturn]] static void type_error(BinOp op, const Value& a, const Value& b) {
+    switch (op) {
+        case BinOp::Mul: throw std::runtime_error("incorrect types for * operator " + a.get_type() + " " + b.get_type());
+        case BinOp::Mod: throw std::runtime_error("incorrect types for mod operator");
+        case BinOp::Eq: case BinOp::Neq: throw std::runtime_error("incorrect types for ==/!= operators");
+        default: throw std::runtime_error(std::string("incorrect types for ") + value_ops::symbol(op) + " operator");
+    }
+}
+
+// Rule<op, lhs, rhs>::apply is the operator's semantics for that pair of
+// types, the primary template is the type error
+template <BinOp Op, int L, int R>
+struct Rule {
+    static constexpr bool defined = false;
+    static Value apply(const Value& a, const Value& b) { type_error(Op, a, b); }
+};
+
+#define RULE(op, lhs, rhs, result)                                      \
+    template <>                                                         \
+    struct Rule<BinOp::op, Value::lhs, Value::rhs> {                    \
+        static constexpr bool defined = true;                           \
+        static Value apply(const Value& a, const Value& b) { return result; } \
+    };
+#define INT_RULE(op, result) RULE(op, INT_TAG, INT_TAG, result)
+
+INT_RULE(Add, Value(a.as_int() + b.as_int()))
+RULE(Add, STRING_TAG, STRING_TAG, a.concat(b))
+RULE(Add, LIST_TAG, LIST_TAG, concat_lists(a, b))
+INT_RULE(Sub, Value(a.as_int() - b.as_int()))
+INT_RULE(Mul, Value(a.as_int() * b.as_int()))
+RULE(Mul, STRING_TAG, INT_TAG, Value(multiply(a.as_string(), b.as_int())))
+RULE(Mul, LIST_TAG, INT_TAG, Value(multiply(a.as_list(), b.as_int())))
+INT_RULE(Div, Value(value_ops::int_div(a.as_int(), b.as_int())))
+INT_RULE(Pow, Value(static_cast<int>(std::pow(a.as_int(), b.as_int()))))
+INT_RULE(Mod, Value(value_ops::int_mod(a.as_int(), b.as_int())))
+INT_RULE(Gt, Value(a.as_int() > b.as_int()))
+INT_RULE(Gte, Value(a.as_int() >= b.as_int()))
+INT_RULE(Lt, Value(a.as_int() < b.as_int()))
+INT_RULE(Lte, Value(a.as_int() <= b.as_int()))
+INT_RULE(Eq, Value(a.as_int() == b.as_int()))
+RULE(Eq, BOOL_TAG, BOOL_TAG, Value(a.as_bool() == b.as_bool()))
+RULE(Eq, STRING_TAG, STRING_TAG, Value(a.as_string() == b.as_string()))
+RULE(Eq, LIST_TAG, LIST_TAG, Value(lists_equal(a, b)))
+INT_RULE(Neq, Value(a.as_int() != b.as_int()))
+RULE(Neq, BOOL_TAG, BOOL_TAG, Value(a.as_bool() != b.as_bool()))
+RULE(Neq, STRING_TAG, STRING_TAG, Value(a.as_string() != b.as_string()))
+RULE(Neq, LIST_TAG, LIST_TAG, Value(!lists_equal(a, b)))
+RULE(And, BOOL_TAG, BOOL_TAG, Value(a.as_bool() && b.as_bool()))
+RULE(Or, BOOL_TAG, BOOL_TAG, Value(a.as_bool() || b.as_bool()))
+
+#undef RULE
+#undef INT_RULE
+
+// entry i of the matrix is the rule for the (op, lhs, rhs) that index() maps to i
+template <int I>
+using RuleAt = Rule<static_cast<BinOp>(I / (Value::NUM_TAGS * Value::NUM_TAGS)), I / Value::NUM_TAGS % Value::NUM_TAGS, I % Value::NUM_TAGS>;
+
+template <int... I>
+constexpr std::array<value_ops::BinaryFn, sizeof...(I)> make_matrix(std::integer_sequence<int, I...>) {
+    return {&RuleAt<I>::apply...};
+}
+
+template <int... I>
+constexpr std::array<bool, sizeof...(I)> make_defined(std::integer_sequence<int, I...>) {
+    return {RuleAt<I>::defined...};
+}
+
+constexpr std::array<value_ops::BinaryFn, value_ops::MATRIX_SIZE> value_ops::matrix =
+    make_matrix(std::make_integer_sequence<int, MATRIX_SIZE>());
+constexpr std::array<bool, value_ops::MATRIX_SIZE> value_ops::defined =
+    make_defined(std::make_integer_sequence<int, MATRIX_SIZE>());
+
+const char* value_ops::symbol(BinOp op) {
+    switch (op) {
+        case BinOp::Add: return "+";
+        case BinOp::Sub: return "-";
+        case BinOp::Mul: return "*";
+        case BinOp::Div: return "/";
+        case BinOp::Pow: return "^";
+        case BinOp::Mod: return "%";
+        case BinOp::Gt: return ">";
+        case BinOp::Gte: return ">=";
+        case BinOp::Lt: return "<";
+        case BinOp::Lte: return "<=";
+        case BinOp::Eq: return "==";
+        case BinOp::Neq: return "!=";
+        case BinOp::And: return "&&";
+        case BinOp::Or: return "||";
+    }
+    return "?";
+}
@@ -0,0 +1,132 @@
+#include "x86.hpp"
+
+#include <cmath>
+
+#ifdef RV_JIT
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace x86 {
+
+// the VM's ^ on ints
+static int pow_helper(int base, int exp) {
+    return static_cast<int>(std::pow(base, exp));
+}
+
+bool int_op(Assembler& as, OPCode op, int d, int x, int y) {
+    switch (op) {
+        case ADD_OP: case INT_ADD: as.load(EAX, x); as.mem({0x03}, EAX, y); as.store(d, EAX); break;
+        case SUB_OP: case INT_SUB: as.load(EAX, x); as.mem({0x2B}, EAX, y); as.store(d, EAX); break;
+        case MUL_OP: case INT_MUL: as.load(EAX, x); as.mem({0x0F, 0xAF}, EAX, y); as.store(d, EAX); break;
+        case DIV_OP: case INT_DIV: case MOD_OP: case INT_MOD: {
+            // idiv traps on INT_MIN / -1, so -1 is done apart, the caller
+            // guards against a zero divisor
+            bool div = op == DIV_OP || op == INT_DIV;
+            as.load(EAX, x);
+            as.mem({0x83}, 7, y);    // cmp dword [y], -1
+            as.emit({0xFF});
+            as.emit({0x75, 0x04});   // jne idiv
+            if (div) as.emit({0xF7, 0xD8}); // neg eax
+            else as.emit({0x31, 0xC0});     // xor eax, eax
+            as.emit({0xEB, 0x00});   // jmp done
+            size_t skip = as.buf.size();
+            as.emit({0x99});         // cdq
+            as.mem({0xF7}, 7, y);    // idiv dword [y]
+            if (!div) as.emit({0x89, 0xD0}); // mov eax, edx
+            as.buf[skip - 1] = static_cast<uint8_t>(as.buf.size() - skip);
+            as.store(d, EAX);
+            break;
+        }
+        case POW_OP:
+            as.load(EDI, x);
+            as.load(ESI, y);
+            as.call(reinterpret_cast<const void*>(&pow_helper));
+            as.store(d, EAX);
+            break;
+        case GT_OP: case INT_GT: case GTE_OP: case INT_GTE: case LT_OP: case INT_LT:
+        case LTE_OP: case INT_LTE: case EQ_OP: case INT_EQ: case NEQ_OP: case INT_NEQ: {
+            int cc = 0x94; // sete
+            if (op == NEQ_OP || op == INT_NEQ) cc = 0x95;
+            if (op == LT_OP || op == INT_LT) cc = 0x9C;
+            if (op == GTE_OP || op == INT_GTE) cc = 0x9D;
+            if (op == LTE_OP || op == INT_LTE) cc = 0x9E;
+            if (op == GT_OP || op == INT_GT) cc = 0x9F;
+            as.load(EAX, x);
+            as.mem({0x3B}, EAX, y);  // cmp eax, [y]
+            as.setcc(cc);
+            as.zero_extend_al();
+            as.store(d, EAX);
+            break;
+        }
+        case AND_OP: case INT_AND: case OR_OP: case INT_OR:
+            as.is_zero(x);
+            as.setcc(0x95);
+            as.is_zero(y);
+            as.setcc(0x95, ECX);
+            as.emit({op == AND_OP || op == INT_AND ? 0x20 : 0x08, 0xC8}); // and/or al, cl
+            as.zero_extend_al();
+            as.store(d, EAX);
+            break;
+        case NOT_OP: case INT_NOT:
+            as.is_zero(x);
+            as.setcc(0x94);
+            as.zero_extend_al();
+            as.store(d, EAX);
+            break;
+        case NEG_OP: case INT_NEG:
+            as.load(EAX, x);
+            as.emit({0xF7, 0xD8});   // neg eax
+            as.store(d, EAX);
+            break;
+        case BOX_BOOL:
+            as.is_zero(x);
+            as.setcc(0x95);
+            as.zero_extend_al();
+            as.store(d, EAX);
+            break;
+        default:
+            return false;
+    }
+    return true;
+}
+
+CodeArena::~CodeArena() {
+#ifdef RV_JIT
+    if (mem) munmap(mem, page + capacity);
+#endif
+}
+
+bool CodeArena::map(size_t code_bytes) {
+#ifdef RV_JIT
+    if (mem) return true;
+    page = sysconf(_SC_PAGESIZE);
+    void* m = mmap(nullptr, page + code_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (m == MAP_FAILED) return false;
+    mem = static_cast<uint8_t*>(m);
+    capacity = code_bytes;
+    return writable(false);
+#else
+    (void)code_bytes;
+    return false;
+#endif
+}
+
+bool CodeArena::writable(bool on) {
+#ifdef RV_JIT
+    return mprotect(mem + page, capacity, on ? PROT_READ | PROT_WRITE : PROT_READ | PROT_EXEC) == 0;
+#else
+    (void)on;
+    return false;
+#endif
+}
+
+const uint8_t* CodeArena::add(const std::vector<uint8_t>& code) {
+    if (!mem || used + code.size() > capacity || !writable(true)) return nullptr;
+    uint8_t* at = mem + page + used;
+    std::memcpy(at, code.data(), code.size());
+    used += code.size();
+    return writable(false) ? at : nullptr;
+}
+
+} // namespace x86
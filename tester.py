@@ -1,14 +1,20 @@
 import unittest
 import subprocess
+import glob
+import os
+import shutil
+import signal
+import tempfile
+import time
+from concurrent.futures import ThreadPoolExecutor
 
-class TestCppProgram(unittest.TestCase):
+def setUpModule():
+    # Compile once before all tests
+    result = subprocess.run("make", shell=True, text=True, capture_output=True)
+    if result.returncode != 0:
+        raise RuntimeError("Compilation failed:\n" + result.stderr)
 
-    @classmethod
-    def setUpClass(cls):
-        # Compile once before all tests
-        result = subprocess.run("make", shell=True, text=True, capture_output=True)
-        if result.returncode != 0:
-            raise RuntimeError("Compilation failed:\n" + result.stderr)
+class TestCppProgram(unittest.TestCase):
 
     def run_test_case(self, input_file, expected_file, test_name):
         print(f"🔍 Running test case: {test_name}")
@@ -78,5 +84,251 @@ class TestCppProgram(unittest.TestCase):
         test_name = "complex_function"
         self.run_test_case(f"test_code/{test_name}.rv", f"test_outputs/expected_{test_name}.txt", test_name)
 
+    def test_case_15(self):
+        test_name = "simple_store_index"
+        self.run_test_case(f"test_code/{test_name}.rv", f"test_outputs/expected_{test_name}.txt", test_name)
+
+    def test_case_16(self):
+        test_name = "simple_list_ops"
+        self.run_test_case(f"test_code/{test_name}.rv", f"test_outputs/expected_{test_name}.txt", test_name)
+
+    def test_case_17(self):
+        test_name = "simple_string_build"
+        self.run_test_case(f"test_code/{test_name}.rv", f"test_outputs/expected_{test_name}.txt", test_name)
+
+    def test_case_18(self):
+        test_name = "simple_quicken"
+        self.run_test_case(f"test_code/{test_name}.rv", f"test_outputs/expected_{test_name}.txt", test_name)
+
+    def test_case_19(self):
+        test_name = "simple_unboxed"
+        self.run_test_case(f"test_code/{test_name}.rv", f"test_outputs/expected_{test_name}.txt", test_name)
+
+    def test_case_20(self):
+        test_name = "simple_jit"
+        self.run_test_case(f"test_code/{test_name}.rv", f"test_outputs/expected_{test_name}.txt", test_name)
+
+    def test_case_21(self):
+        test_name = "simple_trace"
+        self.run_test_case(f"test_code/{test_name}.rv", f"test_outputs/expected_{test_name}.txt", test_name)
+
+    def test_case_22(self):
+        test_name = "simple_tiered"
+        self.run_test_case(f"test_code/{test_name}.rv", f"test_outputs/expected_{test_name}.txt", test_name)
+
+    def test_case_23(self):
+        test_name = "simple_lazy"
+        self.run_test_case(f"test_code/{test_name}.rv", f"test_outputs/expected_{test_name}.txt", test_name)
+
+    def test_case_24(self):
+        test_name = "simple_captures"
+        self.run_test_case(f"test_code/{test_name}.rv", f"test_outputs/expected_{test_name}.txt", test_name)
+
+    def test_case_25(self):
+        test_name = "simple_memo"
+        self.run_test_case(f"test_code/{test_name}.rv", f"test_outputs/expected_{test_name}.txt", test_name)
+
+    def test_case_26(self):
+        test_name = "simple_resolve"
+        self.run_test_case(f"test_code/{test_name}.rv", f"test_outputs/expected_{test_name}.txt", test_name)
+
+    def test_case_27(self):
+        test_name = "simple_call_chain"
+        self.run_test_case(f"test_code/{test_name}.rv", f"test_outputs/expected_{test_name}.txt", test_name)
+
+class TestDifferential(unittest.TestCase):
+    # every other execution path must behave exactly like the plain IR on the VM
+    def run_differential(self, flags, baseline=[]):
+        for program in sorted(glob.glob("test_code/*.rv")):
+            with self.subTest(program=program):
+                plain = subprocess.run(["./bin/test", program] + baseline, capture_output=True, text=True)
+                optimized = subprocess.run(["./bin/test", program] + flags, capture_output=True, text=True)
+                self.assertEqual(plain.returncode, optimized.returncode)
+                self.assertEqual(plain.stdout, optimized.stdout)
+
+    def test_optimize(self):
+        self.run_differential(["--optimize"])
+
+    def test_switch_dispatch(self):
+        self.run_differential(["--switch-dispatch"])
+        self.run_differential(["--optimize", "--switch-dispatch"])
+
+    def test_no_quicken(self):
+        self.run_differential(["--no-quicken"])
+        self.run_differential(["--no-quicken", "--switch-dispatch"])
+
+    def test_no_jit(self):
+        self.run_differential(["--no-jit"])
+        self.run_differential(["--optimize", "--no-jit"])
+
+    def test_no_trace(self):
+        self.run_differential(["--no-trace"])
+        self.run_differential(["--optimize", "--no-trace"])
+
+    def test_tiered(self):
+        # cold code stays in the tree evaluator, so that is the baseline
+        self.run_differential(["--tiered"], baseline=["--tree-evaluate"])
+
+    def test_eager(self):
+        self.run_differential(["--eager"])
+
+    def test_eager_no_jit(self):
+        self.run_differential(["--eager", "--no-jit"])
+
+    def test_eager_interpreted(self):
+        # every call pushes its capture set in the VM, nothing runs natively
+        self.run_differential(["--eager", "--no-jit", "--no-trace", "--no-quicken"])
+
+    def test_closure_evaluate(self):
+        self.run_differential(["--closure-evaluate"], baseline=["--tree-evaluate"])
+
+    def test_memoize(self):
+        self.run_differential(["--memoize"])
+
+    def test_memoize_no_jit(self):
+        self.run_differential(["--memoize", "--no-jit"])
+
+    def test_builtin_shadowed(self):
+        # a function the program declares wins over the native of that name
+        with tempfile.NamedTemporaryFile("w", suffix=".rv") as program:
+            program.write("function pop(l) {\n    return l[0];\n}\nlet xs = [7, 8, 9];\nprint(pop(xs));\n"
+                          "xs = pop(xs);\nprint(xs);\nlet ys = [1, 2];\nys = pop(ys);\nprint(append([ys], 3));\n")
+            program.flush()
+            plain = subprocess.run(["./bin/test", program.name], capture_output=True, text=True)
+            self.assertEqual(plain.returncode, 0)
+            self.assertEqual(plain.stdout, "7\n7\n[1, 3]\n")
+            for flags in (["--eager"], ["--optimize"], ["--no-jit"], ["--tree-evaluate"], ["--closure-evaluate"], ["--tiered"], ["--memoize"]):
+                with self.subTest(flags=flags):
+                    result = subprocess.run(["./bin/test", program.name] + flags, capture_output=True, text=True)
+                    self.assertEqual(result.returncode, plain.returncode)
+                    self.assertEqual(result.stdout, plain.stdout)
+
+    def test_memoize_impure_native(self):
+        # a caller of a native not registered as pure runs on every call
+        driver = r'''
+#include "bench.hpp"
+#include "builtins.hpp"
+#include "interpreter.hpp"
+
+static int ticks = 0;
+
+int main() {
+    builtin::register_native("tick", {"x"}, [](Value* args) { return Value(args[0].as_int() + ++ticks); });
+    builtin::register_native("twice", {"x"}, [](Value* args) { return Value(args[0].as_int() * 2); }, true);
+    std::vector<Expression*> exps = bench::parse(
+        "function f(x) { return tick(x); } function g(x) { return twice(x); }"
+        "print(f(10)); print(f(10)); print(g(10)); print(g(10));");
+    IRGenerator gen;
+    gen.generate_ir_code(exps);
+    Interpreter interpreter(gen);
+    interpreter.set_memoize(true);
+    interpreter.execute();
+    std::cout << interpreter.memo_stats().hits << "\n";
+    utils::cleanup_expressions(exps);
+}
+'''
+        with tempfile.TemporaryDirectory() as build_dir:
+            source = os.path.join(build_dir, "impure_native.cpp")
+            with open(source, "w") as f:
+                f.write(driver)
+            srcs = [s for s in sorted(glob.glob("src/*.cpp")) if s != "src/main.cpp"]
+            binary = os.path.join(build_dir, "impure_native")
+            compiled = subprocess.run(["g++", "-std=c++20", "-Iincludes", "-Ibenchmarks", source] + srcs + ["-o", binary], capture_output=True, text=True)
+            self.assertEqual(compiled.returncode, 0, compiled.stderr)
+            result = subprocess.run([binary], capture_output=True, text=True)
+            self.assertEqual(result.returncode, 0, result.stderr)
+            # f ran twice, the second g(10) was a hit
+            self.assertEqual(result.stdout, "11\n12\n20\n20\n1\n")
+
+    def test_div_by_zero_flushes(self):
+        # an error like any other, after the output printed before it, also
+        # from a jitted function and from a traced loop
+        programs = [
+            "function d(a, b) {\n    return a / b;\n}\nlet i = 1;\nwhile (i < 50) {\n    i = i + d(i, i);\n}\n"
+            "print(1);\nlet z = 0;\nprint(d(5, z));\n",
+            "print(1);\nlet k = 20;\nlet s = 0;\nwhile (k > -1) {\n    s = s + 100 % k;\n    k = k - 1;\n}\nprint(s);\n",
+        ]
+        for source in programs:
+            with tempfile.NamedTemporaryFile("w", suffix=".rv") as program:
+                program.write(source)
+                program.flush()
+                for flags in ([], ["--no-jit", "--no-trace"], ["--optimize"], ["--tree-evaluate"], ["--closure-evaluate"], ["--tiered"]):
+                    with self.subTest(source=source, flags=flags):
+                        result = subprocess.run(["./bin/test", program.name] + flags, capture_output=True, text=True)
+                        self.assertNotEqual(result.returncode, 0)
+                        self.assertNotEqual(result.returncode, -signal.SIGFPE)
+                        self.assertEqual(result.stdout, "1\n")
+                        self.assertIn("division by zero", result.stderr)
+
+    def test_profile(self):
+        # the report follows the program's own output
+        for program in sorted(glob.glob("test_code/*.rv")):
+            with self.subTest(program=program):
+                plain = subprocess.run(["./bin/test", program], capture_output=True, text=True)
+                profiled = subprocess.run(["./bin/test", program, "--profile"], capture_output=True, text=True)
+                self.assertEqual(plain.returncode, profiled.returncode)
+                self.assertTrue(profiled.stdout.startswith(plain.stdout))
+                if plain.returncode == 0:
+                    report = profiled.stdout[len(plain.stdout):]
+                    self.assertIn("profile: ", report)
+                    # one row per opcode in the first table
+                    table = report.split("\nopcode ", 1)[1].split("\n\n", 1)[0].splitlines()[1:]
+                    names = [row.split()[0] for row in table]
+                    self.assertEqual(len(names), len(set(names)))
+
+class TestEmitCpp(unittest.TestCase):
+    # every program translated with --emit-cpp and built against the runtime
+    # must behave like the VM, the speedup over the VM is printed per program
+    @classmethod
+    def setUpClass(cls):
+        result = subprocess.run("make runtime", shell=True, text=True, capture_output=True)
+        if result.returncode != 0:
+            raise RuntimeError("Runtime build failed:\n" + result.stderr)
+        cls.build_dir = tempfile.mkdtemp()
+
+    @classmethod
+    def tearDownClass(cls):
+        shutil.rmtree(cls.build_dir)
+
+    # (binary, compiler errors), binary is None when translation failed
+    def build(self, program):
+        binary = os.path.join(self.build_dir, os.path.basename(program)[:-3])
+        emitted = subprocess.run(["./bin/test", program, "--emit-cpp"], capture_output=True, text=True)
+        if emitted.returncode != 0:
+            return None, ""
+        with open(binary + ".cpp", "w") as f:
+            f.write(emitted.stdout)
+        compiled = subprocess.run(["g++", "-std=c++20", "-O2", "-Iincludes", binary + ".cpp", "bin/librv_runtime.a", "-o", binary], capture_output=True, text=True)
+        return binary, compiled.stderr if compiled.returncode != 0 else ""
+
+    def best_run(self, cmd, runs=3):
+        best = None
+        for _ in range(runs):
+            start = time.perf_counter()
+            result = subprocess.run(cmd, capture_output=True, text=True)
+            elapsed = time.perf_counter() - start
+            best = elapsed if best is None else min(best, elapsed)
+        return result, best * 1000
+
+    def test_emit_cpp(self):
+        programs = sorted(glob.glob("test_code/*.rv"))
+        with ThreadPoolExecutor() as pool:
+            builds = list(pool.map(self.build, programs))
+
+        print(f"\n{'program':<32} {'vm ms':>8} {'aot ms':>8} {'speedup':>8}")
+        for program, (binary, errors) in zip(programs, builds):
+            with self.subTest(program=program):
+                vm, vm_ms = self.best_run(["./bin/test", program])
+                if binary is None:
+                    # only programs the VM rejects before running fail to translate
+                    self.assertNotEqual(vm.returncode, 0)
+                    self.assertEqual(vm.stdout, "")
+                    continue
+                self.assertEqual(errors, "")
+                aot, aot_ms = self.best_run([binary])
+                self.assertEqual(vm.returncode, aot.returncode)
+                self.assertEqual(vm.stdout, aot.stdout)
+                print(f"{program:<32} {vm_ms:>8.2f} {aot_ms:>8.2f} {vm_ms / aot_ms:>7.1f}x")
+
 if __name__ == '__main__':
     unittest.main()